@@ -0,0 +1,178 @@
+# Secure channel workloads: encrypted transport round trips and XX handshakes between two
+# in-process nodes, each with its own vault.
+#
+#   mix run bench/secure_channel_bench.exs [--iterations 1000] [--concurrency 1,8,64]
+
+Code.require_file("../../ockam_vault_software/bench/bench_helper.exs", __DIR__)
+
+defmodule Ockam.SecureChannel.Bench do
+  @moduledoc false
+
+  alias Ockam.SecureChannel.EncryptedTransportProtocol.AeadAesGcm.Decryptor
+  alias Ockam.SecureChannel.EncryptedTransportProtocol.AeadAesGcm.Encryptor
+  alias Ockam.SecureChannel.KeyEstablishmentProtocol.XX.Protocol
+  alias Ockam.Vault
+  alias Ockam.Vault.Software, as: SoftwareVault
+  alias Ockam.Vault.Software.Bench
+
+  @sizes [64, 1024, 16 * 1024, 64 * 1024]
+  @rekey_intervals [32, 1024]
+  @windows [4, 16, 30]
+
+  def run(iterations, concurrency) do
+    for rekey_each <- @rekey_intervals do
+      Bench.print_header("Encryptor.encrypt + Decryptor.decrypt, rekey every #{rekey_each}")
+
+      for size <- @sizes, procs <- concurrency do
+        Bench.run(
+          "#{size} bytes",
+          procs,
+          iterations,
+          fn -> setup_transport(rekey_each, size) end,
+          &round_trip/1
+        )
+      end
+    end
+
+    Bench.print_header("out of order Decryptor.decrypt, 1024 bytes, rekey every 32")
+
+    for window <- @windows, procs <- concurrency do
+      Bench.run(
+        "shuffled in windows of #{window}",
+        procs,
+        iterations,
+        fn -> setup_out_of_order(iterations, window) end,
+        &decrypt_next/1
+      )
+    end
+
+    Bench.print_header("XX handshakes, one initiator and one responder per channel")
+
+    for procs <- concurrency do
+      Bench.run("handshake", procs, max(div(iterations, 10), 1), &setup_handshake/0, &handshake/1)
+    end
+  end
+
+  ## Encrypted transport
+
+  defp setup_transport(rekey_each, size) do
+    # Each end has its own vault, the encryptor destroys the keys it rotates away from
+    {:ok, encryptor_vault} = SoftwareVault.init()
+    {:ok, decryptor_vault} = SoftwareVault.init()
+    k = :crypto.strong_rand_bytes(32)
+    {:ok, ke} = Vault.secret_import(encryptor_vault, [type: :aes], k)
+    {:ok, kd} = Vault.secret_import(decryptor_vault, [type: :aes], k)
+
+    encryptor = Encryptor.new(encryptor_vault, ke, 0, rekey_each)
+    decryptor = Decryptor.new(decryptor_vault, kd, 0, rekey_each)
+    {encryptor, decryptor, :crypto.strong_rand_bytes(size)}
+  end
+
+  defp round_trip({encryptor, decryptor, plain_text}) do
+    {:ok, ciphertext, encryptor} = Encryptor.encrypt(<<>>, plain_text, encryptor)
+    {:ok, ^plain_text, decryptor} = Decryptor.decrypt(<<>>, ciphertext, decryptor)
+    {encryptor, decryptor, plain_text}
+  end
+
+  defp setup_out_of_order(iterations, window) do
+    {encryptor, decryptor, plain_text} = setup_transport(32, 1024)
+
+    {ciphertexts, _encryptor} =
+      Enum.map_reduce(1..iterations, encryptor, fn _, encryptor ->
+        {:ok, ciphertext, encryptor} = Encryptor.encrypt(<<>>, plain_text, encryptor)
+        {ciphertext, encryptor}
+      end)
+
+    ciphertexts = ciphertexts |> Enum.chunk_every(window) |> Enum.flat_map(&Enum.shuffle/1)
+    {decryptor, ciphertexts, plain_text}
+  end
+
+  defp decrypt_next({decryptor, [ciphertext | ciphertexts], plain_text}) do
+    {:ok, ^plain_text, decryptor} = Decryptor.decrypt(<<>>, ciphertext, decryptor)
+    {decryptor, ciphertexts, plain_text}
+  end
+
+  ## XX handshake
+
+  defp setup_handshake() do
+    {:ok, vault} = SoftwareVault.init()
+    {:ok, static} = Protocol.generate_keypair(vault)
+    initiator = self()
+
+    responder =
+      spawn_link(fn ->
+        # Exits with the initiator, when its benchmark case is over
+        Process.monitor(initiator)
+        {:ok, vault} = SoftwareVault.init()
+        {:ok, static} = Protocol.generate_keypair(vault)
+        responder(vault, static)
+      end)
+
+    {vault, static, responder}
+  end
+
+  defp handshake({vault, static, responder} = state) do
+    {:ok, initiator} = Protocol.setup(static, vault: vault)
+    {:ok, message1, {:continue, initiator}} = Protocol.out_payload(initiator)
+    send(responder, {:message1, self(), message1})
+
+    message2 =
+      receive do
+        {:message2, ^responder, message2} -> message2
+      end
+
+    {:ok, {:continue, initiator}} = Protocol.in_payload(initiator, message2)
+
+    {:ok, message3, {:complete, {k1, k2, _h, _rs, _payloads, _cipher}}} =
+      Protocol.out_payload(initiator)
+
+    send(responder, {:message3, self(), message3})
+
+    receive do
+      {:complete, ^responder} -> :ok
+    end
+
+    destroy(vault, [k1, k2, initiator.e.private])
+    state
+  end
+
+  defp responder(vault, static) do
+    receive do
+      {:message1, initiator, message1} ->
+        {:ok, protocol} = Protocol.setup(static, vault: vault)
+        {:ok, {:continue, protocol}} = Protocol.in_payload(protocol, message1)
+        {:ok, message2, {:continue, protocol}} = Protocol.out_payload(protocol)
+        send(initiator, {:message2, self(), message2})
+
+        message3 =
+          receive do
+            {:message3, ^initiator, message3} -> message3
+          end
+
+        {:ok, {:complete, {k1, k2, _h, _rs, _payloads, _cipher}}} =
+          Protocol.in_payload(protocol, message3)
+
+        destroy(vault, [k1, k2, protocol.e.private])
+        send(initiator, {:complete, self()})
+        responder(vault, static)
+
+      {:DOWN, _ref, :process, _initiator, _reason} ->
+        :ok
+    end
+  end
+
+  defp destroy(vault, secrets) do
+    Enum.each(secrets, fn secret -> :ok = Vault.secret_destroy(vault, secret) end)
+  end
+end
+
+{options, _args, _invalid} =
+  OptionParser.parse(System.argv(), strict: [iterations: :integer, concurrency: :string])
+
+concurrency =
+  options
+  |> Keyword.get(:concurrency, "1,8,64")
+  |> String.split(",")
+  |> Enum.map(&String.to_integer/1)
+
+Ockam.SecureChannel.Bench.run(Keyword.get(options, :iterations, 1_000), concurrency)
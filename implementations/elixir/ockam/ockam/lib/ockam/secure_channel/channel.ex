@@ -19,6 +19,11 @@ defmodule Ockam.SecureChannel.Channel do
     * Handshaking  (noise handshake)
     * Established (channel fully established and peer authenticated)
 
+  The `:ciphers` encryption option lists the transport ciphers this end supports, in order
+  of preference, `[:aes_gcm]` by default. On CPUs without AES instructions
+  `[:chacha20_poly1305, :aes_gcm]` lets peers which also support ChaCha20-Poly1305
+  negotiate it during the handshake, while still reaching peers which only speak AES-GCM.
+
   At this time, the implementation don't use a proper fsm as that's not directly supported
   by the Worker/AsymmetricWorker machinery.
   """
@@ -44,7 +49,11 @@ defmodule Ockam.SecureChannel.Channel do
 
   require Logger
 
-  @type encryption_options :: [{:vault, Vault}, {:static_keypair, reference()}]
+  @type encryption_options :: [
+          {:vault, Vault}
+          | {:static_keypair, reference()}
+          | {:ciphers, [XX.cipher()]}
+        ]
   @type authorization :: list() | map()
   @type trust_policies :: list()
   @type secure_channel_opt ::
@@ -111,6 +120,9 @@ defmodule Ockam.SecureChannel.Channel do
 
   @handshake_timeout 30_000
 
+  # Messages encrypted with a key before it's rotated, as in the rust implementation
+  @rekey_each 32
+
   @type listener_opt ::
           {:responder_authorization, authorization()}
           | secure_channel_opt()
@@ -352,7 +364,13 @@ defmodule Ockam.SecureChannel.Channel do
 
       encoded_proof = IdentityProof.encode(proof)
       payloads = noise_payloads(role, encoded_proof)
-      options = [vault: vault, payloads: payloads, static_keypair: static_keypair]
+      options = [
+        vault: vault,
+        payloads: payloads,
+        static_keypair: static_keypair,
+        ciphers: Keyword.get(opts, :ciphers, [:aes_gcm])
+      ]
+
       XX.setup(static_keypair, options)
     end
   end
@@ -400,7 +418,7 @@ defmodule Ockam.SecureChannel.Channel do
     encryption_options = Keyword.get(options, :encryption_options, [])
     key_exchange_timeout = Keyword.get(options, :key_exchange_timeout, @handshake_timeout)
     vault_name = Keyword.get(options, :vault_name)
-    noise_key_exchange_options = Keyword.take(encryption_options, [:static_keypair])
+    noise_key_exchange_options = Keyword.take(encryption_options, [:static_keypair, :ciphers])
     credentials = Keyword.get(options, :credentials, [])
 
     with {:ok, role} <- Keyword.fetch(options, :role),
@@ -458,7 +476,7 @@ defmodule Ockam.SecureChannel.Channel do
     {:ok, %Channel{state | channel_state: %Handshaking{h | xx: xx}}}
   end
 
-  defp next_handshake_state({:complete, {k1, k2, h, rs, payloads}}, state) do
+  defp next_handshake_state({:complete, {k1, k2, h, rs, payloads, cipher}}, state) do
     peer_proof_msg =
       case state.role do
         :initiator -> :message2
@@ -478,7 +496,7 @@ defmodule Ockam.SecureChannel.Channel do
              peer_identity_id,
              state.credential_verifier
            ) do
-      {encrypt_st, decrypt_st} = split(state.channel_state.vault, k1, k2, state.role)
+      {encrypt_st, decrypt_st} = split(state.channel_state.vault, k1, k2, state.role, cipher)
 
       {:ok, :cancel} = :timer.cancel(state.channel_state.timer)
 
@@ -517,11 +535,17 @@ defmodule Ockam.SecureChannel.Channel do
   defp process_credentials(_creds, _peer_identity_id, _cred_verifier),
     do: {:error, :multiple_credentials}
 
-  defp split(vault, k1, k2, :initiator),
-    do: {Encryptor.new(vault, k2, 0), Decryptor.new(vault, k1, 0)}
+  defp split(vault, k1, k2, :initiator, cipher),
+    do: {
+      Encryptor.new(vault, k2, 0, @rekey_each, cipher),
+      Decryptor.new(vault, k1, 0, @rekey_each, cipher)
+    }
 
-  defp split(vault, k1, k2, :responder),
-    do: {Encryptor.new(vault, k1, 0), Decryptor.new(vault, k2, 0)}
+  defp split(vault, k1, k2, :responder, cipher),
+    do: {
+      Encryptor.new(vault, k1, 0, @rekey_each, cipher),
+      Decryptor.new(vault, k2, 0, @rekey_each, cipher)
+    }
 
   # Check result of the handshake step, send handshake data to the peer if there is a message to exchange,
   # and possible move to another state
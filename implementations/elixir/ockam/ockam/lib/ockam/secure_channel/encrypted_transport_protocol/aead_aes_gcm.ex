@@ -1,43 +1,39 @@
 defmodule Ockam.SecureChannel.EncryptedTransportProtocol.AeadAesGcm do
   @moduledoc false
 
+  ## `rekey_each` must be between 1 and 65536 (64 Ki) messages, on both ends. The
+  ## decryptor keeps a bitmap of the nonces seen in each window of `rekey_each` messages.
+
   alias Ockam.Vault
-  alias __MODULE__
-  @max_nonce trunc(:math.pow(2, 64)) - 1
 
   defmodule Encryptor do
     @moduledoc false
     alias __MODULE__
-    defstruct [:vault, :k, :nonce, :rekey_each]
+    defstruct [:vault, :encryptor]
     @opaque t :: %Encryptor{}
 
     def new(vault, k, nonce), do: new(vault, k, nonce, 32)
 
-    def new(vault, k, nonce, rekey_each) do
-      %Encryptor{vault: vault, k: k, nonce: nonce, rekey_each: rekey_each}
+    def new(vault, k, nonce, rekey_each), do: new(vault, k, nonce, rekey_each, :aes_gcm)
+
+    ## The nonce counter and key rotation happen natively, with AES-GCM or ChaCha20-Poly1305
+    def new(vault, k, nonce, rekey_each, cipher) do
+      {:ok, encryptor} = Vault.aead_aes_gcm_encryptor_new(vault, k, nonce, rekey_each, cipher)
+      %Encryptor{vault: vault, encryptor: encryptor}
     end
 
-    def encrypt(
-          ad,
-          plaintext,
-          %Encryptor{vault: vault, k: k, nonce: nonce, rekey_each: rekey_each} = state
-        ) do
-      with {:ok, ciphertext} <- Vault.aead_aes_gcm_encrypt(vault, k, nonce, ad, plaintext),
-           {:ok, next_nonce} <- AeadAesGcm.increment_nonce(nonce),
-           {:ok, next_k, _} <- rotate_if_needed(vault, next_nonce, k, rekey_each) do
-        {:ok, <<nonce::unsigned-big-integer-size(64), ciphertext::binary>>,
-         %Encryptor{state | nonce: next_nonce, k: next_k}}
+    def encrypt(ad, plaintext, %Encryptor{vault: vault, encryptor: encryptor} = state) do
+      with {:ok, ciphertext} <-
+             Vault.aead_aes_gcm_encryptor_encrypt(vault, encryptor, ad, plaintext) do
+        {:ok, ciphertext, state}
       end
     end
 
-    defp rotate_if_needed(vault, next_nonce, k, rekey_each) do
-      if rem(next_nonce, rekey_each) == 0 do
-        with {:ok, new_k} <- AeadAesGcm.rekey(vault, k) do
-          :ok = Vault.secret_destroy(vault, k)
-          {:ok, new_k, true}
-        end
-      else
-        {:ok, k, false}
+    ## Encrypts a burst of `{ad, plaintext}` messages, one vault call per rekey window
+    def encrypt_batch(messages, %Encryptor{vault: vault, encryptor: encryptor} = state) do
+      with {:ok, ciphertexts} <-
+             Vault.aead_aes_gcm_encryptor_encrypt_batch(vault, encryptor, messages) do
+        {:ok, ciphertexts, state}
       end
     end
   end
@@ -45,144 +41,25 @@ defmodule Ockam.SecureChannel.EncryptedTransportProtocol.AeadAesGcm do
   defmodule Decryptor do
     @moduledoc false
     alias __MODULE__
-    defstruct [:vault, :k, :expected_nonce, :rekey_each, :prev_k, :seen, :prev_seen]
+    defstruct [:vault, :decryptor]
     @opaque t :: %Decryptor{}
 
     def new(vault, k, nonce), do: new(vault, k, nonce, 32)
 
-    def new(vault, k, nonce, rekey_each) do
-      %Decryptor{
-        vault: vault,
-        k: k,
-        expected_nonce: nonce,
-        rekey_each: rekey_each,
-        prev_k: nil,
-        seen: MapSet.new(),
-        prev_seen: MapSet.new()
-      }
-    end
-
-    ## window_offset=0  this k window
-    ## window_offset=-1 previous k window
-    ## window_offset=1  next k window
-    ## We don't allow out-of-order messages more than 1 rekey window away from the expected nonce
-    defp decrypt_from(
-           0,
-           nonce,
-           ad,
-           ciphertext,
-           %Decryptor{vault: vault, seen: seen, k: k, expected_nonce: expected_nonce} = state
-         ) do
-      if MapSet.member?(seen, nonce) do
-        {:error, :repeated_nonce}
-      else
-        {:ok, next_nonce} = AeadAesGcm.increment_nonce(nonce)
+    def new(vault, k, nonce, rekey_each), do: new(vault, k, nonce, rekey_each, :aes_gcm)
 
-        case Vault.aead_aes_gcm_decrypt(vault, k, nonce, ad, ciphertext) do
-          {:ok, plaintext} ->
-            {:ok, plaintext,
-             %Decryptor{
-               state
-               | seen: MapSet.put(seen, nonce),
-                 expected_nonce: max(expected_nonce, next_nonce)
-             }}
-
-          {:error, reason} ->
-            {:error, reason}
-        end
-      end
+    ## Nonce tracking, replay detection and key rotation happen natively, the
+    ## intervals around the expected nonce are defined to match the ones on rust implementation.
+    def new(vault, k, nonce, rekey_each, cipher) do
+      {:ok, decryptor} = Vault.aead_aes_gcm_decryptor_new(vault, k, nonce, rekey_each, cipher)
+      %Decryptor{vault: vault, decryptor: decryptor}
     end
 
-    defp decrypt_from(
-           -1,
-           nonce,
-           ad,
-           ciphertext,
-           %Decryptor{vault: vault, prev_seen: prev_seen, prev_k: prev_k} = state
-         ) do
-      if MapSet.member?(prev_seen, nonce) do
-        {:error, :repeated_nonce}
-      else
-        case Vault.aead_aes_gcm_decrypt(vault, prev_k, nonce, ad, ciphertext) do
-          {:ok, plaintext} ->
-            {:ok, plaintext, %Decryptor{state | prev_seen: MapSet.put(prev_seen, nonce)}}
-
-          {:error, reason} ->
-            {:error, reason}
-        end
-      end
-    end
-
-    defp decrypt_from(
-           1,
-           nonce,
-           ad,
-           ciphertext,
-           %Decryptor{vault: vault, seen: seen, prev_k: prev_k, k: k} = state
-         ) do
-      {:ok, next_nonce} = AeadAesGcm.increment_nonce(nonce)
-      {:ok, new_k} = AeadAesGcm.rekey(vault, k)
-
-      case Vault.aead_aes_gcm_decrypt(vault, new_k, nonce, ad, ciphertext) do
-        {:ok, plaintext} ->
-          if prev_k != nil do
-            :ok = Vault.secret_destroy(vault, prev_k)
-          end
-
-          {:ok, plaintext,
-           %Decryptor{
-             state
-             | prev_k: k,
-               k: new_k,
-               prev_seen: seen,
-               seen: MapSet.new([nonce]),
-               expected_nonce: next_nonce
-           }}
-
-        {:error, reason} ->
-          {:error, reason}
+    def decrypt(ad, ciphertext, %Decryptor{vault: vault, decryptor: decryptor} = state) do
+      case Vault.aead_aes_gcm_decryptor_decrypt(vault, decryptor, ad, ciphertext) do
+        {:ok, plaintext} -> {:ok, plaintext, state}
+        {:error, reason} -> {:error, reason}
       end
     end
-
-    defp decrypt_from(_n, _nonce, _ad, _ciphertext, _state) do
-      {:error, :out_of_window}
-    end
-
-    def decrypt(
-          ad,
-          <<nonce::unsigned-big-integer-size(64), ciphertext::binary>>,
-          state
-        ) do
-      # If we received till nonce 10,  state.expected_nonce is 11, the intervals around expected nonce are
-      # defined to match the ones on rust implementation.
-      if nonce >= state.expected_nonce - state.rekey_each and
-           nonce < state.expected_nonce + state.rekey_each do
-        # Calculate the key to use to attempt to decrypt the message,
-        # based on the rekey window that the received nonce falls into.
-        # -1 = previous key,  0 = current key, 1 = next key
-        # We can do this since nonce could never be below 0 (unsigned integer)
-        window_offset =
-          div(nonce, state.rekey_each) -
-            div(max(0, state.expected_nonce - 1), state.rekey_each)
-
-        decrypt_from(window_offset, nonce, ad, ciphertext, state)
-      else
-        {:error, :out_of_window}
-      end
-    end
-  end
-
-  def increment_nonce(n) do
-    case n + 1 do
-      @max_nonce -> {:error, nil}
-      valid_nonce -> {:ok, valid_nonce}
-    end
-  end
-
-  def rekey(vault, k) do
-    {:ok, <<new_k::binary-size(32), _::binary>>} =
-      Vault.aead_aes_gcm_encrypt(vault, k, @max_nonce, <<>>, <<0::32*8>>)
-
-    Vault.secret_import(vault, [type: :aes], new_k)
   end
 end
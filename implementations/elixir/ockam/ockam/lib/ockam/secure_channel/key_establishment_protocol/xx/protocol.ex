@@ -4,6 +4,7 @@ defmodule Ockam.SecureChannel.KeyEstablishmentProtocol.XX.Protocol do
   alias Ockam.Vault
 
   @type message :: :message1 | :message2 | :message3
+  @type cipher :: :aes_gcm | :chacha20_poly1305
   @type t :: %__MODULE__{}
 
   defstruct [
@@ -31,12 +32,30 @@ defmodule Ockam.SecureChannel.KeyEstablishmentProtocol.XX.Protocol do
     # payloads sent/received %{message() => binary},
     :payloads,
 
+    # transport ciphers supported, in order of preference [cipher()]
+    :ciphers,
+    # transport cipher negotiated
+    :cipher,
+
     # messages pending to complete the handshake [message()]
     :pending_handshake
   ]
 
   @default_prologue ""
   @default_payloads %{}
+  @default_ciphers [:aes_gcm]
+
+  # The handshake itself always uses AES-GCM, only the transport cipher is negotiated.
+  # An initiator supporting more than AES-GCM offers its ciphers in an envelope prepended
+  # to the message1 payload: the tag, the number of ciphers and their ids. The responder
+  # strips the envelope, so the application only sees its own payload.
+  # A responder choosing another cipher mixes its name into h before message2, so the
+  # initiator learns the choice from the h which authenticates message2, and the choice
+  # can't be tampered with. Peers which don't negotiate ignore the offer and mix nothing,
+  # which stands for AES-GCM.
+  @cipher_offer_tag "ockam_ciphers"
+  @cipher_ids %{aes_gcm: 1, chacha20_poly1305: 2}
+  @cipher_names %{chacha20_poly1305: "ChaChaPoly"}
 
   @protocol_name "Noise_XX_25519_AESGCM_SHA256"
   defmacro zero_padded_protocol_name do
@@ -53,6 +72,7 @@ defmodule Ockam.SecureChannel.KeyEstablishmentProtocol.XX.Protocol do
              s: static_keypair
            }),
          {:ok, protocol_state} <- setup_e(options, protocol_state),
+         {:ok, protocol_state} <- setup_ciphers(options, protocol_state),
          {:ok, protocol_state} <- setup_h(protocol_state),
          {:ok, protocol_state} <- setup_ck(protocol_state),
          {:ok, protocol_state} <- setup_prologue(options, protocol_state) do
@@ -75,11 +95,13 @@ defmodule Ockam.SecureChannel.KeyEstablishmentProtocol.XX.Protocol do
     end
   end
 
-  defp next(%{pending_handshake: [], vault: vault, ck: ck, h: h, rs: rs, payloads: payloads}) do
+  defp next(
+         %{pending_handshake: [], vault: vault, ck: ck, h: h, rs: rs, payloads: payloads} = state
+       ) do
     k_attributes = %{type: :aes, length: 32, persistence: :ephemeral}
 
     with {:ok, [k1, k2]} <- Vault.hkdf_sha256(vault, ck, [k_attributes, k_attributes]) do
-      {:ok, {:complete, {k1, k2, h, rs, payloads}}}
+      {:ok, {:complete, {k1, k2, h, rs, payloads, state.cipher}}}
     end
   end
 
@@ -113,6 +135,16 @@ defmodule Ockam.SecureChannel.KeyEstablishmentProtocol.XX.Protocol do
     end
   end
 
+  defp setup_ciphers(options, state) do
+    ciphers = Keyword.get(options, :ciphers, @default_ciphers)
+
+    if ciphers != [] and Enum.all?(ciphers, &Map.has_key?(@cipher_ids, &1)) do
+      {:ok, %{state | ciphers: Enum.uniq(ciphers), cipher: :aes_gcm}}
+    else
+      {:error, {:unsupported_ciphers, ciphers}}
+    end
+  end
+
   def turn_vault_private_key_handle_to_keypair(vault, handle) do
     with {:ok, public_key} <- Vault.secret_publickey_get(vault, handle) do
       {:ok, %{private: handle, public: public_key}}
@@ -155,7 +187,7 @@ defmodule Ockam.SecureChannel.KeyEstablishmentProtocol.XX.Protocol do
   end
 
   def encode(:message1, %{e: e, payloads: payloads} = state) do
-    payload = Map.get(payloads, :message1, "")
+    payload = cipher_offer(state.ciphers, Map.get(payloads, :message1, ""))
 
     with {:ok, state} <- mix_hash(state, e.public),
          {:ok, state} <- mix_hash(state, payload) do
@@ -167,11 +199,9 @@ defmodule Ockam.SecureChannel.KeyEstablishmentProtocol.XX.Protocol do
     payload = Map.get(payloads, :message2, "")
 
     with {:ok, state} <- mix_hash(state, e.public),
-         {:ok, shared_secret} <- dh(state, e, re),
-         {:ok, state} <- mix_key(state, shared_secret),
+         {:ok, state} <- dh_mix_key(state, e, re),
          {:ok, state, encrypted_s_and_tag} <- encrypt_and_hash(state, s.public),
-         {:ok, shared_secret} <- dh(state, s, re),
-         {:ok, state} <- mix_key(state, shared_secret),
+         {:ok, state} <- dh_mix_key(state, s, re),
          {:ok, state, encrypted_payload_and_tag} <- encrypt_and_hash(state, payload) do
       {:ok, e.public <> encrypted_s_and_tag <> encrypted_payload_and_tag, state}
     end
@@ -181,8 +211,7 @@ defmodule Ockam.SecureChannel.KeyEstablishmentProtocol.XX.Protocol do
     payload = Map.get(payloads, :message3, "")
 
     with {:ok, state, encrypted_s_and_tag} <- encrypt_and_hash(state, s.public),
-         {:ok, shared_secret} <- dh(state, s, re),
-         {:ok, state} <- mix_key(state, shared_secret),
+         {:ok, state} <- dh_mix_key(state, s, re),
          {:ok, state, encrypted_payload_and_tag} <- encrypt_and_hash(state, payload) do
       {:ok, encrypted_s_and_tag <> encrypted_payload_and_tag, state}
     end
@@ -191,19 +220,18 @@ defmodule Ockam.SecureChannel.KeyEstablishmentProtocol.XX.Protocol do
   def decode(:message1, state, message) do
     with {:ok, re, payload} <- parse_message1(message),
          {:ok, state} <- mix_hash(state, re),
-         {:ok, state} <- mix_hash(state, payload) do
+         {:ok, state} <- mix_hash(state, payload),
+         {offer, payload} = parse_cipher_offer(payload),
+         {:ok, state} <- choose_cipher(state, offer) do
       {:ok, payload, %{state | re: re}}
     end
   end
 
   def decode(:message2, %{e: e} = state, message) do
     with {:ok, re, encrypted_rs_and_tag, encrypted_payload_and_tag} <- parse_message2(message),
-         {:ok, state} <- mix_hash(state, re),
-         {:ok, shared_secret} <- dh(state, e, re),
-         {:ok, state} <- mix_key(state, shared_secret),
-         {:ok, state, rs} <- decrypt_and_hash(state, encrypted_rs_and_tag),
-         {:ok, shared_secret} <- dh(state, e, rs),
-         {:ok, state} <- mix_key(state, shared_secret),
+         {:ok, state} <- dh_mix_key(state, e, re),
+         {:ok, state, rs} <- decrypt_rs_with_chosen_cipher(state, re, encrypted_rs_and_tag),
+         {:ok, state} <- dh_mix_key(state, e, rs),
          {:ok, state, payload} <- decrypt_and_hash(state, encrypted_payload_and_tag) do
       {:ok, payload, %{state | re: re, rs: rs}}
     end
@@ -212,13 +240,58 @@ defmodule Ockam.SecureChannel.KeyEstablishmentProtocol.XX.Protocol do
   def decode(:message3, %{e: e} = state, message) do
     with {:ok, encrypted_rs_and_tag, encrypted_payload_and_tag} <- parse_message3(message),
          {:ok, state, rs} <- decrypt_and_hash(state, encrypted_rs_and_tag),
-         {:ok, shared_secret} <- dh(state, e, rs),
-         {:ok, state} <- mix_key(state, shared_secret),
+         {:ok, state} <- dh_mix_key(state, e, rs),
          {:ok, state, payload} <- decrypt_and_hash(state, encrypted_payload_and_tag) do
       {:ok, payload, %{state | rs: rs}}
     end
   end
 
+  # No offer when AES-GCM is the only cipher, so that message1 is the same as before
+  # negotiation, unless the payload starts like an envelope and would be stripped as one
+  defp cipher_offer([:aes_gcm], <<@cipher_offer_tag, _rest::binary>> = payload),
+    do: cipher_envelope([], payload)
+
+  defp cipher_offer([:aes_gcm], payload), do: payload
+  defp cipher_offer(ciphers, payload), do: cipher_envelope(ciphers, payload)
+
+  defp cipher_envelope(ciphers, payload) do
+    ids = for cipher <- ciphers, into: "", do: <<Map.fetch!(@cipher_ids, cipher)>>
+    <<@cipher_offer_tag, byte_size(ids), ids::binary, payload::binary>>
+  end
+
+  defp parse_cipher_offer(<<@cipher_offer_tag, count, ids::binary-size(count), rest::binary>>) do
+    {for(<<id <- ids>>, {cipher, ^id} <- @cipher_ids, do: cipher), rest}
+  end
+
+  defp parse_cipher_offer(payload), do: {[], payload}
+
+  # The first cipher offered by the initiator which the responder supports, AES-GCM otherwise
+  defp choose_cipher(%{ciphers: ciphers} = state, offer) do
+    case Enum.find(offer, &(&1 in ciphers)) do
+      nil -> {:ok, %{state | cipher: :aes_gcm}}
+      cipher -> mix_cipher(%{state | cipher: cipher}, cipher)
+    end
+  end
+
+  defp mix_cipher(state, :aes_gcm), do: {:ok, state}
+  defp mix_cipher(state, cipher), do: mix_hash(state, Map.fetch!(@cipher_names, cipher))
+
+  # Tries the h of each cipher offered, AES-GCM last as that's the choice of peers which
+  # don't negotiate, the one which authenticates the responder's static key was chosen
+  defp decrypt_rs_with_chosen_cipher(%{ciphers: ciphers} = state, re, encrypted_rs_and_tag) do
+    {others, aes_gcm} = Enum.split_with(ciphers, &(&1 != :aes_gcm))
+
+    Enum.reduce_while(others ++ aes_gcm, {:error, :no_cipher_offered}, fn cipher, _error ->
+      with {:ok, state} <- mix_cipher(%{state | cipher: cipher}, cipher),
+           {:ok, state} <- mix_hash(state, re),
+           {:ok, state, rs} <- decrypt_and_hash(state, encrypted_rs_and_tag) do
+        {:halt, {:ok, state, rs}}
+      else
+        error -> {:cont, error}
+      end
+    end)
+  end
+
   def parse_message1(<<re::32-bytes, payload::binary>>), do: {:ok, re, payload}
   def parse_message1(message), do: {:error, {:unexpected_structure, :message1, message}}
 
@@ -235,43 +308,39 @@ defmodule Ockam.SecureChannel.KeyEstablishmentProtocol.XX.Protocol do
   def parse_message3(message), do: {:error, {:unexpected_structure, :message3, message}}
 
   def mix_hash(%{vault: vault, h: h} = state, value) do
-    case Vault.sha256(vault, h <> value) do
+    case Vault.sha256(vault, [h, value]) do
       {:ok, h} -> {:ok, %{state | h: h}}
       error -> {:error, {:could_not_mix_hash, {state, value, error}}}
     end
   end
 
-  def mix_key(%{vault: vault, ck: ck} = state, input_key_material) do
+  # Noise MixKey(DH(keypair, peer_public)) in one vault call, the DH output never leaves the vault
+  def dh_mix_key(%{vault: vault, ck: ck} = state, keypair, peer_public) do
     ck_attributes = %{type: :buffer, length: 32, persistence: :ephemeral}
     k_attributes = %{type: :aes, length: 32, persistence: :ephemeral}
-    kdf_result = Vault.hkdf_sha256(vault, ck, input_key_material, [ck_attributes, k_attributes])
+
+    kdf_result =
+      Vault.ecdh_hkdf_sha256(vault, keypair.private, peer_public, ck, [
+        ck_attributes,
+        k_attributes
+      ])
 
     with {:ok, [ck, k]} <- kdf_result do
       {:ok, %{state | n: 0, ck: ck, k: k}}
     end
   end
 
-  def dh(%{vault: vault}, keypair, peer_public) do
-    Vault.ecdh(vault, keypair.private, peer_public)
-  end
-
   def encrypt_and_hash(%{vault: vault, k: k, n: n, h: h} = state, plaintext) do
-    with {:ok, k} <- Vault.secret_export(vault, k),
-         {:ok, k} <- Vault.secret_import(vault, [type: :aes], k),
-         {:ok, ciphertext_and_tag} <- Vault.aead_aes_gcm_encrypt(vault, k, n, h, plaintext),
-         :ok <- Vault.secret_destroy(vault, k),
-         {:ok, state} <- mix_hash(state, ciphertext_and_tag) do
-      {:ok, %{state | n: n + 1}, ciphertext_and_tag}
+    with {:ok, ciphertext_and_tag, h} <-
+           Vault.aead_aes_gcm_encrypt_and_hash(vault, k, n, h, plaintext) do
+      {:ok, %{state | n: n + 1, h: h}, ciphertext_and_tag}
     end
   end
 
   def decrypt_and_hash(%{vault: vault, k: k, n: n, h: h} = state, ciphertext_and_tag) do
-    with {:ok, k} <- Vault.secret_export(vault, k),
-         {:ok, k} <- Vault.secret_import(vault, [type: :aes], k),
-         {:ok, plaintext} <- Vault.aead_aes_gcm_decrypt(vault, k, n, h, ciphertext_and_tag),
-         :ok <- Vault.secret_destroy(vault, k),
-         {:ok, state} <- mix_hash(state, ciphertext_and_tag) do
-      {:ok, %{state | n: n + 1}, plaintext}
+    with {:ok, plaintext, h} <-
+           Vault.aead_aes_gcm_decrypt_and_hash(vault, k, n, h, ciphertext_and_tag) do
+      {:ok, %{state | n: n + 1, h: h}, plaintext}
     end
   end
 
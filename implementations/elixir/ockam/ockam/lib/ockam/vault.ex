@@ -10,11 +10,44 @@ defmodule Ockam.Vault do
   @doc """
     Computes a SHA-256 hash based on input data.
   """
-  @spec sha256(Ockam.Vault, binary | String.t()) :: {:ok, binary} | :error
+  @spec sha256(Ockam.Vault, iodata()) :: {:ok, binary} | :error
   def sha256(%vault_module{id: vault_id}, input) do
     vault_module.sha256(vault_id, input)
   end
 
+  @doc """
+    Creates a streaming SHA-256 context.
+  """
+  @spec sha256_init(Ockam.Vault) :: {:ok, reference()} | :error
+  def sha256_init(%vault_module{}) do
+    vault_module.sha256_init()
+  end
+
+  @doc """
+    Absorbs input data, a binary or an iolist, into a streaming SHA-256 context.
+  """
+  @spec sha256_update(Ockam.Vault, reference(), iodata()) :: :ok | :error
+  def sha256_update(%vault_module{}, context, input) do
+    vault_module.sha256_update(context, input)
+  end
+
+  @doc """
+    Computes the SHA-256 hash of all the data absorbed by a streaming context so far.
+    The context can keep absorbing data.
+  """
+  @spec sha256_final(Ockam.Vault, reference()) :: {:ok, binary} | :error
+  def sha256_final(%vault_module{}, context) do
+    vault_module.sha256_final(context)
+  end
+
+  @doc """
+    Copies a streaming SHA-256 context.
+  """
+  @spec sha256_clone(Ockam.Vault, reference()) :: {:ok, reference()} | :error
+  def sha256_clone(%vault_module{}, context) do
+    vault_module.sha256_clone(context)
+  end
+
   @doc """
     Fills output_buffer with randomly generate bytes.
   """
@@ -106,6 +139,30 @@ defmodule Ockam.Vault do
     vault_module.hkdf_sha256(vault_id, salt_handle, ikm_handle)
   end
 
+  @doc """
+    Performs an ECDH operation on the supplied ockam vault secret and peer_publickey, then
+    an HMAC-SHA256 based key derivation function with the supplied salt and the shared
+    secret as input key material. The shared secret is discarded inside the vault.
+    Returns handle to derived_output.
+  """
+  @spec ecdh_hkdf_sha256(Ockam.Vault, reference(), binary, reference(), list()) ::
+          {:ok, [reference()]} | :error
+  def ecdh_hkdf_sha256(
+        %vault_module{id: vault_id},
+        secret_handle,
+        peer_public_key,
+        salt_handle,
+        derived_outputs
+      ) do
+    vault_module.ecdh_hkdf_sha256(
+      vault_id,
+      secret_handle,
+      peer_public_key,
+      salt_handle,
+      derived_outputs
+    )
+  end
+
   @doc """
     Encrypts a payload using AES-GCM.
     Returns cipher_text after an encryption.
@@ -114,13 +171,110 @@ defmodule Ockam.Vault do
           Ockam.Vault,
           reference(),
           non_neg_integer(),
-          String.t() | binary,
-          binary | String.t()
+          iodata(),
+          iodata()
         ) :: {:ok, binary} | :error
   def aead_aes_gcm_encrypt(%vault_module{id: vault_id}, key_handle, nonce, ad, plain_text) do
     vault_module.aead_aes_gcm_encrypt(vault_id, key_handle, nonce, ad, plain_text)
   end
 
+  @doc """
+    Encrypts a payload using AES-GCM.
+    Returns cipher_text prefixed with its 64 bits big-endian nonce, in a single binary.
+  """
+  @spec aead_aes_gcm_encrypt_framed(
+          Ockam.Vault,
+          reference(),
+          non_neg_integer(),
+          iodata(),
+          iodata()
+        ) :: {:ok, binary} | :error
+  def aead_aes_gcm_encrypt_framed(
+        %vault_module{id: vault_id},
+        key_handle,
+        nonce,
+        ad,
+        plain_text
+      ) do
+    vault_module.aead_aes_gcm_encrypt_framed(vault_id, key_handle, nonce, ad, plain_text)
+  end
+
+  @doc """
+    Encrypts a batch of `{ad, plain_text}` messages using AES-GCM with consecutive
+    nonces starting at `start_nonce`, resolving the key only once.
+    Returns each cipher_text prefixed with its 64 bits big-endian nonce.
+  """
+  @spec aead_aes_gcm_encrypt_batch(
+          Ockam.Vault,
+          reference(),
+          non_neg_integer(),
+          [{binary, binary}]
+        ) :: {:ok, [binary]} | :error
+  def aead_aes_gcm_encrypt_batch(
+        %vault_module{id: vault_id},
+        key_handle,
+        start_nonce,
+        messages
+      ) do
+    vault_module.aead_aes_gcm_encrypt_batch(vault_id, key_handle, start_nonce, messages)
+  end
+
+  @doc """
+    Noise EncryptAndHash: encrypts a payload using AES-GCM with the handshake hash `h` as
+    additional data and mixes the cipher_text into `h`, in a single call.
+    The key can be any secret of 16 or 32 bytes, it is not exported.
+    Returns cipher_text and the next `h`.
+  """
+  @spec aead_aes_gcm_encrypt_and_hash(
+          Ockam.Vault,
+          reference(),
+          non_neg_integer(),
+          binary,
+          iodata()
+        ) :: {:ok, binary, binary} | {:error, any}
+  def aead_aes_gcm_encrypt_and_hash(
+        %vault_module{id: vault_id},
+        key_handle,
+        nonce,
+        h,
+        plain_text
+      ) do
+    vault_module.aead_aes_gcm_encrypt_and_hash(vault_id, key_handle, nonce, h, plain_text)
+  end
+
+  @doc """
+    Noise DecryptAndHash: decrypts a payload using AES-GCM with the handshake hash `h` as
+    additional data and mixes the cipher_text into `h`, in a single call.
+    The key can be any secret of 16 or 32 bytes, it is not exported.
+    Returns decrypted payload and the next `h`.
+  """
+  @spec aead_aes_gcm_decrypt_and_hash(
+          Ockam.Vault,
+          reference(),
+          non_neg_integer(),
+          binary,
+          iodata()
+        ) :: {:ok, binary, binary} | {:error, any}
+  def aead_aes_gcm_decrypt_and_hash(
+        %vault_module{id: vault_id},
+        key_handle,
+        nonce,
+        h,
+        cipher_text
+      ) do
+    vault_module.aead_aes_gcm_decrypt_and_hash(vault_id, key_handle, nonce, h, cipher_text)
+  end
+
+  @doc """
+    Derives the next AES-GCM key of a secure channel from `key_handle` inside the vault.
+    When `destroy_old` is true `key_handle` is destroyed in the same call.
+    Returns handle to the new key.
+  """
+  @spec aead_aes_gcm_rekey(Ockam.Vault, reference(), boolean()) :: {:ok, reference()} | :error
+  def aead_aes_gcm_rekey(%vault_module{id: vault_id}, key_handle, destroy_old \\ false) do
+    vault_module.aead_aes_gcm_rekey(vault_id, key_handle, destroy_old)
+  end
+
   @doc """
     Decrypts a payload using AES-GCM.
     Returns decrypted payload.
@@ -129,13 +283,172 @@ defmodule Ockam.Vault do
           Ockam.Vault,
           reference(),
           non_neg_integer(),
-          binary | String.t(),
-          binary
+          iodata(),
+          iodata()
         ) :: {:ok, binary | String.t()} | :error
   def aead_aes_gcm_decrypt(%vault_module{id: vault_id}, key_handle, nonce, ad, cipher_text) do
     vault_module.aead_aes_gcm_decrypt(vault_id, key_handle, nonce, ad, cipher_text)
   end
 
+  @doc """
+    Encrypts a payload using ChaCha20-Poly1305, faster than AES-GCM on CPUs without
+    AES instructions.
+    Returns cipher_text after an encryption.
+  """
+  @spec aead_chacha20_poly1305_encrypt(
+          Ockam.Vault,
+          reference(),
+          non_neg_integer(),
+          iodata(),
+          iodata()
+        ) :: {:ok, binary} | :error
+  def aead_chacha20_poly1305_encrypt(
+        %vault_module{id: vault_id},
+        key_handle,
+        nonce,
+        ad,
+        plain_text
+      ) do
+    vault_module.aead_chacha20_poly1305_encrypt(vault_id, key_handle, nonce, ad, plain_text)
+  end
+
+  @doc """
+    Decrypts a payload using ChaCha20-Poly1305.
+    Returns decrypted payload.
+  """
+  @spec aead_chacha20_poly1305_decrypt(
+          Ockam.Vault,
+          reference(),
+          non_neg_integer(),
+          iodata(),
+          iodata()
+        ) :: {:ok, binary | String.t()} | :error
+  def aead_chacha20_poly1305_decrypt(
+        %vault_module{id: vault_id},
+        key_handle,
+        nonce,
+        ad,
+        cipher_text
+      ) do
+    vault_module.aead_chacha20_poly1305_decrypt(vault_id, key_handle, nonce, ad, cipher_text)
+  end
+
+  @doc """
+    Creates a stateful encryptor starting at `nonce`, which rotates its key
+    every `rekey_each` messages. `cipher` is `:aes_gcm` or `:chacha20_poly1305`.
+    The encryptor takes ownership of `key_handle` and destroys it when garbage collected.
+  """
+  @spec aead_aes_gcm_encryptor_new(
+          Ockam.Vault,
+          reference(),
+          non_neg_integer(),
+          pos_integer(),
+          :aes_gcm | :chacha20_poly1305
+        ) :: {:ok, reference()} | :error
+  def aead_aes_gcm_encryptor_new(
+        %vault_module{id: vault_id},
+        key_handle,
+        nonce,
+        rekey_each,
+        cipher \\ :aes_gcm
+      ) do
+    vault_module.aead_aes_gcm_encryptor_new(vault_id, key_handle, nonce, rekey_each, cipher)
+  end
+
+  @doc """
+    Creates a stateful ChaCha20-Poly1305 encryptor, same as
+    `aead_aes_gcm_encryptor_new/5` with `:chacha20_poly1305`.
+  """
+  @spec aead_chacha20_poly1305_encryptor_new(
+          Ockam.Vault,
+          reference(),
+          non_neg_integer(),
+          pos_integer()
+        ) :: {:ok, reference()} | :error
+  def aead_chacha20_poly1305_encryptor_new(
+        %vault_module{id: vault_id},
+        key_handle,
+        nonce,
+        rekey_each
+      ) do
+    vault_module.aead_chacha20_poly1305_encryptor_new(vault_id, key_handle, nonce, rekey_each)
+  end
+
+  @doc """
+    Encrypts a payload with the next nonce of an encryptor created with
+    `aead_aes_gcm_encryptor_new/4`.
+    Returns cipher_text prefixed with its 64 bits big-endian nonce.
+  """
+  @spec aead_aes_gcm_encryptor_encrypt(Ockam.Vault, reference(), iodata(), iodata()) ::
+          {:ok, binary} | {:error, atom() | charlist()}
+  def aead_aes_gcm_encryptor_encrypt(%vault_module{}, encryptor, ad, plain_text) do
+    vault_module.aead_aes_gcm_encryptor_encrypt(encryptor, ad, plain_text)
+  end
+
+  @doc """
+    Encrypts a batch of `{ad, plain_text}` messages with consecutive nonces of an
+    encryptor created with `aead_aes_gcm_encryptor_new/4`.
+    Returns each cipher_text prefixed with its 64 bits big-endian nonce.
+  """
+  @spec aead_aes_gcm_encryptor_encrypt_batch(Ockam.Vault, reference(), [{binary, binary}]) ::
+          {:ok, [binary]} | {:error, atom() | charlist()}
+  def aead_aes_gcm_encryptor_encrypt_batch(%vault_module{}, encryptor, messages) do
+    vault_module.aead_aes_gcm_encryptor_encrypt_batch(encryptor, messages)
+  end
+
+  @doc """
+    Creates a stateful decryptor starting at `nonce`, which rotates its key
+    every `rekey_each` messages and rejects repeated or out-of-window nonces.
+    `cipher` is `:aes_gcm` or `:chacha20_poly1305`.
+    The decryptor takes ownership of `key_handle` and destroys it when garbage collected.
+  """
+  @spec aead_aes_gcm_decryptor_new(
+          Ockam.Vault,
+          reference(),
+          non_neg_integer(),
+          pos_integer(),
+          :aes_gcm | :chacha20_poly1305
+        ) :: {:ok, reference()} | :error
+  def aead_aes_gcm_decryptor_new(
+        %vault_module{id: vault_id},
+        key_handle,
+        nonce,
+        rekey_each,
+        cipher \\ :aes_gcm
+      ) do
+    vault_module.aead_aes_gcm_decryptor_new(vault_id, key_handle, nonce, rekey_each, cipher)
+  end
+
+  @doc """
+    Creates a stateful ChaCha20-Poly1305 decryptor, same as
+    `aead_aes_gcm_decryptor_new/5` with `:chacha20_poly1305`.
+  """
+  @spec aead_chacha20_poly1305_decryptor_new(
+          Ockam.Vault,
+          reference(),
+          non_neg_integer(),
+          pos_integer()
+        ) :: {:ok, reference()} | :error
+  def aead_chacha20_poly1305_decryptor_new(
+        %vault_module{id: vault_id},
+        key_handle,
+        nonce,
+        rekey_each
+      ) do
+    vault_module.aead_chacha20_poly1305_decryptor_new(vault_id, key_handle, nonce, rekey_each)
+  end
+
+  @doc """
+    Decrypts a frame made of a 64 bits big-endian nonce followed by the cipher_text
+    using a decryptor created with `aead_aes_gcm_decryptor_new/4`.
+    Returns decrypted payload.
+  """
+  @spec aead_aes_gcm_decryptor_decrypt(Ockam.Vault, reference(), iodata(), iodata()) ::
+          {:ok, binary} | {:error, atom() | charlist()}
+  def aead_aes_gcm_decryptor_decrypt(%vault_module{}, decryptor, ad, frame) do
+    vault_module.aead_aes_gcm_decryptor_decrypt(decryptor, ad, frame)
+  end
+
   @doc """
     Deinitializes the specified ockam vault object.
   """
@@ -26,6 +26,49 @@ defmodule Ockam.SecureChannel.EncryptedTransportProtocol.AeadAesGcmTests do
     end)
   end
 
+  test "normal flow with chacha20_poly1305" do
+    {:ok, encryptor_vault} = SoftwareVault.init()
+    {:ok, decryptor_vault} = SoftwareVault.init()
+    shared_k = :crypto.strong_rand_bytes(32)
+    {:ok, ke} = Vault.secret_import(encryptor_vault, [type: :aes], shared_k)
+    {:ok, kd} = Vault.secret_import(decryptor_vault, [type: :aes], shared_k)
+    encryptor = Encryptor.new(encryptor_vault, ke, 0, 32, :chacha20_poly1305)
+    decryptor = Decryptor.new(decryptor_vault, kd, 0, 32, :chacha20_poly1305)
+
+    Enum.reduce(0..200, {encryptor, decryptor}, fn _i, {encryptor, decryptor} ->
+      plain = :crypto.strong_rand_bytes(64)
+      {:ok, ciphertext, encryptor} = Encryptor.encrypt(<<>>, plain, encryptor)
+      {:ok, ^plain, decryptor} = Decryptor.decrypt(<<>>, ciphertext, decryptor)
+      {encryptor, decryptor}
+    end)
+  end
+
+  test "batch encryption across rekey windows" do
+    {:ok, encryptor_vault} = SoftwareVault.init()
+    {:ok, decryptor_vault} = SoftwareVault.init()
+    shared_k = :crypto.strong_rand_bytes(32)
+    {:ok, ke} = Vault.secret_import(encryptor_vault, [type: :aes], shared_k)
+    {:ok, kd} = Vault.secret_import(decryptor_vault, [type: :aes], shared_k)
+    encryptor = Encryptor.new(encryptor_vault, ke, 0, 32)
+    decryptor = Decryptor.new(decryptor_vault, kd, 0, 32)
+
+    Enum.reduce(1..5, {encryptor, decryptor}, fn i, {encryptor, decryptor} ->
+      plains = Enum.map(1..(i * 17), fn _ -> :crypto.strong_rand_bytes(64) end)
+      messages = Enum.map(plains, fn plain -> {<<>>, plain} end)
+      {:ok, ciphertexts, encryptor} = Encryptor.encrypt_batch(messages, encryptor)
+
+      decryptor =
+        plains
+        |> Enum.zip(ciphertexts)
+        |> Enum.reduce(decryptor, fn {plain, ciphertext}, decryptor ->
+          {:ok, ^plain, decryptor} = Decryptor.decrypt(<<>>, ciphertext, decryptor)
+          decryptor
+        end)
+
+      {encryptor, decryptor}
+    end)
+  end
+
   test "message lost" do
     {:ok, encryptor_vault} = SoftwareVault.init()
     {:ok, decryptor_vault} = SoftwareVault.init()
@@ -86,10 +86,10 @@ defmodule Ockam.SecureChannel.KeyEstablishmentProtocol.XX.Protocol.Tests do
     {:ok, {:continue, initiator_state}} =
       Protocol.in_payload(initiator_state, message_2_ciphertext)
 
-    {:ok, message_3_ciphertext, {:complete, {k1_i, k2_i, h_i, _rs, p_i}}} =
+    {:ok, message_3_ciphertext, {:complete, {k1_i, k2_i, h_i, _rs, p_i, :aes_gcm}}} =
       Protocol.out_payload(initiator_state)
 
-    {:ok, {:complete, {k1_r, k2_r, h_r, _rs, p_r}}} =
+    {:ok, {:complete, {k1_r, k2_r, h_r, _rs, p_r, :aes_gcm}}} =
       Protocol.in_payload(responder_state, message_3_ciphertext)
 
     assert Vault.secret_export(vault, k1_i) == Vault.secret_export(vault, k1_r)
@@ -107,4 +107,68 @@ defmodule Ockam.SecureChannel.KeyEstablishmentProtocol.XX.Protocol.Tests do
     assert do_test(@test_case1)
     assert do_test(@test_case2)
   end
+
+  def negotiate(initiator_ciphers, responder_ciphers, message1_payload \\ "") do
+    {:ok, vault} = SoftwareVault.init()
+    {:ok, initiator_static} = Protocol.generate_keypair(vault)
+    {:ok, responder_static} = Protocol.generate_keypair(vault)
+
+    {:ok, initiator} =
+      Protocol.setup(initiator_static,
+        vault: vault,
+        ciphers: initiator_ciphers,
+        payloads: %{message1: message1_payload}
+      )
+
+    {:ok, responder} = Protocol.setup(responder_static, vault: vault, ciphers: responder_ciphers)
+
+    {:ok, message1, {:continue, initiator}} = Protocol.out_payload(initiator)
+    {:ok, {:continue, responder}} = Protocol.in_payload(responder, message1)
+    {:ok, message2, {:continue, responder}} = Protocol.out_payload(responder)
+    {:ok, {:continue, initiator}} = Protocol.in_payload(initiator, message2)
+
+    {:ok, message3, {:complete, {k1_i, _k2, h_i, _rs, _p, cipher_i}}} =
+      Protocol.out_payload(initiator)
+
+    {:ok, {:complete, {k1_r, _k2, h_r, _rs, p_r, cipher_r}}} =
+      Protocol.in_payload(responder, message3)
+
+    assert Vault.secret_export(vault, k1_i) == Vault.secret_export(vault, k1_r)
+    assert h_i == h_r
+    assert p_r.message1 == message1_payload
+    assert cipher_i == cipher_r
+    cipher_i
+  end
+
+  test "negotiates the transport cipher" do
+    both = [:chacha20_poly1305, :aes_gcm]
+
+    assert :chacha20_poly1305 == negotiate(both, both)
+    assert :chacha20_poly1305 == negotiate(both, [:aes_gcm, :chacha20_poly1305])
+    assert :aes_gcm == negotiate(both, [:aes_gcm])
+    assert :aes_gcm == negotiate([:aes_gcm], both)
+  end
+
+  test "negotiates the transport cipher along a message1 payload" do
+    both = [:chacha20_poly1305, :aes_gcm]
+
+    assert :chacha20_poly1305 == negotiate(both, both, "hello")
+    assert :aes_gcm == negotiate(both, [:aes_gcm], "hello")
+  end
+
+  test "doesn't take a message1 payload which looks like an offer for one" do
+    both = [:chacha20_poly1305, :aes_gcm]
+    payload = <<"ockam_ciphers", 1, 2, "hello">>
+
+    assert :aes_gcm == negotiate([:aes_gcm], both, payload)
+    assert :chacha20_poly1305 == negotiate(both, both, payload)
+  end
+
+  test "rejects unknown ciphers" do
+    {:ok, vault} = SoftwareVault.init()
+    {:ok, static} = Protocol.generate_keypair(vault)
+
+    assert {:error, {:unsupported_ciphers, [:des]}} ==
+             Protocol.setup(static, vault: vault, ciphers: [:des])
+  end
 end
@@ -45,7 +45,14 @@ defmodule Ockam.Metrics.Application do
       {Ockam.Metrics.TelemetryPoller, :dispatch_secure_channels_count, []}
     ]
 
+    vault_measurements =
+      if Code.ensure_loaded?(Ockam.Vault.Software) do
+        [{Ockam.Metrics.TelemetryPoller, :dispatch_vault_stats, []}]
+      else
+        []
+      end
+
     config_measurements = Application.get_env(:ockam_metrics, :poller_measurements, [])
-    ockam_measurements ++ config_measurements
+    ockam_measurements ++ vault_measurements ++ config_measurements
   end
 end
@@ -5,7 +5,7 @@ defmodule Ockam.Metrics do
   alias Telemetry.Metrics
 
   def node_metrics() do
-    vm_metrics() ++ ockam_workers_metrics() ++ ockam_message_metrics()
+    vm_metrics() ++ ockam_workers_metrics() ++ ockam_message_metrics() ++ ockam_vault_metrics()
   end
 
   def vm_metrics() do
@@ -127,6 +127,25 @@ defmodule Ockam.Metrics do
     ]
   end
 
+  def ockam_vault_metrics() do
+    [
+      Metrics.last_value("ockam.vault.nif.calls", tags: [:function]),
+      Metrics.last_value("ockam.vault.nif.errors", tags: [:function]),
+      Metrics.last_value("ockam.vault.nif.bytes_in", tags: [:function], unit: :byte),
+      Metrics.last_value("ockam.vault.nif.bytes_out", tags: [:function], unit: :byte),
+      Metrics.last_value("ockam.vault.nif.latency_p50_ns",
+        tags: [:function],
+        description: "Median NIF latency since the previous poll"
+      ),
+      Metrics.last_value("ockam.vault.nif.latency_p99_ns",
+        tags: [:function],
+        description: "99th percentile NIF latency since the previous poll"
+      ),
+      Metrics.last_value("ockam.vault.handles.vaults"),
+      Metrics.last_value("ockam.vault.handles.secrets")
+    ]
+  end
+
   defp extract_reason(reason) do
     case reason do
       atom when is_atom(atom) ->
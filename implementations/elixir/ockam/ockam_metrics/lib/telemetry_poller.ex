@@ -140,6 +140,68 @@ defmodule Ockam.Metrics.TelemetryPoller do
     end
   end
 
+  if Code.ensure_loaded?(Ockam.Vault.Software) do
+    def dispatch_vault_stats() do
+      case Ockam.Vault.Software.stats() do
+        {:ok, %{nifs: nifs, vaults: vaults, secrets: secrets}} ->
+          Enum.each(nifs, fn {function, stats} ->
+            latency = latency_since_last_poll(function, stats.latency)
+
+            Telemetry.emit_event([:vault, :nif],
+              measurements: %{
+                calls: stats.calls,
+                errors: stats.errors,
+                bytes_in: stats.bytes_in,
+                bytes_out: stats.bytes_out,
+                latency_p50_ns: latency_percentile(latency, 0.5),
+                latency_p99_ns: latency_percentile(latency, 0.99)
+              },
+              metadata: %{function: to_string(function)}
+            )
+          end)
+
+          Telemetry.emit_event([:vault, :handles],
+            measurements: %{vaults: vaults, secrets: secrets}
+          )
+
+        {:error, reason} ->
+          Logger.error("Cannot report vault stats: #{inspect(reason)}")
+      end
+    catch
+      type, error ->
+        {type, error}
+    end
+
+    ## The NIF histograms are cumulative since the library was loaded, percentiles are
+    ## computed over the calls made since the previous poll by this process so they
+    ## follow the current latency
+    defp latency_since_last_poll(function, buckets) do
+      key = {__MODULE__, :vault_latency, function}
+      previous = Process.put(key, buckets) || Enum.map(buckets, fn _count -> 0 end)
+
+      buckets
+      |> Enum.zip(previous)
+      |> Enum.map(fn {count, previous_count} -> count - previous_count end)
+    end
+
+    ## Upper bound of the latency bucket holding the percentile, in nanoseconds:
+    ## bucket `i` counts the calls which took less than 2^i ns
+    defp latency_percentile(buckets, percentile) do
+      total = Enum.sum(buckets)
+      rank = max(1, ceil(total * percentile))
+
+      buckets
+      |> Enum.with_index()
+      |> Enum.reduce_while(0, fn {count, bucket}, seen ->
+        if seen + count >= rank, do: {:halt, {:bucket, bucket}}, else: {:cont, seen + count}
+      end)
+      |> case do
+        {:bucket, bucket} when total > 0 -> Bitwise.bsl(1, bucket)
+        _empty -> 0
+      end
+    end
+  end
+
   defp application_started?(app) do
     case List.keyfind(Application.started_applications(), app, 0) do
       {^app, _description, _version} -> true
@@ -109,4 +109,38 @@ defmodule Ockam.Metrics.TelemetryPoller.Tests do
       data_responders: [_]
     } = TelemetryPoller.secure_channels()
   end
+
+  test "vault latency percentiles cover the calls since the previous poll" do
+    test_pid = self()
+    handler = "vault-stats-#{inspect(test_pid)}"
+
+    :ok =
+      :telemetry.attach(
+        handler,
+        [:ockam, :vault, :nif],
+        fn _event, measurements, %{function: function}, _config ->
+          send(test_pid, {:vault_nif, self(), function, measurements})
+        end,
+        nil
+      )
+
+    on_exit(fn -> :telemetry.detach(handler) end)
+
+    {:ok, vault} = SoftwareVault.default_init()
+    {:ok, _hashes} = SoftwareVault.sha256_many(vault, ["warm up"])
+
+    TelemetryPoller.dispatch_vault_stats()
+    assert_receive {:vault_nif, ^test_pid, "sha256_many", %{latency_p50_ns: p50}}
+    assert p50 > 0
+
+    ## No sha256_many call since the previous poll
+    TelemetryPoller.dispatch_vault_stats()
+    assert_receive {:vault_nif, ^test_pid, "sha256_many", %{latency_p50_ns: 0, latency_p99_ns: 0}}
+
+    {:ok, _hashes} = SoftwareVault.sha256_many(vault, ["test"])
+
+    TelemetryPoller.dispatch_vault_stats()
+    assert_receive {:vault_nif, ^test_pid, "sha256_many", %{latency_p50_ns: p50}}
+    assert p50 > 0
+  end
 end
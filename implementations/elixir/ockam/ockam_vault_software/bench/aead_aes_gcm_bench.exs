@@ -0,0 +1,95 @@
+# AES-GCM encryptor / decryptor resources, as driven by secure channels.
+#
+#   mix run bench/aead_aes_gcm_bench.exs [--iterations 1000] [--concurrency 1,8,64]
+
+Code.require_file("bench_helper.exs", __DIR__)
+
+defmodule Ockam.Vault.Software.Bench.AeadAesGcm do
+  @moduledoc false
+
+  alias Ockam.Vault.Software, as: SoftwareVault
+  alias Ockam.Vault.Software.Bench
+
+  @sizes [64, 1024, 16 * 1024, 64 * 1024]
+  @rekey_intervals [32, 1024]
+  @windows [4, 16, 30]
+  @attributes %{type: :aes, persistence: :ephemeral, length: 32}
+
+  def run(iterations, concurrency) do
+    for rekey_each <- @rekey_intervals do
+      Bench.print_header("encrypt + decrypt round trip, rekey every #{rekey_each} messages")
+
+      for size <- @sizes, procs <- concurrency do
+        Bench.run(
+          "#{size} bytes",
+          procs,
+          iterations,
+          fn -> setup(rekey_each, size) end,
+          &round_trip/1
+        )
+      end
+    end
+
+    Bench.print_header("out of order decrypt, 1024 bytes, rekey every 32 messages")
+
+    for window <- @windows, procs <- concurrency do
+      Bench.run(
+        "shuffled in windows of #{window}",
+        procs,
+        iterations,
+        fn -> setup_out_of_order(iterations, window) end,
+        &decrypt_next/1
+      )
+    end
+  end
+
+  # The encryptor destroys the key it rotates away from, which the decryptor may still
+  # need, so each side gets its own vault like two ends of a channel would
+  defp setup(rekey_each, size) do
+    key = :crypto.strong_rand_bytes(32)
+    {:ok, encryptor} = new(:aead_aes_gcm_encryptor_new, key, rekey_each)
+    {:ok, decryptor} = new(:aead_aes_gcm_decryptor_new, key, rekey_each)
+    {encryptor, decryptor, :crypto.strong_rand_bytes(size)}
+  end
+
+  defp new(constructor, key, rekey_each) do
+    {:ok, vault} = SoftwareVault.default_init()
+    {:ok, secret} = SoftwareVault.secret_import(vault, @attributes, key)
+    apply(SoftwareVault, constructor, [vault, secret, 0, rekey_each])
+  end
+
+  defp round_trip({encryptor, decryptor, plain_text} = state) do
+    {:ok, frame} = SoftwareVault.aead_aes_gcm_encryptor_encrypt(encryptor, <<>>, plain_text)
+    {:ok, ^plain_text} = SoftwareVault.aead_aes_gcm_decryptor_decrypt(decryptor, <<>>, frame)
+    state
+  end
+
+  defp setup_out_of_order(iterations, window) do
+    {encryptor, decryptor, plain_text} = setup(32, 1024)
+
+    frames =
+      Enum.map(1..iterations, fn _ ->
+        {:ok, frame} = SoftwareVault.aead_aes_gcm_encryptor_encrypt(encryptor, <<>>, plain_text)
+        frame
+      end)
+
+    frames = frames |> Enum.chunk_every(window) |> Enum.flat_map(&Enum.shuffle/1)
+    {decryptor, frames, plain_text}
+  end
+
+  defp decrypt_next({decryptor, [frame | frames], plain_text}) do
+    {:ok, ^plain_text} = SoftwareVault.aead_aes_gcm_decryptor_decrypt(decryptor, <<>>, frame)
+    {decryptor, frames, plain_text}
+  end
+end
+
+{options, _args, _invalid} =
+  OptionParser.parse(System.argv(), strict: [iterations: :integer, concurrency: :string])
+
+concurrency =
+  options
+  |> Keyword.get(:concurrency, "1,8,64")
+  |> String.split(",")
+  |> Enum.map(&String.to_integer/1)
+
+Ockam.Vault.Software.Bench.AeadAesGcm.run(Keyword.get(options, :iterations, 1_000), concurrency)
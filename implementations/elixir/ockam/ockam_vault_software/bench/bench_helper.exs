@@ -0,0 +1,128 @@
+defmodule Ockam.Vault.Software.Bench do
+  @moduledoc """
+  Minimal benchmark runner for the vault NIFs, no external dependencies.
+
+  Besides throughput and latency percentiles, every case reports the utilization of the
+  normal and dirty CPU schedulers and the reductions spent per operation. A NIF that
+  blocks its scheduler for too long shows up as normal scheduler utilization climbing
+  while throughput doesn't scale with concurrency.
+  """
+
+  @header [
+    "case",
+    "procs",
+    "ops",
+    "ops/s",
+    "p50 us",
+    "p99 us",
+    "normal util",
+    "dirty cpu util",
+    "reds/op"
+  ]
+
+  def print_header(title) do
+    IO.puts("\n## #{title}\n")
+    print_row(@header)
+  end
+
+  @doc """
+  Run `fun` `iterations` times in each of `concurrency` processes and print the results.
+
+  `setup` runs once in each process before the clock starts, and its result is the initial
+  state passed to `fun`, which returns the next state. Only the calls to `fun` are timed.
+  """
+  def run(name, concurrency, iterations, setup, fun) do
+    parent = self()
+
+    pids =
+      Enum.map(1..concurrency, fn _ ->
+        spawn_link(fn -> worker(parent, iterations, setup, fun) end)
+      end)
+
+    Enum.each(pids, fn pid ->
+      receive do
+        {:ready, ^pid} -> :ok
+      end
+    end)
+
+    :erlang.system_flag(:scheduler_wall_time, true)
+    {reductions_before, _} = :erlang.statistics(:reductions)
+    sample_before = :scheduler.sample_all()
+    started = System.monotonic_time()
+
+    Enum.each(pids, &send(&1, :go))
+
+    latencies =
+      Enum.flat_map(pids, fn pid ->
+        receive do
+          {:done, ^pid, latencies} -> latencies
+        end
+      end)
+
+    elapsed = System.monotonic_time() - started
+    utilization = :scheduler.utilization(sample_before, :scheduler.sample_all())
+    {reductions_after, _} = :erlang.statistics(:reductions)
+    :erlang.system_flag(:scheduler_wall_time, false)
+
+    ops = concurrency * iterations
+    seconds = System.convert_time_unit(elapsed, :native, :microsecond) / 1_000_000
+    sorted = latencies |> Enum.sort() |> List.to_tuple()
+
+    print_row([
+      name,
+      concurrency,
+      ops,
+      round(ops / max(seconds, 1.0e-9)),
+      to_microseconds(percentile(sorted, 50)),
+      to_microseconds(percentile(sorted, 99)),
+      format_utilization(utilization, :normal),
+      format_utilization(utilization, :cpu),
+      div(reductions_after - reductions_before, ops)
+    ])
+  end
+
+  defp worker(parent, iterations, setup, fun) do
+    state = setup.()
+    send(parent, {:ready, self()})
+
+    receive do
+      :go -> :ok
+    end
+
+    {latencies, _state} =
+      Enum.reduce(1..iterations, {[], state}, fn _, {latencies, state} ->
+        started = System.monotonic_time()
+        state = fun.(state)
+        {[System.monotonic_time() - started | latencies], state}
+      end)
+
+    send(parent, {:done, self(), latencies})
+  end
+
+  defp percentile(sorted, p) do
+    index = min(div(tuple_size(sorted) * p, 100), tuple_size(sorted) - 1)
+    elem(sorted, index)
+  end
+
+  defp to_microseconds(native) do
+    Float.round(System.convert_time_unit(native, :native, :nanosecond) / 1000, 1)
+  end
+
+  # Average utilization of the schedulers of one type, in percent
+  defp format_utilization(utilization, type) do
+    values = for {^type, _id, value, _formatted} <- utilization, do: value
+
+    case values do
+      [] -> "-"
+      _ -> "#{Float.round(Enum.sum(values) / length(values) * 100, 1)}%"
+    end
+  end
+
+  defp print_row(columns) do
+    [name | rest] = Enum.map(columns, &to_string/1)
+
+    IO.puts(
+      String.pad_trailing(name, 36) <> Enum.map_join(rest, "", &String.pad_leading(&1, 15))
+    )
+  end
+end
@@ -49,7 +49,7 @@ popd
 cc \
   -I "$NIF_SOURCE_DIR" -I "$OCKAM_FFI_DIR/include" -I "$ERLANG_INCLUDE_DIR" \
   -arch x86_64 -m64 "$OCKAM_ROOT/target/x86_64-apple-darwin/release/libockam_ffi.a" \
-  "$NIF_SOURCE_DIR/common.c" "$NIF_SOURCE_DIR/nifs.c" "$NIF_SOURCE_DIR/vault.c" \
+  "$NIF_SOURCE_DIR/common.c" "$NIF_SOURCE_DIR/nifs.c" "$NIF_SOURCE_DIR/vault.c" "$NIF_SOURCE_DIR/aead_aes_gcm.c" "$NIF_SOURCE_DIR/sha256.c" "$NIF_SOURCE_DIR/stats.c" "$NIF_SOURCE_DIR/async.c" "$NIF_SOURCE_DIR/aead_stream.c" \
   -O3 -fPIC -shared -Wl,-undefined,dynamic_lookup \
   -o "$BUILD_DIR/darwin_x86_64/native/libockam_elixir_ffi.dylib"
 
@@ -67,7 +67,7 @@ cc \
   -I "$OCKAM_FFI_DIR/include" \
   -I "$ERLANG_INCLUDE_DIR" \
   -arch arm64 "$OCKAM_ROOT/target/aarch64-apple-darwin/release/libockam_ffi.a" \
-  "$NIF_SOURCE_DIR/common.c" "$NIF_SOURCE_DIR/nifs.c" "$NIF_SOURCE_DIR/vault.c" \
+  "$NIF_SOURCE_DIR/common.c" "$NIF_SOURCE_DIR/nifs.c" "$NIF_SOURCE_DIR/vault.c" "$NIF_SOURCE_DIR/aead_aes_gcm.c" "$NIF_SOURCE_DIR/sha256.c" "$NIF_SOURCE_DIR/stats.c" "$NIF_SOURCE_DIR/async.c" "$NIF_SOURCE_DIR/aead_stream.c" \
   -O3 -fPIC -shared -Wl,-undefined,dynamic_lookup \
   -o "$BUILD_DIR/darwin_arm64/native/libockam_elixir_ffi.dylib"
 
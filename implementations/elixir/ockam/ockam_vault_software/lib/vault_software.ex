@@ -1,16 +1,115 @@
 defmodule Ockam.Vault.Software do
   @moduledoc """
   Ockam.Vault.Software
+
+  ## Configuration
+
+    * `:dirty_threshold` - payload size in bytes at or above which `sha256`, `sha256_many`,
+      `aead_aes_gcm_encrypt`, `aead_aes_gcm_decrypt` and the encryptor / decryptor
+      resources and chunks of AEAD streams run on a dirty CPU scheduler instead of a
+      normal one. iolist payloads are sized without being flattened, those with more
+      than a few thousand elements always run on a dirty scheduler. Defaults to 64 KiB.
+    * `:async_runtime` - when `false`, the native vault runs every operation on the
+      calling scheduler and never starts its Tokio runtime threads. Hashing, key
+      agreement and AEAD always take this synchronous path. Defaults to `true`.
+    * `:scheduler_affinity` - when `true`, `init/0` registers the vault in the native
+      registry shard of the calling scheduler, so channels running on different
+      schedulers don't contend on the same registry lock. Defaults to `false`.
+    * `:keypair_pool_watermark` - number of ephemeral X25519 keypairs each vault created
+      by `init/0` keeps pre-generated on a background native thread, so `secret_generate/2`
+      for handshake keys doesn't run the key generation on the calling scheduler.
+      Defaults to `0`, which disables the pool.
+    * `:async_threads` - number of native threads running the `*_async` operations.
+      Defaults to one per scheduler. The threads are started by the first `*_async`
+      operation, `set_async_threads/1` returns `{:error, :already_started}` afterwards.
+
+  ```
+  config :ockam_vault_software, dirty_threshold: 64 * 1024, async_runtime: false
+  ```
+
+  ## Hardware backends
+
+  AES, GHASH and SHA-256 use the CPU's instructions when it has them (AES-NI, PCLMULQDQ,
+  SHA-NI or the ARMv8 SHA2 extension), detected when the library is loaded, and portable
+  implementations otherwise. `backend_info/0` reports the ones in use, e.g.
+  `{:ok, %{aes: :aes_ni, ghash: :pclmulqdq, sha256: :sha_ni}}`, they're also logged when
+  the application starts.
+
+  ## ChaCha20-Poly1305
+
+  On CPUs without AES instructions, ChaCha20-Poly1305 is several times faster than the
+  portable AES-GCM. `aead_chacha20_poly1305_encrypt/5` and
+  `aead_chacha20_poly1305_decrypt/5` take the same arguments as their AES-GCM
+  counterparts, the key being the 32 bytes of any secret. The encryptor and decryptor
+  resources use it when created by `aead_chacha20_poly1305_encryptor_new/4` and
+  `aead_chacha20_poly1305_decryptor_new/4`, or with `:chacha20_poly1305` as the last
+  argument of their AES-GCM constructors. The other encryptor and decryptor functions
+  use the cipher the resource was created with, and its keys are rekeyed into buffer
+  secrets rather than AES ones.
+
+  ## Batched key agreement
+
+  `ecdh_batch/2` computes the ECDH of a list of `{secret_handle, peer_public_key}`, e.g.
+  the handshakes of many peers reconnecting at once, spread across the CPU cores by a
+  native thread pool shared by all the batches, so concurrent batches don't add threads.
+  It returns `{:ok, results}` with an `{:ok, shared_secret_handle}` or `{:error, reason}`
+  per request, in order. Batches of 8 or more requests run on a dirty CPU scheduler.
+
+  ## Streaming AEAD
+
+  Payloads too large to hold in memory, or to encrypt in a single call, are encrypted in
+  chunks by an AEAD stream, following the STREAM construction:
+
+  ```
+  {:ok, stream} = aead_aes_gcm_stream_init(vault, key, nonce_prefix, :encrypt)
+  {:ok, c1} = aead_aes_gcm_stream_update(stream, ad, chunk1)
+  {:ok, c2} = aead_aes_gcm_stream_finalize(stream, ad, chunk2)
+  ```
+
+  Every chunk is authenticated on its own and decrypted the same way by a stream
+  initialized with `:decrypt`. Reordered, dropped or truncated chunks fail with
+  `{:error, :aead_auth_failed}`, which ends the stream. The chunks are encrypted with a
+  key derived from `key` and `nonce_prefix` with HKDF-SHA256, so a key can also be used
+  with `aead_aes_gcm_encrypt/5` without the chunk nonces colliding with the message ones.
+  The 7 bytes `nonce_prefix` must never be reused with the same key.
+
+  ## Asynchronous operations
+
+  `secret_generate_async/2`, `ecdh_async/3`, `aead_aes_gcm_encrypt_async/5` and
+  `aead_aes_gcm_decrypt_async/5` queue the operation to a pool of native threads and
+  return `{:ok, ref}` right away, so the calling process can carry on with its I/O. The
+  result is sent to it as `{ref, result}`, `result` being what the synchronous function
+  returns, see `await/2`. ECDH queued by any number of processes on the same vault are run
+  as batches. When the queue is full the functions return `{:error, :busy}`.
+
+  ## Errors
+
+  Failures of the native vault are reported as `{:error, reason}` with an atom reason,
+  e.g. `:aead_auth_failed` when a cipher text doesn't authenticate or `:entry_not_found`
+  for an unknown secret handle. Other vault errors are reported as
+  `{:error, {:vault_error, code}}`, `code` being `origin * 10000 + kind`.
+
+  ## Statistics
+
+  `stats/0` returns cumulative counters for the NIFs since the library was loaded:
+  calls, errors, calls run on a dirty CPU scheduler, payload bytes in and out, and a
+  latency histogram where bucket `i` counts the calls which took between `2^(i - 1)`
+  and `2^i` nanoseconds. It also returns the number of live vaults and the number of
+  secrets they hold.
   """
 
   use Application
 
+  require Logger
+
   defstruct [:id]
 
   @dialyzer :no_return
 
   @on_load {:load_natively_implemented_functions, 0}
 
+  @default_dirty_threshold 64 * 1024
+
   app = Mix.Project.config()[:app]
 
   def load_natively_implemented_functions do
@@ -105,6 +204,20 @@ defmodule Ockam.Vault.Software do
   #
   @doc false
   def start(_type, _args) do
+    :ok = set_dirty_threshold(dirty_threshold())
+    :ok = set_async_runtime(Application.get_env(:ockam_vault_software, :async_runtime, true))
+
+    with threads when is_integer(threads) <-
+           Application.get_env(:ockam_vault_software, :async_threads) do
+      with {:error, :already_started} <- set_async_threads(threads) do
+        Logger.warn("Vault async threads already started, ignoring async_threads: #{threads}")
+      end
+    end
+
+    with {:ok, backends} <- backend_info() do
+      Logger.info("Vault backends: #{inspect(backends)}")
+    end
+
     # Specifications of child processes that will be started and supervised.
     #
     # See the "Child specification" section in the `Supervisor` module for more
@@ -122,24 +235,103 @@ defmodule Ockam.Vault.Software do
     Supervisor.start_link(children, strategy: :one_for_one, name: __MODULE__)
   end
 
+  @doc false
+  def dirty_threshold() do
+    Application.get_env(:ockam_vault_software, :dirty_threshold, @default_dirty_threshold)
+  end
+
   def init do
-    with {:ok, id} <- default_init() do
+    result =
+      case Application.get_env(:ockam_vault_software, :scheduler_affinity, false) do
+        true -> default_init(:erlang.system_info(:scheduler_id))
+        false -> default_init()
+      end
+
+    with {:ok, id} <- result,
+         :ok <- start_keypair_pool(id) do
       {:ok, %__MODULE__{id: id}}
     end
   end
 
+  defp start_keypair_pool(id) do
+    case Application.get_env(:ockam_vault_software, :keypair_pool_watermark, 0) do
+      0 -> :ok
+      watermark -> set_keypair_pool_watermark(id, watermark)
+    end
+  end
+
   def default_init do
     raise "natively implemented default_init/0 not loaded"
   end
 
+  def default_init(_affinity) do
+    raise "natively implemented default_init/1 not loaded"
+  end
+
+  def set_dirty_threshold(_threshold) do
+    raise "natively implemented set_dirty_threshold/1 not loaded"
+  end
+
+  def set_async_runtime(_enabled) do
+    raise "natively implemented set_async_runtime/1 not loaded"
+  end
+
+  def set_keypair_pool_watermark(_vault, _watermark) do
+    raise "natively implemented set_keypair_pool_watermark/2 not loaded"
+  end
+
+  def set_async_threads(_threads) do
+    raise "natively implemented set_async_threads/1 not loaded"
+  end
+
+  @doc """
+  Waits for the result of an asynchronous operation, `{:error, :timeout}` if it's not
+  received within `timeout` milliseconds.
+  """
+  def await(ref, timeout \\ 5000) do
+    receive do
+      {^ref, result} -> result
+    after
+      timeout -> {:error, :timeout}
+    end
+  end
+
+  def backend_info do
+    raise "natively implemented backend_info/0 not loaded"
+  end
+
   def sha256(_vault, _input) do
     raise "natively implemented sha256/2 not loaded"
   end
 
+  def sha256_many(_vault, _inputs) do
+    raise "natively implemented sha256_many/2 not loaded"
+  end
+
+  def sha256_init do
+    raise "natively implemented sha256_init/0 not loaded"
+  end
+
+  def sha256_update(_context, _input) do
+    raise "natively implemented sha256_update/2 not loaded"
+  end
+
+  def sha256_final(_context) do
+    raise "natively implemented sha256_final/1 not loaded"
+  end
+
+  def sha256_clone(_context) do
+    raise "natively implemented sha256_clone/1 not loaded"
+  end
+
   def secret_generate(_vault, _attributes) do
     raise "natively implemented secret_generate/2 not loaded"
   end
 
+  def secret_generate_async(_vault, _attributes) do
+    raise "natively implemented secret_generate_async/2 not loaded"
+  end
+
   def secret_import(_vault, _attributes, _input) do
     raise "natively implemented secret_import/3 not loaded"
   end
@@ -164,6 +356,14 @@ defmodule Ockam.Vault.Software do
     raise "natively implemented ecdh/3 not loaded"
   end
 
+  def ecdh_batch(_vault, _requests) do
+    raise "natively implemented ecdh_batch/2 not loaded"
+  end
+
+  def ecdh_async(_vault, _secret_handle, _input) do
+    raise "natively implemented ecdh_async/3 not loaded"
+  end
+
   def hkdf_sha256(_vault, _salt_handle, _ikm_handle, _derived_outputs_count) do
     raise "natively implemented hkdf_sha256/4 not loaded"
   end
@@ -172,15 +372,113 @@ defmodule Ockam.Vault.Software do
     raise "natively implemented hkdf_sha256/3 not loaded"
   end
 
+  def ecdh_hkdf_sha256(
+        _vault,
+        _secret_handle,
+        _peer_public_key,
+        _salt_handle,
+        _derived_outputs
+      ) do
+    raise "natively implemented ecdh_hkdf_sha256/5 not loaded"
+  end
+
   def aead_aes_gcm_encrypt(_vault, _key_handle, _nonce, _ad, _plain_text) do
     raise "natively implemented aead_aes_gcm_encrypt/5 not loaded"
   end
 
+  def aead_aes_gcm_encrypt_async(_vault, _key_handle, _nonce, _ad, _plain_text) do
+    raise "natively implemented aead_aes_gcm_encrypt_async/5 not loaded"
+  end
+
+  def aead_aes_gcm_encrypt_framed(_vault, _key_handle, _nonce, _ad, _plain_text) do
+    raise "natively implemented aead_aes_gcm_encrypt_framed/5 not loaded"
+  end
+
+  def aead_aes_gcm_encrypt_batch(_vault, _key_handle, _start_nonce, _messages) do
+    raise "natively implemented aead_aes_gcm_encrypt_batch/4 not loaded"
+  end
+
+  def aead_aes_gcm_encrypt_and_hash(_vault, _key_handle, _nonce, _h, _plain_text) do
+    raise "natively implemented aead_aes_gcm_encrypt_and_hash/5 not loaded"
+  end
+
+  def aead_aes_gcm_decrypt_and_hash(_vault, _key_handle, _nonce, _h, _cipher_text) do
+    raise "natively implemented aead_aes_gcm_decrypt_and_hash/5 not loaded"
+  end
+
+  def aead_aes_gcm_rekey(_vault, _key_handle, _destroy_old) do
+    raise "natively implemented aead_aes_gcm_rekey/3 not loaded"
+  end
+
   def aead_aes_gcm_decrypt(_vault, _key_handle, _nonce, _ad, _cipher_text) do
     raise "natively implemented aead_aes_gcm_decrypt/5 not loaded"
   end
 
+  def aead_aes_gcm_decrypt_async(_vault, _key_handle, _nonce, _ad, _cipher_text) do
+    raise "natively implemented aead_aes_gcm_decrypt_async/5 not loaded"
+  end
+
+  def aead_chacha20_poly1305_encrypt(_vault, _key_handle, _nonce, _ad, _plain_text) do
+    raise "natively implemented aead_chacha20_poly1305_encrypt/5 not loaded"
+  end
+
+  def aead_chacha20_poly1305_decrypt(_vault, _key_handle, _nonce, _ad, _cipher_text) do
+    raise "natively implemented aead_chacha20_poly1305_decrypt/5 not loaded"
+  end
+
+  def aead_aes_gcm_stream_init(_vault, _key_handle, _nonce_prefix, _direction) do
+    raise "natively implemented aead_aes_gcm_stream_init/4 not loaded"
+  end
+
+  def aead_aes_gcm_stream_update(_stream, _ad, _chunk) do
+    raise "natively implemented aead_aes_gcm_stream_update/3 not loaded"
+  end
+
+  def aead_aes_gcm_stream_finalize(_stream, _ad, _chunk) do
+    raise "natively implemented aead_aes_gcm_stream_finalize/3 not loaded"
+  end
+
+  def aead_aes_gcm_encryptor_new(_vault, _key_handle, _nonce, _rekey_each) do
+    raise "natively implemented aead_aes_gcm_encryptor_new/4 not loaded"
+  end
+
+  def aead_aes_gcm_encryptor_new(_vault, _key_handle, _nonce, _rekey_each, _cipher) do
+    raise "natively implemented aead_aes_gcm_encryptor_new/5 not loaded"
+  end
+
+  def aead_chacha20_poly1305_encryptor_new(_vault, _key_handle, _nonce, _rekey_each) do
+    raise "natively implemented aead_chacha20_poly1305_encryptor_new/4 not loaded"
+  end
+
+  def aead_aes_gcm_encryptor_encrypt(_encryptor, _ad, _plain_text) do
+    raise "natively implemented aead_aes_gcm_encryptor_encrypt/3 not loaded"
+  end
+
+  def aead_aes_gcm_encryptor_encrypt_batch(_encryptor, _messages) do
+    raise "natively implemented aead_aes_gcm_encryptor_encrypt_batch/2 not loaded"
+  end
+
+  def aead_aes_gcm_decryptor_new(_vault, _key_handle, _nonce, _rekey_each) do
+    raise "natively implemented aead_aes_gcm_decryptor_new/4 not loaded"
+  end
+
+  def aead_aes_gcm_decryptor_new(_vault, _key_handle, _nonce, _rekey_each, _cipher) do
+    raise "natively implemented aead_aes_gcm_decryptor_new/5 not loaded"
+  end
+
+  def aead_chacha20_poly1305_decryptor_new(_vault, _key_handle, _nonce, _rekey_each) do
+    raise "natively implemented aead_chacha20_poly1305_decryptor_new/4 not loaded"
+  end
+
+  def aead_aes_gcm_decryptor_decrypt(_decryptor, _ad, _frame) do
+    raise "natively implemented aead_aes_gcm_decryptor_decrypt/3 not loaded"
+  end
+
   def deinit(_vault) do
     raise "natively implemented deinit/1 not loaded"
   end
+
+  def stats do
+    raise "natively implemented stats/0 not loaded"
+  end
 end
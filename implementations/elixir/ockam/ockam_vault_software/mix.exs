@@ -50,7 +50,7 @@ defmodule Ockam.Vault.Software.MixProject do
   def application do
     [
       mod: {Ockam.Vault.Software, []},
-      extra_applications: []
+      extra_applications: [:logger]
     ]
   end
 
@@ -0,0 +1,691 @@
+#include <memory.h>
+#include "common.h"
+#include "aead_aes_gcm.h"
+#include "ockam/vault.h"
+
+static const uint64_t MAX_NONCE       = UINT64_MAX;
+// The decryptor tracks `rekey_each` nonces per window in bitmaps, both ends of a channel accept
+// the same bound so that an encryptor always has a matching decryptor
+static const uint64_t MAX_REKEY_EACH  = 64 * 1024;
+
+static ErlNifResourceType* encryptor_resource_type = NULL;
+static ErlNifResourceType* decryptor_resource_type = NULL;
+
+// Sending side of a secure channel: the key for nonce `n` is the key of the first window rekeyed
+// once per window crossed, rotation is done lazily before encrypting the first message of a window.
+// The cipher is chosen when the encryptor is created, by aead_aes_gcm_encryptor_new or
+// aead_chacha20_poly1305_encryptor_new, and the other functions use it.
+typedef struct {
+    ErlNifMutex*         lock;
+    vault_resource_t*    vault_resource;
+    ockam_vault_t        vault;
+    aead_cipher_t        cipher;
+    ockam_vault_secret_t k;
+    uint64_t             key_window;
+    uint64_t             nonce;
+    uint64_t             rekey_each;
+} encryptor_t;
+
+// Mirrors the replay protection of the rust secure channel: nonces are split in rekey windows of
+// `rekey_each` messages, each window uses its own key, and messages are accepted from the previous,
+// current and next window. Nonces already seen in the current and previous windows are tracked in
+// two bitmaps of `rekey_each` bits.
+typedef struct {
+    ErlNifMutex*         lock;
+    vault_resource_t*    vault_resource;
+    ockam_vault_t        vault;
+    aead_cipher_t        cipher;
+    ockam_vault_secret_t k;
+    ockam_vault_secret_t prev_k;
+    bool                 has_prev_k;
+    uint64_t             expected_nonce;
+    uint64_t             rekey_each;
+    size_t               bitmap_words;
+    uint64_t*            seen;
+    uint64_t*            prev_seen;
+    uint64_t             bitmaps[];
+} decryptor_t;
+
+static bool bitmap_contains(const uint64_t* bitmap, uint64_t bit) {
+    return 0 != (bitmap[bit / 64] & ((uint64_t) 1 << (bit % 64)));
+}
+
+static void bitmap_insert(uint64_t* bitmap, uint64_t bit) {
+    bitmap[bit / 64] |= (uint64_t) 1 << (bit % 64);
+}
+
+static void destroy_secret(ockam_vault_t vault, ockam_vault_secret_t secret) {
+    ockam_vault_extern_error_t error = ockam_vault_secret_destroy(vault, secret);
+    extern_error_check_and_free_error(&error);
+}
+
+// The next key is derived and stored inside the vault, optionally destroying the current one
+static int rekey(ockam_vault_t vault,
+                 aead_cipher_t cipher,
+                 ockam_vault_secret_t k,
+                 bool destroy_k,
+                 ockam_vault_secret_t* new_k) {
+    ockam_vault_extern_error_t error = aead_rekey(cipher, vault, k, destroy_k, new_k);
+    if (extern_error_check_and_free_error(&error)) {
+        return -1;
+    }
+
+    return 0;
+}
+
+static void encryptor_destructor(ErlNifEnv *env, void *obj) {
+    encryptor_t* encryptor = obj;
+
+    destroy_secret(encryptor->vault, encryptor->k);
+    enif_release_resource(encryptor->vault_resource);
+
+    if (NULL != encryptor->lock) {
+        enif_mutex_destroy(encryptor->lock);
+    }
+}
+
+static void decryptor_destructor(ErlNifEnv *env, void *obj) {
+    decryptor_t* decryptor = obj;
+
+    destroy_secret(decryptor->vault, decryptor->k);
+    if (decryptor->has_prev_k) {
+        destroy_secret(decryptor->vault, decryptor->prev_k);
+    }
+    enif_release_resource(decryptor->vault_resource);
+
+    if (NULL != decryptor->lock) {
+        enif_mutex_destroy(decryptor->lock);
+    }
+}
+
+int aead_aes_gcm_load(ErlNifEnv *env) {
+    encryptor_resource_type = enif_open_resource_type(env,
+                                                      NULL,
+                                                      "aead_encryptor",
+                                                      encryptor_destructor,
+                                                      ERL_NIF_RT_CREATE | ERL_NIF_RT_TAKEOVER,
+                                                      NULL);
+    if (NULL == encryptor_resource_type) {
+        return -1;
+    }
+
+    decryptor_resource_type = enif_open_resource_type(env,
+                                                      NULL,
+                                                      "aead_decryptor",
+                                                      decryptor_destructor,
+                                                      ERL_NIF_RT_CREATE | ERL_NIF_RT_TAKEOVER,
+                                                      NULL);
+    if (NULL == decryptor_resource_type) {
+        return -1;
+    }
+
+    return 0;
+}
+
+static ERL_NIF_TERM encryptor_new(ErlNifEnv *env, const ERL_NIF_TERM argv[], aead_cipher_t cipher) {
+    vault_resource_t* vault_resource;
+    if (0 != parse_vault_resource(env, argv[0], &vault_resource) || !vault_resource->alive) {
+        return enif_make_badarg(env);
+    }
+
+    ErlNifUInt64 key_handle;
+    if (0 == enif_get_uint64(env, argv[1], &key_handle)) {
+        return enif_make_badarg(env);
+    }
+
+    ErlNifUInt64 nonce;
+    if (0 == enif_get_uint64(env, argv[2], &nonce)) {
+        return enif_make_badarg(env);
+    }
+
+    ErlNifUInt64 rekey_each;
+    if (0 == enif_get_uint64(env, argv[3], &rekey_each)) {
+        return enif_make_badarg(env);
+    }
+
+    if (0 == rekey_each || rekey_each > MAX_REKEY_EACH) {
+        return enif_make_badarg(env);
+    }
+
+    // Created before the encryptor takes ownership of the key, whose destructor would destroy it
+    ErlNifMutex* lock = enif_mutex_create("aead_encryptor");
+    if (NULL == lock) {
+        return error_tuple(env, "failed to create aead_encryptor");
+    }
+
+    encryptor_t* encryptor = enif_alloc_resource(encryptor_resource_type, sizeof(encryptor_t));
+    if (NULL == encryptor) {
+        enif_mutex_destroy(lock);
+        return error_tuple(env, "failed to create aead_encryptor");
+    }
+
+    enif_keep_resource(vault_resource);
+
+    encryptor->vault_resource = vault_resource;
+    encryptor->vault          = vault_resource->vault;
+    encryptor->cipher         = cipher;
+    encryptor->k              = key_handle;
+    encryptor->key_window     = nonce / rekey_each;
+    encryptor->nonce          = nonce;
+    encryptor->rekey_each     = rekey_each;
+    encryptor->lock           = lock;
+
+    ERL_NIF_TERM term = enif_make_resource(env, encryptor);
+    enif_release_resource(encryptor);
+
+    return ok(env, term);
+}
+
+// The cipher is AES-GCM, unless given as the last argument
+ERL_NIF_TERM aead_aes_gcm_encryptor_new(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]) {
+    if (4 != argc && 5 != argc) {
+        return enif_make_badarg(env);
+    }
+
+    aead_cipher_t cipher = AEAD_AES_GCM;
+    if (5 == argc && 0 != parse_aead_cipher(env, argv[4], &cipher)) {
+        return enif_make_badarg(env);
+    }
+
+    return encryptor_new(env, argv, cipher);
+}
+
+ERL_NIF_TERM aead_chacha20_poly1305_encryptor_new(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]) {
+    if (4 != argc) {
+        return enif_make_badarg(env);
+    }
+
+    return encryptor_new(env, argv, AEAD_CHACHA20_POLY1305);
+}
+
+static int encryptor_rotate_if_needed(encryptor_t* encryptor) {
+    while (encryptor->key_window < encryptor->nonce / encryptor->rekey_each) {
+        ockam_vault_secret_t new_k;
+        if (0 != rekey(encryptor->vault, encryptor->cipher, encryptor->k, true, &new_k)) {
+            return -1;
+        }
+
+        encryptor->k = new_k;
+        encryptor->key_window++;
+    }
+
+    return 0;
+}
+
+// The last nonce is reserved for rekeying
+static bool encryptor_has_nonces(const encryptor_t* encryptor, uint64_t count) {
+    return count <= MAX_NONCE - 1 - encryptor->nonce;
+}
+
+static ERL_NIF_TERM encryptor_encrypt(ErlNifEnv *env,
+                                      encryptor_t* encryptor,
+                                      const ErlNifBinary* ad,
+                                      const iodata_t* plain_text) {
+    if (!encryptor_has_nonces(encryptor, 1)) {
+        return error_tuple_atom(env, "nonce_exhausted");
+    }
+
+    if (0 != encryptor_rotate_if_needed(encryptor)) {
+        return error_tuple(env, "failed to rekey aead_aes_gcm_encryptor");
+    }
+
+    ERL_NIF_TERM result;
+    if (0 == aead_encrypt_iodata(env, encryptor->vault, encryptor->cipher, encryptor->k, encryptor->nonce, ad, plain_text, true, &result)) {
+        encryptor->nonce++;
+    }
+
+    return result;
+}
+
+static ERL_NIF_TERM aead_aes_gcm_encryptor_encrypt_run(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]) {
+    if (3 != argc) {
+        return enif_make_badarg(env);
+    }
+
+    encryptor_t* encryptor;
+    if (0 == enif_get_resource(env, argv[0], encryptor_resource_type, (void**) &encryptor)) {
+        return enif_make_badarg(env);
+    }
+
+    ErlNifBinary ad;
+    if (0 != inspect_iodata_as_binary(env, argv[1], &ad)) {
+        return enif_make_badarg(env);
+    }
+
+    iodata_t plain_text;
+    if (0 != inspect_iodata(env, argv[2], &plain_text)) {
+        return enif_make_badarg(env);
+    }
+
+    enif_mutex_lock(encryptor->lock);
+    ERL_NIF_TERM result = encryptor_encrypt(env, encryptor, &ad, &plain_text);
+    enif_mutex_unlock(encryptor->lock);
+
+    return result;
+}
+
+ERL_NIF_TERM aead_aes_gcm_encryptor_encrypt(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]) {
+    if (3 != argc) {
+        return enif_make_badarg(env);
+    }
+
+    return schedule_by_size(env, "aead_aes_gcm_encryptor_encrypt", aead_aes_gcm_encryptor_encrypt_run, argv[2], argc, argv);
+}
+
+// Encrypts messages of the current window into nonce-prefixed frames. There's no ChaCha20-Poly1305
+// batch function, its key setup is cheap enough to encrypt the frames one by one.
+static ockam_vault_extern_error_t encryptor_encrypt_window(const encryptor_t* encryptor,
+                                                           const ockam_vault_aead_message_t* messages,
+                                                           unsigned int count,
+                                                           uint8_t* output,
+                                                           size_t size,
+                                                           uint32_t* length) {
+    if (AEAD_AES_GCM == encryptor->cipher) {
+        return ockam_vault_aead_aes_gcm_encrypt_batch(encryptor->vault,
+                                                      encryptor->k,
+                                                      encryptor->nonce,
+                                                      messages,
+                                                      count,
+                                                      output,
+                                                      size,
+                                                      length);
+    }
+
+    size_t offset = 0;
+    *length = 0;
+
+    for (unsigned int i = 0; i < count; i++) {
+        size_t frame_size = AEAD_NONCE_SIZE + messages[i].plaintext_length + AEAD_TAG_SIZE;
+        uint8_t* frame = output + offset;
+        uint32_t frame_length = 0;
+
+        put_nonce(frame, encryptor->nonce + i);
+        memcpy(frame + AEAD_NONCE_SIZE, messages[i].plaintext, messages[i].plaintext_length);
+
+        ockam_vault_extern_error_t error = aead_encrypt_in_place(encryptor->cipher,
+                                                                 encryptor->vault,
+                                                                 encryptor->k,
+                                                                 encryptor->nonce + i,
+                                                                 messages[i].additional_data,
+                                                                 messages[i].additional_data_length,
+                                                                 frame + AEAD_NONCE_SIZE,
+                                                                 messages[i].plaintext_length,
+                                                                 frame_size - AEAD_NONCE_SIZE,
+                                                                 &frame_length);
+        if (extern_error_has_error(&error)) {
+            return error;
+        }
+
+        offset += AEAD_NONCE_SIZE + frame_length;
+    }
+
+    *length = (uint32_t) offset;
+
+    return (ockam_vault_extern_error_t) {0};
+}
+
+// Encrypts one rekey window at a time, so each window resolves its key only once
+static ERL_NIF_TERM encryptor_encrypt_batch(ErlNifEnv *env,
+                                            encryptor_t* encryptor,
+                                            const ockam_vault_aead_message_t* messages,
+                                            unsigned int count,
+                                            size_t size) {
+    if (!encryptor_has_nonces(encryptor, count)) {
+        return error_tuple_atom(env, "nonce_exhausted");
+    }
+
+    ERL_NIF_TERM term;
+    uint8_t* output = enif_make_new_binary(env, size, &term);
+
+    if (NULL == output) {
+        return error_tuple(env, "failed to create buffer for aead_aes_gcm_encrypt_batch");
+    }
+
+    size_t offset = 0;
+    unsigned int i = 0;
+
+    while (i < count) {
+        if (0 != encryptor_rotate_if_needed(encryptor)) {
+            return error_tuple(env, "failed to rekey aead_aes_gcm_encryptor");
+        }
+
+        uint64_t window_left = encryptor->rekey_each - encryptor->nonce % encryptor->rekey_each;
+        unsigned int window_count = count - i < window_left ? count - i : (unsigned int) window_left;
+
+        size_t window_size = 0;
+        for (unsigned int j = i; j < i + window_count; j++) {
+            window_size += AEAD_NONCE_SIZE + messages[j].plaintext_length + AEAD_TAG_SIZE;
+        }
+
+        uint32_t length = 0;
+
+        ockam_vault_extern_error_t error = encryptor_encrypt_window(encryptor,
+                                                                    messages + i,
+                                                                    window_count,
+                                                                    output + offset,
+                                                                    window_size,
+                                                                    &length);
+        if (extern_error_has_error(&error)) {
+            return extern_error_tuple(env, &error);
+        }
+
+        if (length != window_size) {
+            return error_tuple(env, "buffer size is invalid during aead_aes_gcm_encrypt_batch");
+        }
+
+        encryptor->nonce += window_count;
+        offset += window_size;
+        i += window_count;
+    }
+
+    return ok(env, make_frames_list(env, term, size, messages, count));
+}
+
+ERL_NIF_TERM aead_aes_gcm_encryptor_encrypt_batch(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]) {
+    if (2 != argc) {
+        return enif_make_badarg(env);
+    }
+
+    encryptor_t* encryptor;
+    if (0 == enif_get_resource(env, argv[0], encryptor_resource_type, (void**) &encryptor)) {
+        return enif_make_badarg(env);
+    }
+
+    unsigned int count;
+    if (0 == enif_get_list_length(env, argv[1], &count)) {
+        return enif_make_badarg(env);
+    }
+
+    if (0 == count) {
+        return ok(env, enif_make_list(env, 0));
+    }
+
+    ockam_vault_aead_message_t* messages = enif_alloc(count * sizeof(ockam_vault_aead_message_t));
+    if (NULL == messages) {
+        return error_tuple(env, "failed to create buffer for aead_aes_gcm_encrypt_batch");
+    }
+
+    size_t size = 0;
+    if (0 != parse_aead_messages(env, argv[1], count, messages, &size) || size > UINT32_MAX) {
+        enif_free(messages);
+        return enif_make_badarg(env);
+    }
+
+    if (above_dirty_threshold(size) && ERL_NIF_THR_NORMAL_SCHEDULER == enif_thread_type()) {
+        enif_free(messages);
+        return schedule_dirty(env, "aead_aes_gcm_encryptor_encrypt_batch", aead_aes_gcm_encryptor_encrypt_batch, argc, argv);
+    }
+
+    enif_mutex_lock(encryptor->lock);
+    ERL_NIF_TERM result = encryptor_encrypt_batch(env, encryptor, messages, count, size);
+    enif_mutex_unlock(encryptor->lock);
+
+    enif_free(messages);
+
+    return result;
+}
+
+static ERL_NIF_TERM decryptor_new(ErlNifEnv *env, const ERL_NIF_TERM argv[], aead_cipher_t cipher) {
+    vault_resource_t* vault_resource;
+    if (0 != parse_vault_resource(env, argv[0], &vault_resource) || !vault_resource->alive) {
+        return enif_make_badarg(env);
+    }
+
+    ErlNifUInt64 key_handle;
+    if (0 == enif_get_uint64(env, argv[1], &key_handle)) {
+        return enif_make_badarg(env);
+    }
+
+    ErlNifUInt64 nonce;
+    if (0 == enif_get_uint64(env, argv[2], &nonce)) {
+        return enif_make_badarg(env);
+    }
+
+    ErlNifUInt64 rekey_each;
+    if (0 == enif_get_uint64(env, argv[3], &rekey_each)) {
+        return enif_make_badarg(env);
+    }
+
+    if (0 == rekey_each || rekey_each > MAX_REKEY_EACH) {
+        return enif_make_badarg(env);
+    }
+
+    // Created before the decryptor takes ownership of the key, whose destructor would destroy it
+    ErlNifMutex* lock = enif_mutex_create("aead_decryptor");
+    if (NULL == lock) {
+        return error_tuple(env, "failed to create aead_decryptor");
+    }
+
+    size_t bitmap_words = (rekey_each + 63) / 64;
+    decryptor_t* decryptor = enif_alloc_resource(decryptor_resource_type,
+                                                 sizeof(decryptor_t) + 2 * bitmap_words * sizeof(uint64_t));
+    if (NULL == decryptor) {
+        enif_mutex_destroy(lock);
+        return error_tuple(env, "failed to create aead_decryptor");
+    }
+
+    memset(decryptor, 0, sizeof(decryptor_t) + 2 * bitmap_words * sizeof(uint64_t));
+
+    enif_keep_resource(vault_resource);
+
+    decryptor->vault_resource = vault_resource;
+    decryptor->vault          = vault_resource->vault;
+    decryptor->cipher         = cipher;
+    decryptor->k              = key_handle;
+    decryptor->has_prev_k     = false;
+    decryptor->expected_nonce = nonce;
+    decryptor->rekey_each     = rekey_each;
+    decryptor->bitmap_words   = bitmap_words;
+    decryptor->seen           = decryptor->bitmaps;
+    decryptor->prev_seen      = decryptor->bitmaps + bitmap_words;
+    decryptor->lock           = lock;
+
+    ERL_NIF_TERM term = enif_make_resource(env, decryptor);
+    enif_release_resource(decryptor);
+
+    return ok(env, term);
+}
+
+// The cipher is AES-GCM, unless given as the last argument
+ERL_NIF_TERM aead_aes_gcm_decryptor_new(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]) {
+    if (4 != argc && 5 != argc) {
+        return enif_make_badarg(env);
+    }
+
+    aead_cipher_t cipher = AEAD_AES_GCM;
+    if (5 == argc && 0 != parse_aead_cipher(env, argv[4], &cipher)) {
+        return enif_make_badarg(env);
+    }
+
+    return decryptor_new(env, argv, cipher);
+}
+
+ERL_NIF_TERM aead_chacha20_poly1305_decryptor_new(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]) {
+    if (4 != argc) {
+        return enif_make_badarg(env);
+    }
+
+    return decryptor_new(env, argv, AEAD_CHACHA20_POLY1305);
+}
+
+static ERL_NIF_TERM decrypt_with(ErlNifEnv *env,
+                                 decryptor_t* decryptor,
+                                 ockam_vault_secret_t key,
+                                 uint64_t nonce,
+                                 const ErlNifBinary* ad,
+                                 const uint8_t* cipher_text,
+                                 size_t cipher_text_size,
+                                 bool* decrypted) {
+    *decrypted = false;
+
+    ERL_NIF_TERM term;
+    size_t size = cipher_text_size - AEAD_TAG_SIZE;
+    uint8_t* plain_text = enif_make_new_binary(env, size, &term);
+
+    if (NULL == plain_text) {
+        return error_tuple(env, "failed to create buffer for aead_aes_gcm_decrypt");
+    }
+
+    uint32_t length = 0;
+
+    ockam_vault_extern_error_t error = aead_decrypt(decryptor->cipher,
+                                                    decryptor->vault,
+                                                    key,
+                                                    nonce,
+                                                    ad->data,
+                                                    ad->size,
+                                                    cipher_text,
+                                                    cipher_text_size,
+                                                    plain_text,
+                                                    size,
+                                                    &length);
+    if (extern_error_has_error(&error)) {
+        return extern_error_tuple(env, &error);
+    }
+
+    if (length != size) {
+        return error_tuple(env, "buffer size is invalid during aead_aes_gcm_decrypt");
+    }
+
+    *decrypted = true;
+
+    return ok(env, term);
+}
+
+static ERL_NIF_TERM decryptor_decrypt(ErlNifEnv *env,
+                                      decryptor_t* decryptor,
+                                      uint64_t nonce,
+                                      const ErlNifBinary* ad,
+                                      const uint8_t* cipher_text,
+                                      size_t cipher_text_size) {
+    uint64_t expected_nonce = decryptor->expected_nonce;
+    uint64_t rekey_each     = decryptor->rekey_each;
+
+    // Same interval around the expected nonce as the rust implementation
+    bool above_lower_bound = expected_nonce < rekey_each || nonce >= expected_nonce - rekey_each;
+    bool below_upper_bound = expected_nonce > MAX_NONCE - rekey_each || nonce < expected_nonce + rekey_each;
+
+    if (!above_lower_bound || !below_upper_bound) {
+        return error_tuple_atom(env, "out_of_window");
+    }
+
+    // -1 = previous key,  0 = current key, 1 = next key
+    uint64_t current_window = (0 == expected_nonce ? 0 : expected_nonce - 1) / rekey_each;
+    int64_t window_offset   = (int64_t) (nonce / rekey_each - current_window);
+    uint64_t bit            = nonce % rekey_each;
+    bool decrypted          = false;
+    ERL_NIF_TERM result;
+
+    switch (window_offset) {
+        case 0:
+            if (bitmap_contains(decryptor->seen, bit)) {
+                return error_tuple_atom(env, "repeated_nonce");
+            }
+
+            result = decrypt_with(env, decryptor, decryptor->k, nonce, ad, cipher_text, cipher_text_size, &decrypted);
+            if (decrypted) {
+                bitmap_insert(decryptor->seen, bit);
+                if (nonce + 1 > decryptor->expected_nonce) {
+                    decryptor->expected_nonce = nonce + 1;
+                }
+            }
+            return result;
+
+        case -1:
+            if (!decryptor->has_prev_k) {
+                return error_tuple_atom(env, "out_of_window");
+            }
+
+            if (bitmap_contains(decryptor->prev_seen, bit)) {
+                return error_tuple_atom(env, "repeated_nonce");
+            }
+
+            result = decrypt_with(env, decryptor, decryptor->prev_k, nonce, ad, cipher_text, cipher_text_size, &decrypted);
+            if (decrypted) {
+                bitmap_insert(decryptor->prev_seen, bit);
+            }
+            return result;
+
+        case 1: {
+            ockam_vault_secret_t new_k;
+            if (0 != rekey(decryptor->vault, decryptor->cipher, decryptor->k, false, &new_k)) {
+                return error_tuple(env, "failed to rekey aead_aes_gcm_decryptor");
+            }
+
+            result = decrypt_with(env, decryptor, new_k, nonce, ad, cipher_text, cipher_text_size, &decrypted);
+            if (!decrypted) {
+                destroy_secret(decryptor->vault, new_k);
+                return result;
+            }
+
+            if (decryptor->has_prev_k) {
+                destroy_secret(decryptor->vault, decryptor->prev_k);
+            }
+
+            uint64_t* seen = decryptor->prev_seen;
+            memset(seen, 0, decryptor->bitmap_words * sizeof(uint64_t));
+            bitmap_insert(seen, bit);
+
+            decryptor->prev_seen      = decryptor->seen;
+            decryptor->seen           = seen;
+            decryptor->prev_k         = decryptor->k;
+            decryptor->has_prev_k     = true;
+            decryptor->k              = new_k;
+            decryptor->expected_nonce = nonce + 1;
+
+            return result;
+        }
+
+        default:
+            return error_tuple_atom(env, "out_of_window");
+    }
+}
+
+static ERL_NIF_TERM aead_aes_gcm_decryptor_decrypt_run(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]) {
+    if (3 != argc) {
+        return enif_make_badarg(env);
+    }
+
+    decryptor_t* decryptor;
+    if (0 == enif_get_resource(env, argv[0], decryptor_resource_type, (void**) &decryptor)) {
+        return enif_make_badarg(env);
+    }
+
+    ErlNifBinary ad;
+    if (0 != inspect_iodata_as_binary(env, argv[1], &ad)) {
+        return enif_make_badarg(env);
+    }
+
+    ErlNifBinary frame;
+    if (0 != inspect_iodata_as_binary(env, argv[2], &frame)) {
+        return enif_make_badarg(env);
+    }
+
+    if (frame.size < AEAD_NONCE_SIZE + AEAD_TAG_SIZE) {
+        return error_tuple_atom(env, "invalid_frame");
+    }
+
+    uint64_t nonce = 0;
+    for (size_t i = 0; i < AEAD_NONCE_SIZE; i++) {
+        nonce = (nonce << 8) | frame.data[i];
+    }
+
+    enif_mutex_lock(decryptor->lock);
+    ERL_NIF_TERM result = decryptor_decrypt(env,
+                                            decryptor,
+                                            nonce,
+                                            &ad,
+                                            frame.data + AEAD_NONCE_SIZE,
+                                            frame.size - AEAD_NONCE_SIZE);
+    enif_mutex_unlock(decryptor->lock);
+
+    return result;
+}
+
+ERL_NIF_TERM aead_aes_gcm_decryptor_decrypt(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]) {
+    if (3 != argc) {
+        return enif_make_badarg(env);
+    }
+
+    return schedule_by_size(env, "aead_aes_gcm_decryptor_decrypt", aead_aes_gcm_decryptor_decrypt_run, argv[2], argc, argv);
+}
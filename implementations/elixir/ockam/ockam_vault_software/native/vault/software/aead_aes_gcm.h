@@ -0,0 +1,22 @@
+#ifndef OCKAM_ELIXIR_AEAD_AES_GCM_H
+#define OCKAM_ELIXIR_AEAD_AES_GCM_H
+
+#include "erl_nif.h"
+
+int aead_aes_gcm_load(ErlNifEnv *env);
+
+ERL_NIF_TERM aead_aes_gcm_encryptor_new(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]);
+
+ERL_NIF_TERM aead_chacha20_poly1305_encryptor_new(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]);
+
+ERL_NIF_TERM aead_aes_gcm_encryptor_encrypt(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]);
+
+ERL_NIF_TERM aead_aes_gcm_encryptor_encrypt_batch(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]);
+
+ERL_NIF_TERM aead_aes_gcm_decryptor_new(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]);
+
+ERL_NIF_TERM aead_chacha20_poly1305_decryptor_new(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]);
+
+ERL_NIF_TERM aead_aes_gcm_decryptor_decrypt(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]);
+
+#endif //OCKAM_ELIXIR_AEAD_AES_GCM_H
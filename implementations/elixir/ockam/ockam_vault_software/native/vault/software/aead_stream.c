@@ -0,0 +1,194 @@
+#include "common.h"
+#include "aead_stream.h"
+#include "ockam/vault.h"
+
+static const size_t AEAD_STREAM_NONCE_PREFIX_SIZE = 7;
+
+static ErlNifResourceType* aead_stream_resource_type = NULL;
+
+typedef struct {
+    ErlNifMutex*               lock;
+    ockam_vault_aead_stream_t* stream;
+    bool                       encrypt;
+} aead_stream_resource_t;
+
+static void aead_stream_destructor(ErlNifEnv *env, void *obj) {
+    aead_stream_resource_t* resource = obj;
+
+    if (NULL != resource->stream) {
+        ockam_vault_extern_error_t error = ockam_vault_aead_aes_gcm_stream_free(resource->stream);
+        extern_error_check_and_free_error(&error);
+    }
+
+    if (NULL != resource->lock) {
+        enif_mutex_destroy(resource->lock);
+    }
+}
+
+int aead_stream_load(ErlNifEnv *env) {
+    aead_stream_resource_type = enif_open_resource_type(env,
+                                                        NULL,
+                                                        "aead_stream",
+                                                        aead_stream_destructor,
+                                                        ERL_NIF_RT_CREATE | ERL_NIF_RT_TAKEOVER,
+                                                        NULL);
+    if (NULL == aead_stream_resource_type) {
+        return -1;
+    }
+
+    return 0;
+}
+
+// Takes ownership of `stream`, which is freed by the resource destructor
+static ERL_NIF_TERM make_aead_stream_resource(ErlNifEnv *env, ockam_vault_aead_stream_t* stream, bool encrypt) {
+    aead_stream_resource_t* resource = enif_alloc_resource(aead_stream_resource_type, sizeof(aead_stream_resource_t));
+    if (NULL == resource) {
+        ockam_vault_extern_error_t error = ockam_vault_aead_aes_gcm_stream_free(stream);
+        extern_error_check_and_free_error(&error);
+        return error_tuple(env, "failed to create aead stream");
+    }
+
+    resource->stream  = stream;
+    resource->encrypt = encrypt;
+    resource->lock    = enif_mutex_create("aead_stream");
+
+    if (NULL == resource->lock) {
+        enif_release_resource(resource);
+        return error_tuple(env, "failed to create aead stream");
+    }
+
+    ERL_NIF_TERM term = enif_make_resource(env, resource);
+    enif_release_resource(resource);
+
+    return ok(env, term);
+}
+
+ERL_NIF_TERM aead_aes_gcm_stream_init(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]) {
+    if (4 != argc) {
+        return enif_make_badarg(env);
+    }
+
+    ockam_vault_t vault;
+    if (0 != parse_vault_handle(env, argv[0], &vault)) {
+        return enif_make_badarg(env);
+    }
+
+    ErlNifUInt64 key_handle;
+    if (0 == enif_get_uint64(env, argv[1], &key_handle)) {
+        return enif_make_badarg(env);
+    }
+
+    ErlNifBinary nonce_prefix;
+    if (0 == enif_inspect_binary(env, argv[2], &nonce_prefix) || AEAD_STREAM_NONCE_PREFIX_SIZE != nonce_prefix.size) {
+        return enif_make_badarg(env);
+    }
+
+    bool encrypt;
+    if (enif_is_identical(argv[3], enif_make_atom(env, "encrypt"))) {
+        encrypt = true;
+    } else if (enif_is_identical(argv[3], enif_make_atom(env, "decrypt"))) {
+        encrypt = false;
+    } else {
+        return enif_make_badarg(env);
+    }
+
+    ockam_vault_aead_stream_t* stream;
+
+    ockam_vault_extern_error_t error = ockam_vault_aead_aes_gcm_stream_init(vault,
+                                                                            key_handle,
+                                                                            encrypt,
+                                                                            nonce_prefix.data,
+                                                                            nonce_prefix.size,
+                                                                            &stream);
+    if (extern_error_has_error(&error)) {
+        return extern_error_tuple(env, &error);
+    }
+
+    return make_aead_stream_resource(env, stream, encrypt);
+}
+
+static ERL_NIF_TERM aead_stream_next(ErlNifEnv *env, const ERL_NIF_TERM argv[], bool last) {
+    aead_stream_resource_t* resource;
+    if (0 == enif_get_resource(env, argv[0], aead_stream_resource_type, (void**) &resource)) {
+        return enif_make_badarg(env);
+    }
+
+    ErlNifBinary ad;
+    if (0 != inspect_iodata_as_binary(env, argv[1], &ad) || ad.size > UINT32_MAX) {
+        return enif_make_badarg(env);
+    }
+
+    ErlNifBinary input;
+    if (0 != inspect_iodata_as_binary(env, argv[2], &input) || input.size > UINT32_MAX - AEAD_TAG_SIZE) {
+        return enif_make_badarg(env);
+    }
+
+    if (!resource->encrypt && input.size < AEAD_TAG_SIZE) {
+        return enif_make_badarg(env);
+    }
+
+    size_t size = resource->encrypt ? input.size + AEAD_TAG_SIZE : input.size - AEAD_TAG_SIZE;
+
+    ERL_NIF_TERM term;
+    uint8_t* output = enif_make_new_binary(env, size, &term);
+
+    if (NULL == output) {
+        return error_tuple(env, "failed to create buffer for aead stream");
+    }
+
+    uint32_t length = 0;
+
+    enif_mutex_lock(resource->lock);
+    ockam_vault_extern_error_t error = ockam_vault_aead_aes_gcm_stream_update(resource->stream,
+                                                                              ad.data,
+                                                                              ad.size,
+                                                                              input.data,
+                                                                              input.size,
+                                                                              last,
+                                                                              output,
+                                                                              size,
+                                                                              &length);
+    enif_mutex_unlock(resource->lock);
+
+    if (extern_error_has_error(&error)) {
+        return extern_error_tuple(env, &error);
+    }
+
+    if (length != size) {
+        return error_tuple(env, "buffer size is invalid during aead stream");
+    }
+
+    return ok(env, term);
+}
+
+static ERL_NIF_TERM aead_aes_gcm_stream_update_run(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]) {
+    if (3 != argc) {
+        return enif_make_badarg(env);
+    }
+
+    return aead_stream_next(env, argv, false);
+}
+
+ERL_NIF_TERM aead_aes_gcm_stream_update(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]) {
+    if (3 != argc) {
+        return enif_make_badarg(env);
+    }
+
+    return schedule_by_size(env, "aead_aes_gcm_stream_update", aead_aes_gcm_stream_update_run, argv[2], argc, argv);
+}
+
+static ERL_NIF_TERM aead_aes_gcm_stream_finalize_run(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]) {
+    if (3 != argc) {
+        return enif_make_badarg(env);
+    }
+
+    return aead_stream_next(env, argv, true);
+}
+
+ERL_NIF_TERM aead_aes_gcm_stream_finalize(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]) {
+    if (3 != argc) {
+        return enif_make_badarg(env);
+    }
+
+    return schedule_by_size(env, "aead_aes_gcm_stream_finalize", aead_aes_gcm_stream_finalize_run, argv[2], argc, argv);
+}
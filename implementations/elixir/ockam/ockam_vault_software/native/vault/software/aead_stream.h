@@ -0,0 +1,14 @@
+#ifndef OCKAM_ELIXIR_AEAD_STREAM_H
+#define OCKAM_ELIXIR_AEAD_STREAM_H
+
+#include "erl_nif.h"
+
+int aead_stream_load(ErlNifEnv *env);
+
+ERL_NIF_TERM aead_aes_gcm_stream_init(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]);
+
+ERL_NIF_TERM aead_aes_gcm_stream_update(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]);
+
+ERL_NIF_TERM aead_aes_gcm_stream_finalize(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]);
+
+#endif //OCKAM_ELIXIR_AEAD_STREAM_H
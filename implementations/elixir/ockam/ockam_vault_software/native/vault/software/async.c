@@ -0,0 +1,497 @@
+#include "common.h"
+#include "async.h"
+#include "vault.h"
+#include "ockam/vault.h"
+
+// Jobs waiting for a worker, past this the async NIFs return {:error, :busy}
+#define ASYNC_QUEUE_CAPACITY 4096
+
+// Jobs a worker takes from the queue at once, the ECDH among them are run as batches
+#define ASYNC_BATCH_MAX 64
+
+#define ASYNC_MAX_THREADS 64
+
+typedef enum {
+    JOB_SECRET_GENERATE,
+    JOB_ECDH,
+    JOB_AEAD_ENCRYPT,
+    JOB_AEAD_DECRYPT,
+} job_type_t;
+
+// A vault operation queued by a process. Its environment holds the reference, the copied
+// inputs and the result, it's sent to the process along with the message.
+typedef struct {
+    job_type_t                      type;
+    ErlNifEnv*                      env;
+    ErlNifPid                       pid;
+    ERL_NIF_TERM                    ref;
+    vault_resource_t*               vault_resource;
+    ockam_vault_t                   vault;
+    ockam_vault_secret_t            secret;
+    ockam_vault_secret_attributes_t attributes;
+    uint64_t                        nonce;
+    ErlNifBinary                    ad;
+    ErlNifBinary                    input;
+    ERL_NIF_TERM                    result;
+} job_t;
+
+typedef struct {
+    ErlNifMutex* lock;
+    ErlNifCond*  ready;
+    job_t*       queue[ASYNC_QUEUE_CAPACITY];
+    size_t       head;
+    size_t       count;
+    ErlNifTid    threads[ASYNC_MAX_THREADS];
+    unsigned int threads_count;
+    bool         started;
+    bool         stopping;
+} pool_t;
+
+static pool_t pool;
+
+// 0 means one worker per scheduler
+static unsigned int async_threads = 0;
+
+int async_load(ErlNifEnv *env) {
+    // An upgraded instance of the library may share these statics with the running one
+    if (NULL != pool.lock) {
+        return 0;
+    }
+
+    pool.lock  = enif_mutex_create("ockam_vault_async_lock");
+    pool.ready = enif_cond_create("ockam_vault_async_ready");
+
+    if (NULL == pool.lock || NULL == pool.ready) {
+        return -1;
+    }
+
+    return 0;
+}
+
+void async_unload(void) {
+    if (NULL == pool.lock) {
+        return;
+    }
+
+    enif_mutex_lock(pool.lock);
+    bool started  = pool.started;
+    pool.stopping = true;
+    enif_cond_broadcast(pool.ready);
+    enif_mutex_unlock(pool.lock);
+
+    if (started) {
+        for (unsigned int i = 0; i < pool.threads_count; i++) {
+            enif_thread_join(pool.threads[i], NULL);
+        }
+    }
+
+    // The lock and condition are kept, the next job restarts the workers
+    enif_mutex_lock(pool.lock);
+    pool.started       = false;
+    pool.stopping      = false;
+    pool.threads_count = 0;
+    enif_mutex_unlock(pool.lock);
+}
+
+static void job_free(job_t* job) {
+    enif_release_resource(job->vault_resource);
+    enif_free_env(job->env);
+    enif_free(job);
+}
+
+static void job_complete(job_t* job) {
+    // The process may be gone, its result is dropped then
+    enif_send(NULL, &job->pid, job->env, enif_make_tuple2(job->env, job->ref, job->result));
+    job_free(job);
+}
+
+static void run_secret_generate(job_t* job) {
+    ockam_vault_secret_t secret;
+    ockam_vault_extern_error_t error = ockam_vault_secret_generate(job->vault, &secret, job->attributes);
+    if (extern_error_has_error(&error)) {
+        job->result = extern_error_tuple(job->env, &error);
+        return;
+    }
+
+    job->result = ok(job->env, enif_make_uint64(job->env, secret));
+}
+
+static void run_aead_encrypt(job_t* job) {
+    ERL_NIF_TERM term;
+    size_t size = job->input.size + AEAD_TAG_SIZE;
+    uint8_t* cipher_text = enif_make_new_binary(job->env, size, &term);
+
+    if (NULL == cipher_text) {
+        job->result = error_tuple(job->env, "failed to create buffer for aead_aes_gcm_encrypt_async");
+        return;
+    }
+
+    uint32_t length = 0;
+
+    ockam_vault_extern_error_t error = ockam_vault_aead_aes_gcm_encrypt(job->vault,
+                                                                        job->secret,
+                                                                        job->nonce,
+                                                                        job->ad.data,
+                                                                        job->ad.size,
+                                                                        job->input.data,
+                                                                        job->input.size,
+                                                                        cipher_text,
+                                                                        size,
+                                                                        &length);
+    if (extern_error_has_error(&error)) {
+        job->result = extern_error_tuple(job->env, &error);
+        return;
+    }
+
+    if (length != size) {
+        job->result = error_tuple(job->env, "buffer size is invalid during aead_aes_gcm_encrypt_async");
+        return;
+    }
+
+    job->result = ok(job->env, term);
+}
+
+static void run_aead_decrypt(job_t* job) {
+    ERL_NIF_TERM term;
+    size_t size = job->input.size - AEAD_TAG_SIZE;
+    uint8_t* plain_text = enif_make_new_binary(job->env, size, &term);
+
+    if (NULL == plain_text) {
+        job->result = error_tuple(job->env, "failed to create buffer for aead_aes_gcm_decrypt_async");
+        return;
+    }
+
+    uint32_t length = 0;
+
+    ockam_vault_extern_error_t error = ockam_vault_aead_aes_gcm_decrypt(job->vault,
+                                                                        job->secret,
+                                                                        job->nonce,
+                                                                        job->ad.data,
+                                                                        job->ad.size,
+                                                                        job->input.data,
+                                                                        job->input.size,
+                                                                        plain_text,
+                                                                        size,
+                                                                        &length);
+    if (extern_error_has_error(&error)) {
+        job->result = extern_error_tuple(job->env, &error);
+        return;
+    }
+
+    if (length != size) {
+        job->result = error_tuple(job->env, "buffer size is invalid during aead_aes_gcm_decrypt_async");
+        return;
+    }
+
+    job->result = ok(job->env, term);
+}
+
+static bool same_vault(const job_t* a, const job_t* b) {
+    return a->vault.handle == b->vault.handle && a->vault.vault_type == b->vault.vault_type;
+}
+
+// The ECDH jobs of a vault, queued by any number of processes, are run as a single batch
+static void run_ecdh_batch(job_t* jobs[], unsigned int count) {
+    ockam_vault_ecdh_request_t requests[ASYNC_BATCH_MAX];
+    ockam_vault_secret_t shared_secrets[ASYNC_BATCH_MAX];
+    int32_t errors[ASYNC_BATCH_MAX];
+
+    for (unsigned int i = 0; i < count; i++) {
+        requests[i].privatekey            = jobs[i]->secret;
+        requests[i].peer_publickey        = jobs[i]->input.data;
+        requests[i].peer_publickey_length = jobs[i]->input.size;
+    }
+
+    ockam_vault_extern_error_t error = ockam_vault_ecdh_batch(jobs[0]->vault, requests, count, shared_secrets, errors);
+    if (extern_error_has_error(&error)) {
+        int32_t code = error.code;
+        ockam_vault_free_error(&error);
+
+        for (unsigned int i = 0; i < count; i++) {
+            errors[i] = code;
+        }
+    }
+
+    for (unsigned int i = 0; i < count; i++) {
+        job_t* job = jobs[i];
+
+        if (0 == errors[i]) {
+            job->result = ok(job->env, enif_make_uint64(job->env, shared_secrets[i]));
+        } else {
+            job->result = error_code_tuple(job->env, errors[i]);
+        }
+    }
+}
+
+static void run_jobs(job_t* jobs[], unsigned int count) {
+    bool done[ASYNC_BATCH_MAX] = {false};
+    job_t* ecdh_jobs[ASYNC_BATCH_MAX];
+
+    for (unsigned int i = 0; i < count; i++) {
+        if (done[i]) {
+            continue;
+        }
+
+        switch (jobs[i]->type) {
+            case JOB_SECRET_GENERATE:
+                run_secret_generate(jobs[i]);
+                break;
+            case JOB_AEAD_ENCRYPT:
+                run_aead_encrypt(jobs[i]);
+                break;
+            case JOB_AEAD_DECRYPT:
+                run_aead_decrypt(jobs[i]);
+                break;
+            case JOB_ECDH: {
+                unsigned int ecdh_count = 0;
+
+                for (unsigned int j = i; j < count; j++) {
+                    if (!done[j] && JOB_ECDH == jobs[j]->type && same_vault(jobs[i], jobs[j])) {
+                        ecdh_jobs[ecdh_count++] = jobs[j];
+                        done[j] = true;
+                    }
+                }
+
+                run_ecdh_batch(ecdh_jobs, ecdh_count);
+                break;
+            }
+        }
+
+        done[i] = true;
+    }
+
+    for (unsigned int i = 0; i < count; i++) {
+        job_complete(jobs[i]);
+    }
+}
+
+static void* worker_main(void* arg) {
+    job_t* jobs[ASYNC_BATCH_MAX];
+
+    for (;;) {
+        enif_mutex_lock(pool.lock);
+
+        while (0 == pool.count && !pool.stopping) {
+            enif_cond_wait(pool.ready, pool.lock);
+        }
+
+        // Queued jobs are completed before stopping
+        if (0 == pool.count) {
+            enif_mutex_unlock(pool.lock);
+            break;
+        }
+
+        unsigned int count = 0;
+        while (0 < pool.count && count < ASYNC_BATCH_MAX) {
+            jobs[count++] = pool.queue[pool.head];
+            pool.head = (pool.head + 1) % ASYNC_QUEUE_CAPACITY;
+            pool.count--;
+        }
+
+        enif_mutex_unlock(pool.lock);
+
+        run_jobs(jobs, count);
+    }
+
+    return NULL;
+}
+
+// Called with the pool locked
+static int start_workers(void) {
+    unsigned int threads = async_threads;
+
+    if (0 == threads) {
+        ErlNifSysInfo info;
+        enif_system_info(&info, sizeof(info));
+        threads = info.scheduler_threads > 0 ? (unsigned int) info.scheduler_threads : 1;
+    }
+
+    if (threads > ASYNC_MAX_THREADS) {
+        threads = ASYNC_MAX_THREADS;
+    }
+
+    for (unsigned int i = 0; i < threads; i++) {
+        if (0 != enif_thread_create("ockam_vault_async", &pool.threads[i], worker_main, NULL, NULL)) {
+            break;
+        }
+        pool.threads_count++;
+    }
+
+    if (0 == pool.threads_count) {
+        return -1;
+    }
+
+    pool.started = true;
+    return 0;
+}
+
+static ERL_NIF_TERM submit(ErlNifEnv *env, job_t* job) {
+    // The job may complete and be freed as soon as it's queued
+    ERL_NIF_TERM ref = enif_make_copy(env, job->ref);
+
+    enif_mutex_lock(pool.lock);
+
+    if (pool.stopping || pool.count == ASYNC_QUEUE_CAPACITY || (!pool.started && 0 != start_workers())) {
+        enif_mutex_unlock(pool.lock);
+        job_free(job);
+        return error_tuple_atom(env, "busy");
+    }
+
+    pool.queue[(pool.head + pool.count) % ASYNC_QUEUE_CAPACITY] = job;
+    pool.count++;
+
+    enif_cond_signal(pool.ready);
+    enif_mutex_unlock(pool.lock);
+
+    return ok(env, ref);
+}
+
+static job_t* job_new(ErlNifEnv *env, job_type_t type, ERL_NIF_TERM vault_term) {
+    vault_resource_t* vault_resource;
+    if (0 != parse_vault_resource(env, vault_term, &vault_resource) || !vault_resource->alive) {
+        return NULL;
+    }
+
+    job_t* job = enif_alloc(sizeof(job_t));
+    if (NULL == job) {
+        return NULL;
+    }
+
+    job->env = enif_alloc_env();
+    if (NULL == job->env) {
+        enif_free(job);
+        return NULL;
+    }
+
+    enif_self(env, &job->pid);
+    enif_keep_resource(vault_resource);
+
+    job->type           = type;
+    job->ref            = enif_make_ref(job->env);
+    job->vault_resource = vault_resource;
+    job->vault          = vault_resource->vault;
+
+    return job;
+}
+
+// Inputs are copied to the job's environment, binaries are referenced rather than copied
+static int job_inspect_iodata(job_t* job, ERL_NIF_TERM term, ErlNifBinary* binary) {
+    return inspect_iodata_as_binary(job->env, enif_make_copy(job->env, term), binary);
+}
+
+ERL_NIF_TERM set_async_threads(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]) {
+    if (1 != argc) {
+        return enif_make_badarg(env);
+    }
+
+    unsigned int threads;
+    if (0 == enif_get_uint(env, argv[0], &threads) || threads > ASYNC_MAX_THREADS) {
+        return enif_make_badarg(env);
+    }
+
+    // The workers are started by the first job, later changes would be silently ignored
+    enif_mutex_lock(pool.lock);
+    bool rejected = pool.started && threads != async_threads;
+    if (!rejected) {
+        async_threads = threads;
+    }
+    enif_mutex_unlock(pool.lock);
+
+    if (rejected) {
+        return error_tuple_atom(env, "already_started");
+    }
+
+    return ok_void(env);
+}
+
+ERL_NIF_TERM secret_generate_async(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]) {
+    if (2 != argc) {
+        return enif_make_badarg(env);
+    }
+
+    ockam_vault_secret_attributes_t attributes;
+    if (0 != parse_secret_attributes(env, argv[1], &attributes)) {
+        return enif_make_badarg(env);
+    }
+
+    job_t* job = job_new(env, JOB_SECRET_GENERATE, argv[0]);
+    if (NULL == job) {
+        return enif_make_badarg(env);
+    }
+
+    job->attributes = attributes;
+
+    return submit(env, job);
+}
+
+ERL_NIF_TERM ecdh_async(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]) {
+    if (3 != argc) {
+        return enif_make_badarg(env);
+    }
+
+    ErlNifUInt64 secret_handle;
+    if (0 == enif_get_uint64(env, argv[1], &secret_handle)) {
+        return enif_make_badarg(env);
+    }
+
+    if (!enif_is_binary(env, argv[2])) {
+        return enif_make_badarg(env);
+    }
+
+    job_t* job = job_new(env, JOB_ECDH, argv[0]);
+    if (NULL == job) {
+        return enif_make_badarg(env);
+    }
+
+    job->secret = secret_handle;
+
+    if (0 != job_inspect_iodata(job, argv[2], &job->input) || 0 == job->input.size) {
+        job_free(job);
+        return enif_make_badarg(env);
+    }
+
+    return submit(env, job);
+}
+
+static ERL_NIF_TERM aead_async(ErlNifEnv *env, job_type_t type, int argc, const ERL_NIF_TERM argv[]) {
+    if (5 != argc) {
+        return enif_make_badarg(env);
+    }
+
+    ErlNifUInt64 key_handle;
+    if (0 == enif_get_uint64(env, argv[1], &key_handle)) {
+        return enif_make_badarg(env);
+    }
+
+    ErlNifUInt64 nonce;
+    if (0 == enif_get_uint64(env, argv[2], &nonce)) {
+        return enif_make_badarg(env);
+    }
+
+    job_t* job = job_new(env, type, argv[0]);
+    if (NULL == job) {
+        return enif_make_badarg(env);
+    }
+
+    job->secret = key_handle;
+    job->nonce  = nonce;
+
+    if (0 != job_inspect_iodata(job, argv[3], &job->ad)
+        || 0 != job_inspect_iodata(job, argv[4], &job->input)
+        || job->ad.size > UINT32_MAX
+        || job->input.size > UINT32_MAX - AEAD_TAG_SIZE
+        || (JOB_AEAD_DECRYPT == type && job->input.size < AEAD_TAG_SIZE)) {
+        job_free(job);
+        return enif_make_badarg(env);
+    }
+
+    return submit(env, job);
+}
+
+ERL_NIF_TERM aead_aes_gcm_encrypt_async(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]) {
+    return aead_async(env, JOB_AEAD_ENCRYPT, argc, argv);
+}
+
+ERL_NIF_TERM aead_aes_gcm_decrypt_async(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]) {
+    return aead_async(env, JOB_AEAD_DECRYPT, argc, argv);
+}
@@ -0,0 +1,21 @@
+#ifndef OCKAM_ELIXIR_ASYNC_H
+#define OCKAM_ELIXIR_ASYNC_H
+
+#include "erl_nif.h"
+
+int async_load(ErlNifEnv *env);
+
+// Stops the workers once they've completed the queued jobs
+void async_unload(void);
+
+ERL_NIF_TERM set_async_threads(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]);
+
+ERL_NIF_TERM secret_generate_async(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]);
+
+ERL_NIF_TERM ecdh_async(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]);
+
+ERL_NIF_TERM aead_aes_gcm_encrypt_async(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]);
+
+ERL_NIF_TERM aead_aes_gcm_decrypt_async(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]);
+
+#endif //OCKAM_ELIXIR_ASYNC_H
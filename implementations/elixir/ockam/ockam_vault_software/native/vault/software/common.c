@@ -1,6 +1,13 @@
 #include "common.h"
+#include "stats.h"
 #include <memory.h>
 
+_Atomic ErlNifUInt64 dirty_threshold = 64 * 1024;
+
+bool above_dirty_threshold(size_t size) {
+    return size >= atomic_load_explicit(&dirty_threshold, memory_order_relaxed);
+}
+
 bool extern_error_has_error(const ockam_vault_extern_error_t* error) {
     return error->code != 0;
 }
@@ -11,6 +18,57 @@ bool extern_error_check_and_free_error(ockam_vault_extern_error_t* error) {
     return result;
 }
 
+// Reasons of the errors raised by the FFI layer, in the order of `ockam_vault_error_code_t`
+static const char* const FFI_ERROR_REASONS[] = {
+    "persistence_not_supported",
+    "creating_filesystem_vault",
+    "invalid_param",
+    "entry_not_found",
+    "unknown_public_key_type",
+    "invalid_string",
+    "buffer_too_small",
+    "invalid_public_key",
+    "vault_not_found",
+    "ownership",
+    "unexpected_panic",
+    "too_many_secrets",
+    "too_many_vaults",
+    "aead_auth_failed",
+};
+
+#define FFI_ERROR_COUNT (sizeof(FFI_ERROR_REASONS) / sizeof(FFI_ERROR_REASONS[0]))
+
+static ERL_NIF_TERM atom_error;
+static ERL_NIF_TERM atom_vault_error;
+static ERL_NIF_TERM ffi_error_atoms[FFI_ERROR_COUNT];
+
+int errors_load(ErlNifEnv *env) {
+    atom_error       = enif_make_atom(env, "error");
+    atom_vault_error = enif_make_atom(env, "vault_error");
+
+    for (size_t i = 0; i < FFI_ERROR_COUNT; i++) {
+        ffi_error_atoms[i] = enif_make_atom(env, FFI_ERROR_REASONS[i]);
+    }
+
+    return 0;
+}
+
+ERL_NIF_TERM extern_error_tuple(ErlNifEnv *env, ockam_vault_extern_error_t* error) {
+    int32_t code = error->code;
+    ockam_vault_free_error(error);
+
+    return error_code_tuple(env, code);
+}
+
+ERL_NIF_TERM error_code_tuple(ErlNifEnv *env, int32_t code) {
+    if (code >= OCKAM_VAULT_ERROR_PERSISTENCE_NOT_SUPPORTED
+        && code < OCKAM_VAULT_ERROR_PERSISTENCE_NOT_SUPPORTED + (int32_t) FFI_ERROR_COUNT) {
+        return enif_make_tuple2(env, atom_error, ffi_error_atoms[code - OCKAM_VAULT_ERROR_PERSISTENCE_NOT_SUPPORTED]);
+    }
+
+    return enif_make_tuple2(env, atom_error, enif_make_tuple2(env, atom_vault_error, enif_make_int(env, code)));
+}
+
 ERL_NIF_TERM ok_void(ErlNifEnv *env) {
     return enif_make_atom(env, "ok");
 }
@@ -26,36 +84,421 @@ ERL_NIF_TERM error_tuple(ErlNifEnv *env, const char* msg) {
     return enif_make_tuple2(env, e, m);
 }
 
-int parse_vault_handle(ErlNifEnv *env, ERL_NIF_TERM argv, ockam_vault_t* vault) {
-    unsigned int count;
-    if (0 == enif_get_list_length(env, argv, &count)) {
+ERL_NIF_TERM error_tuple_atom(ErlNifEnv *env, const char* reason) {
+    ERL_NIF_TERM e = enif_make_atom(env, "error");
+    ERL_NIF_TERM r = enif_make_atom(env, reason);
+    return enif_make_tuple2(env, e, r);
+}
+
+int inspect_iodata(ErlNifEnv *env, ERL_NIF_TERM term, iodata_t* iodata) {
+    ERL_NIF_TERM tail;
+
+    iodata->iovec = NULL;
+
+    if (enif_is_binary(env, term)) {
+        if (0 == enif_inspect_binary(env, term, &iodata->binary)) {
+            return -1;
+        }
+        iodata->size = iodata->binary.size;
+        return 0;
+    }
+
+    if (enif_inspect_iovec(env, ~(size_t) 0, term, &tail, &iodata->iovec) && enif_is_empty_list(env, tail)) {
+        iodata->size = iodata->iovec->size;
+        return 0;
+    }
+
+    iodata->iovec = NULL;
+
+    if (0 == enif_inspect_iolist_as_binary(env, term, &iodata->binary)) {
         return -1;
     }
+    iodata->size = iodata->binary.size;
 
-    if (count != 2) {
+    return 0;
+}
+
+void copy_iodata(const iodata_t* iodata, uint8_t* destination) {
+    if (NULL == iodata->iovec) {
+        memcpy(destination, iodata->binary.data, iodata->binary.size);
+        return;
+    }
+
+    for (int i = 0; i < iodata->iovec->iovcnt; i++) {
+        memcpy(destination, iodata->iovec->iov[i].iov_base, iodata->iovec->iov[i].iov_len);
+        destination += iodata->iovec->iov[i].iov_len;
+    }
+}
+
+int inspect_iodata_as_binary(ErlNifEnv *env, ERL_NIF_TERM term, ErlNifBinary* binary) {
+    static uint8_t empty[1];
+
+    if (enif_is_binary(env, term)) {
+        if (0 == enif_inspect_binary(env, term, binary)) {
+            return -1;
+        }
+    } else if (0 == enif_inspect_iolist_as_binary(env, term, binary)) {
+        return -1;
+    }
+
+    // The vault rejects NULL buffers, even empty ones
+    if (NULL == binary->data) {
+        binary->data = empty;
+    }
+
+    return 0;
+}
+
+void put_nonce(uint8_t* frame, uint64_t nonce) {
+    for (size_t i = 0; i < AEAD_NONCE_SIZE; i++) {
+        frame[i] = (uint8_t) (nonce >> (8 * (AEAD_NONCE_SIZE - 1 - i)));
+    }
+}
+
+int parse_aead_cipher(ErlNifEnv *env, ERL_NIF_TERM term, aead_cipher_t* cipher) {
+    if (enif_is_identical(term, enif_make_atom(env, "aes_gcm"))) {
+        *cipher = AEAD_AES_GCM;
+    } else if (enif_is_identical(term, enif_make_atom(env, "chacha20_poly1305"))) {
+        *cipher = AEAD_CHACHA20_POLY1305;
+    } else {
+        return -1;
+    }
+
+    return 0;
+}
+
+ockam_vault_extern_error_t aead_encrypt_in_place(aead_cipher_t cipher,
+                                                 ockam_vault_t vault,
+                                                 ockam_vault_secret_t key,
+                                                 uint64_t nonce,
+                                                 const uint8_t* additional_data,
+                                                 uint32_t additional_data_length,
+                                                 uint8_t* buffer,
+                                                 uint32_t plaintext_length,
+                                                 uint32_t buffer_size,
+                                                 uint32_t* ciphertext_and_tag_length) {
+    if (AEAD_CHACHA20_POLY1305 == cipher) {
+        return ockam_vault_aead_chacha20_poly1305_encrypt_in_place(vault,
+                                                                   key,
+                                                                   nonce,
+                                                                   additional_data,
+                                                                   additional_data_length,
+                                                                   buffer,
+                                                                   plaintext_length,
+                                                                   buffer_size,
+                                                                   ciphertext_and_tag_length);
+    }
+
+    return ockam_vault_aead_aes_gcm_encrypt_in_place(vault,
+                                                     key,
+                                                     nonce,
+                                                     additional_data,
+                                                     additional_data_length,
+                                                     buffer,
+                                                     plaintext_length,
+                                                     buffer_size,
+                                                     ciphertext_and_tag_length);
+}
+
+ockam_vault_extern_error_t aead_decrypt(aead_cipher_t cipher,
+                                        ockam_vault_t vault,
+                                        ockam_vault_secret_t key,
+                                        uint64_t nonce,
+                                        const uint8_t* additional_data,
+                                        uint32_t additional_data_length,
+                                        const uint8_t* ciphertext_and_tag,
+                                        uint32_t ciphertext_and_tag_length,
+                                        uint8_t* plaintext,
+                                        uint32_t plaintext_size,
+                                        uint32_t* plaintext_length) {
+    if (AEAD_CHACHA20_POLY1305 == cipher) {
+        return ockam_vault_aead_chacha20_poly1305_decrypt(vault,
+                                                          key,
+                                                          nonce,
+                                                          additional_data,
+                                                          additional_data_length,
+                                                          ciphertext_and_tag,
+                                                          ciphertext_and_tag_length,
+                                                          plaintext,
+                                                          plaintext_size,
+                                                          plaintext_length);
+    }
+
+    return ockam_vault_aead_aes_gcm_decrypt(vault,
+                                            key,
+                                            nonce,
+                                            additional_data,
+                                            additional_data_length,
+                                            ciphertext_and_tag,
+                                            ciphertext_and_tag_length,
+                                            plaintext,
+                                            plaintext_size,
+                                            plaintext_length);
+}
+
+ockam_vault_extern_error_t aead_rekey(aead_cipher_t cipher,
+                                      ockam_vault_t vault,
+                                      ockam_vault_secret_t key,
+                                      bool destroy_old,
+                                      ockam_vault_secret_t* new_key) {
+    if (AEAD_CHACHA20_POLY1305 == cipher) {
+        return ockam_vault_aead_chacha20_poly1305_rekey(vault, key, destroy_old, new_key);
+    }
+
+    return ockam_vault_aead_aes_gcm_rekey(vault, key, destroy_old, new_key);
+}
+
+int aead_encrypt_iodata(ErlNifEnv *env,
+                        ockam_vault_t vault,
+                        aead_cipher_t cipher,
+                        ockam_vault_secret_t key,
+                        uint64_t nonce,
+                        const ErlNifBinary* ad,
+                        const iodata_t* plain_text,
+                        bool framed,
+                        ERL_NIF_TERM* result) {
+    if (plain_text->size > UINT32_MAX - AEAD_NONCE_SIZE - AEAD_TAG_SIZE) {
+        *result = enif_make_badarg(env);
         return -1;
     }
 
-    ERL_NIF_TERM current_list = argv;
+    size_t header_size = framed ? AEAD_NONCE_SIZE : 0;
+    size_t size = header_size + plain_text->size + AEAD_TAG_SIZE;
+
+    ERL_NIF_TERM term;
+    uint8_t* output = enif_make_new_binary(env, size, &term);
+
+    if (NULL == output) {
+        *result = error_tuple(env, "failed to create buffer for aead_aes_gcm_encrypt");
+        return -1;
+    }
+
+    if (framed) {
+        put_nonce(output, nonce);
+    }
+
+    // The plaintext is gathered right where the ciphertext goes and encrypted there
+    copy_iodata(plain_text, output + header_size);
+
+    uint32_t length = 0;
+
+    ockam_vault_extern_error_t error = aead_encrypt_in_place(cipher,
+                                                             vault,
+                                                             key,
+                                                             nonce,
+                                                             ad->data,
+                                                             ad->size,
+                                                             output + header_size,
+                                                             plain_text->size,
+                                                             size - header_size,
+                                                             &length);
+    if (extern_error_has_error(&error)) {
+        *result = extern_error_tuple(env, &error);
+        return -1;
+    }
+
+    if (length != size - header_size) {
+        *result = error_tuple(env, "buffer size is invalid during aead_aes_gcm_encrypt");
+        return -1;
+    }
+
+    *result = ok(env, term);
+    return 0;
+}
+
+// Bounds the work spent sizing an iolist on the calling scheduler
+#define IODATA_WALK_MAX_CELLS 4096
+#define IODATA_WALK_MAX_DEPTH 32
+
+bool is_large_iodata(ErlNifEnv *env, ERL_NIF_TERM payload) {
+    ErlNifBinary binary;
+    if (enif_inspect_binary(env, payload, &binary)) {
+        return above_dirty_threshold(binary.size);
+    }
+
+    if (!enif_is_list(env, payload)) {
+        return false;
+    }
+
+    // The tails left to walk in the enclosing lists
+    ERL_NIF_TERM tails[IODATA_WALK_MAX_DEPTH];
+    int depth = 0;
+
+    ERL_NIF_TERM list = payload;
+    size_t size = 0;
+
+    for (int cells = 0; cells < IODATA_WALK_MAX_CELLS; cells++) {
+        ERL_NIF_TERM head;
+        ERL_NIF_TERM tail;
+
+        if (!enif_get_list_cell(env, list, &head, &tail)) {
+            // An iolist may end with a binary tail, other terms are rejected by the NIF itself
+            if (enif_inspect_binary(env, list, &binary)) {
+                size += binary.size;
+            }
+
+            if (0 == depth) {
+                return above_dirty_threshold(size);
+            }
+
+            list = tails[--depth];
+            continue;
+        }
+
+        list = tail;
+
+        if (enif_inspect_binary(env, head, &binary)) {
+            size += binary.size;
+        } else if (enif_is_list(env, head)) {
+            if (IODATA_WALK_MAX_DEPTH == depth) {
+                return true;
+            }
+
+            tails[depth++] = list;
+            list = head;
+        } else {
+            size += 1;
+        }
+
+        if (above_dirty_threshold(size)) {
+            return true;
+        }
+    }
+
+    return true;
+}
+
+ERL_NIF_TERM schedule_by_size(ErlNifEnv *env,
+                              const char* name,
+                              nif_function_t function,
+                              ERL_NIF_TERM payload,
+                              int argc,
+                              const ERL_NIF_TERM argv[]) {
+    if (ERL_NIF_THR_NORMAL_SCHEDULER == enif_thread_type() && is_large_iodata(env, payload)) {
+        return schedule_dirty(env, name, function, argc, argv);
+    }
+
+    return function(env, argc, argv);
+}
+
+ERL_NIF_TERM schedule_dirty(ErlNifEnv *env,
+                            const char* name,
+                            nif_function_t function,
+                            int argc,
+                            const ERL_NIF_TERM argv[]) {
+    return enif_schedule_nif(env, name, ERL_NIF_DIRTY_JOB_CPU_BOUND, stats_dirty_function(function), argc, argv);
+}
+
+int parse_aead_messages(ErlNifEnv *env,
+                        ERL_NIF_TERM list,
+                        unsigned int count,
+                        ockam_vault_aead_message_t* messages,
+                        size_t* frames_size) {
+    ERL_NIF_TERM current_list = list;
     ERL_NIF_TERM head;
     ERL_NIF_TERM tail;
+    size_t size = 0;
+
+    for (unsigned int i = 0; i < count; i++) {
+        int arity;
+        const ERL_NIF_TERM* pair;
+        ErlNifBinary ad;
+        ErlNifBinary plain_text;
+
+        if (0 == enif_get_list_cell(env, current_list, &head, &tail)
+            || 0 == enif_get_tuple(env, head, &arity, &pair)
+            || 2 != arity
+            || 0 != inspect_iodata_as_binary(env, pair[0], &ad)
+            || 0 != inspect_iodata_as_binary(env, pair[1], &plain_text)) {
+            return -1;
+        }
+        current_list = tail;
+
+        messages[i].additional_data        = ad.data;
+        messages[i].additional_data_length = ad.size;
+        messages[i].plaintext              = plain_text.data;
+        messages[i].plaintext_length       = plain_text.size;
+
+        size += AEAD_NONCE_SIZE + plain_text.size + AEAD_TAG_SIZE;
+    }
+
+    *frames_size = size;
+
+    return 0;
+}
+
+ERL_NIF_TERM make_frames_list(ErlNifEnv *env,
+                              ERL_NIF_TERM output,
+                              size_t output_size,
+                              const ockam_vault_aead_message_t* messages,
+                              unsigned int count) {
+    // All frames share the single output binary, build the list backwards from its end
+    ERL_NIF_TERM frames = enif_make_list(env, 0);
+    size_t offset = output_size;
+    for (unsigned int i = count; i > 0; i--) {
+        size_t frame_size = AEAD_NONCE_SIZE + messages[i - 1].plaintext_length + AEAD_TAG_SIZE;
+        offset -= frame_size;
+        frames = enif_make_list_cell(env, enif_make_sub_binary(env, output, offset, frame_size), frames);
+    }
+
+    return frames;
+}
+
+static ErlNifResourceType* vault_resource_type = NULL;
+
+static void vault_resource_destructor(ErlNifEnv *env, void *obj) {
+    vault_resource_t* resource = obj;
+
+    if (resource->alive) {
+        ockam_vault_extern_error_t error = ockam_vault_deinit(resource->vault);
+        extern_error_check_and_free_error(&error);
+    }
+}
+
+int vault_resource_load(ErlNifEnv *env) {
+    vault_resource_type = enif_open_resource_type(env,
+                                                  NULL,
+                                                  "vault",
+                                                  vault_resource_destructor,
+                                                  ERL_NIF_RT_CREATE | ERL_NIF_RT_TAKEOVER,
+                                                  NULL);
+    if (NULL == vault_resource_type) {
+        return -1;
+    }
+
+    return 0;
+}
+
+int make_vault_resource(ErlNifEnv *env, ockam_vault_t vault, ERL_NIF_TERM* term) {
+    vault_resource_t* resource = enif_alloc_resource(vault_resource_type, sizeof(vault_resource_t));
+    if (NULL == resource) {
+        return -1;
+    }
+
+    resource->vault = vault;
+    resource->alive = true;
 
-    if (0 == enif_get_list_cell(env, current_list, &head, &tail)) {
+    *term = enif_make_resource(env, resource);
+    enif_release_resource(resource);
+
+    return 0;
+}
+
+int parse_vault_resource(ErlNifEnv *env, ERL_NIF_TERM term, vault_resource_t** resource) {
+    if (0 == enif_get_resource(env, term, vault_resource_type, (void**) resource)) {
         return -1;
     }
-    current_list = tail;
 
-    ErlNifUInt64 handle = 0;
-    enif_get_uint64(env, head, &handle);
+    return 0;
+}
 
-    if (0 == enif_get_list_cell(env, current_list, &head, &tail)) {
+int parse_vault_handle(ErlNifEnv *env, ERL_NIF_TERM term, ockam_vault_t* vault) {
+    vault_resource_t* resource;
+    if (0 != parse_vault_resource(env, term, &resource) || !resource->alive) {
         return -1;
     }
 
-    ErlNifUInt64 vault_type = 0;
-    enif_get_uint64(env, head, &vault_type);
-    vault->handle = handle;
-    vault->vault_type = vault_type;
+    *vault = resource->vault;
 
     return 0;
 }
@@ -2,19 +2,155 @@
 #define OCKAM_ELIXIR_COMMON_H
 
 #include <memory.h>
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <ockam/vault.h>
 #include "erl_nif.h"
 
+#define AEAD_NONCE_SIZE 8
+#define AEAD_TAG_SIZE   16
+
+typedef ERL_NIF_TERM (*nif_function_t)(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]);
+
+// Payloads at or above this size are rescheduled on a dirty CPU scheduler,
+// so large hashes and AEAD operations don't block normal schedulers.
+// set_dirty_threshold/1 can change it from any scheduler while others read it.
+extern _Atomic ErlNifUInt64 dirty_threshold;
+
+bool above_dirty_threshold(size_t size);
+
 bool extern_error_has_error(const ockam_vault_extern_error_t *error);
 bool extern_error_check_and_free_error(ockam_vault_extern_error_t *error);
 
+int errors_load(ErlNifEnv *env);
+
+// Frees `error` and returns {:error, reason}, with a preallocated atom reason for the errors
+// raised by the FFI layer, e.g. :aead_auth_failed, and {:vault_error, code} for other ones
+ERL_NIF_TERM extern_error_tuple(ErlNifEnv *env, ockam_vault_extern_error_t *error);
+
+// {:error, reason} for an error code of the FFI layer, as returned by `extern_error_tuple`
+ERL_NIF_TERM error_code_tuple(ErlNifEnv *env, int32_t code);
+
 ERL_NIF_TERM ok_void(ErlNifEnv *env);
 
 ERL_NIF_TERM ok(ErlNifEnv *env, ERL_NIF_TERM result);
 
 ERL_NIF_TERM error_tuple(ErlNifEnv *env, const char* msg);
 
-int parse_vault_handle(ErlNifEnv *env, ERL_NIF_TERM argv, ockam_vault_t* vault);
+ERL_NIF_TERM error_tuple_atom(ErlNifEnv *env, const char* reason);
+
+// A view over iodata: binaries and flat lists of binaries are referenced in place,
+// other iolists are flattened once
+typedef struct {
+    ErlNifIOVec* iovec;
+    ErlNifBinary binary;
+    size_t       size;
+} iodata_t;
+
+int inspect_iodata(ErlNifEnv *env, ERL_NIF_TERM term, iodata_t* iodata);
+
+void copy_iodata(const iodata_t* iodata, uint8_t* destination);
+
+// Contiguous view over iodata, for inputs the vault needs in one buffer
+int inspect_iodata_as_binary(ErlNifEnv *env, ERL_NIF_TERM term, ErlNifBinary* binary);
+
+void put_nonce(uint8_t* frame, uint64_t nonce);
+
+// AEAD ciphers of the secure channels, both with AEAD_TAG_SIZE tags
+typedef enum {
+    AEAD_AES_GCM,
+    AEAD_CHACHA20_POLY1305,
+} aead_cipher_t;
+
+// Parses :aes_gcm or :chacha20_poly1305
+int parse_aead_cipher(ErlNifEnv *env, ERL_NIF_TERM term, aead_cipher_t* cipher);
+
+// Dispatch to the ockam_vault_aead_* function of `cipher`
+ockam_vault_extern_error_t aead_encrypt_in_place(aead_cipher_t cipher,
+                                                 ockam_vault_t vault,
+                                                 ockam_vault_secret_t key,
+                                                 uint64_t nonce,
+                                                 const uint8_t* additional_data,
+                                                 uint32_t additional_data_length,
+                                                 uint8_t* buffer,
+                                                 uint32_t plaintext_length,
+                                                 uint32_t buffer_size,
+                                                 uint32_t* ciphertext_and_tag_length);
+
+ockam_vault_extern_error_t aead_decrypt(aead_cipher_t cipher,
+                                        ockam_vault_t vault,
+                                        ockam_vault_secret_t key,
+                                        uint64_t nonce,
+                                        const uint8_t* additional_data,
+                                        uint32_t additional_data_length,
+                                        const uint8_t* ciphertext_and_tag,
+                                        uint32_t ciphertext_and_tag_length,
+                                        uint8_t* plaintext,
+                                        uint32_t plaintext_size,
+                                        uint32_t* plaintext_length);
+
+ockam_vault_extern_error_t aead_rekey(aead_cipher_t cipher,
+                                      ockam_vault_t vault,
+                                      ockam_vault_secret_t key,
+                                      bool destroy_old,
+                                      ockam_vault_secret_t* new_key);
+
+// Encrypts `plain_text` in a single new binary, preceded by the big-endian nonce when `framed`.
+// `result` is set to the {:ok, binary} or error tuple, the return value tells which one.
+int aead_encrypt_iodata(ErlNifEnv *env,
+                        ockam_vault_t vault,
+                        aead_cipher_t cipher,
+                        ockam_vault_secret_t key,
+                        uint64_t nonce,
+                        const ErlNifBinary* ad,
+                        const iodata_t* plain_text,
+                        bool framed,
+                        ERL_NIF_TERM* result);
+
+// Whether a binary or iolist holds at least `dirty_threshold` bytes. Nested iolists are walked
+// without being copied, those too long or too deep to walk cheaply are considered large.
+bool is_large_iodata(ErlNifEnv *env, ERL_NIF_TERM payload);
+
+ERL_NIF_TERM schedule_by_size(ErlNifEnv *env,
+                              const char* name,
+                              nif_function_t function,
+                              ERL_NIF_TERM payload,
+                              int argc,
+                              const ERL_NIF_TERM argv[]);
+
+// Reschedules `function` on a dirty CPU scheduler
+ERL_NIF_TERM schedule_dirty(ErlNifEnv *env,
+                            const char* name,
+                            nif_function_t function,
+                            int argc,
+                            const ERL_NIF_TERM argv[]);
+
+// Parses a list of `count` {ad, plain_text} tuples, returning the size of the nonce-prefixed frames
+int parse_aead_messages(ErlNifEnv *env,
+                        ERL_NIF_TERM list,
+                        unsigned int count,
+                        ockam_vault_aead_message_t* messages,
+                        size_t* frames_size);
+
+ERL_NIF_TERM make_frames_list(ErlNifEnv *env,
+                              ERL_NIF_TERM output,
+                              size_t output_size,
+                              const ockam_vault_aead_message_t* messages,
+                              unsigned int count);
+
+// Vault handles are resources, the vault is deinitialized when the last reference is garbage collected
+// unless `deinit` was already called on it
+typedef struct {
+    ockam_vault_t vault;
+    bool          alive;
+} vault_resource_t;
+
+int vault_resource_load(ErlNifEnv *env);
+
+int make_vault_resource(ErlNifEnv *env, ockam_vault_t vault, ERL_NIF_TERM* term);
+
+int parse_vault_resource(ErlNifEnv *env, ERL_NIF_TERM term, vault_resource_t** resource);
+
+int parse_vault_handle(ErlNifEnv *env, ERL_NIF_TERM term, ockam_vault_t* vault);
 
 #endif //OCKAM_ELIXIR_COMMON_H
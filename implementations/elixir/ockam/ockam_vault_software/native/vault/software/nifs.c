@@ -1,22 +1,105 @@
 #include "erl_nif.h"
+#include "common.h"
 #include "vault.h"
+#include "aead_aes_gcm.h"
+#include "sha256.h"
+#include "stats.h"
+#include "async.h"
+#include "aead_stream.h"
 
 static ErlNifFunc nifs[] = {
   // {erl_function_name, erl_function_arity, c_function}
-  {"default_init", 0, default_init},
-  {"sha256", 2, sha256},
-  {"secret_generate", 2, secret_generate},
-  {"secret_import", 3, secret_import},
-  {"secret_export", 2, secret_export},
-  {"secret_publickey_get", 2, secret_publickey_get},
-  {"secret_attributes_get", 2, secret_attributes_get},
-  {"secret_destroy", 2, secret_destroy},
-  {"ecdh", 3, ecdh},
-  {"hkdf_sha256", 3, hkdf_sha256},
-  {"hkdf_sha256", 4, hkdf_sha256},
-  {"aead_aes_gcm_encrypt", 5, aead_aes_gcm_encrypt},
-  {"aead_aes_gcm_decrypt", 5, aead_aes_gcm_decrypt},
-  {"deinit", 1, deinit},
+  {"default_init", 0, default_init_instrumented},
+  {"default_init", 1, default_init_instrumented},
+  {"set_dirty_threshold", 1, set_dirty_threshold},
+  {"set_async_runtime", 1, set_async_runtime},
+  {"set_keypair_pool_watermark", 2, set_keypair_pool_watermark},
+  {"set_async_threads", 1, set_async_threads},
+  {"backend_info", 0, backend_info},
+  {"sha256", 2, sha256_instrumented},
+  {"sha256_many", 2, sha256_many_instrumented},
+  {"sha256_init", 0, sha256_init_instrumented},
+  {"sha256_update", 2, sha256_update_instrumented},
+  {"sha256_final", 1, sha256_final_instrumented},
+  {"sha256_clone", 1, sha256_clone_instrumented},
+  {"secret_generate", 2, secret_generate_instrumented},
+  {"secret_generate_async", 2, secret_generate_async_instrumented},
+  {"secret_import", 3, secret_import_instrumented},
+  {"secret_export", 2, secret_export_instrumented},
+  {"secret_publickey_get", 2, secret_publickey_get_instrumented},
+  {"secret_attributes_get", 2, secret_attributes_get_instrumented},
+  {"secret_destroy", 2, secret_destroy_instrumented},
+  {"ecdh", 3, ecdh_instrumented},
+  {"ecdh_batch", 2, ecdh_batch_instrumented},
+  {"ecdh_async", 3, ecdh_async_instrumented},
+  {"hkdf_sha256", 3, hkdf_sha256_instrumented},
+  {"hkdf_sha256", 4, hkdf_sha256_instrumented},
+  {"ecdh_hkdf_sha256", 5, ecdh_hkdf_sha256_instrumented},
+  {"aead_aes_gcm_encrypt", 5, aead_aes_gcm_encrypt_instrumented},
+  {"aead_aes_gcm_encrypt_async", 5, aead_aes_gcm_encrypt_async_instrumented},
+  {"aead_aes_gcm_encrypt_framed", 5, aead_aes_gcm_encrypt_framed_instrumented},
+  {"aead_aes_gcm_encrypt_batch", 4, aead_aes_gcm_encrypt_batch_instrumented},
+  {"aead_aes_gcm_encrypt_and_hash", 5, aead_aes_gcm_encrypt_and_hash_instrumented},
+  {"aead_aes_gcm_decrypt_and_hash", 5, aead_aes_gcm_decrypt_and_hash_instrumented},
+  {"aead_aes_gcm_rekey", 3, aead_aes_gcm_rekey_instrumented},
+  {"aead_aes_gcm_decrypt", 5, aead_aes_gcm_decrypt_instrumented},
+  {"aead_aes_gcm_decrypt_async", 5, aead_aes_gcm_decrypt_async_instrumented},
+  {"aead_chacha20_poly1305_encrypt", 5, aead_chacha20_poly1305_encrypt_instrumented},
+  {"aead_chacha20_poly1305_decrypt", 5, aead_chacha20_poly1305_decrypt_instrumented},
+  {"aead_aes_gcm_encryptor_new", 4, aead_aes_gcm_encryptor_new_instrumented},
+  {"aead_aes_gcm_encryptor_new", 5, aead_aes_gcm_encryptor_new_instrumented},
+  {"aead_chacha20_poly1305_encryptor_new", 4, aead_chacha20_poly1305_encryptor_new_instrumented},
+  {"aead_aes_gcm_encryptor_encrypt", 3, aead_aes_gcm_encryptor_encrypt_instrumented},
+  {"aead_aes_gcm_encryptor_encrypt_batch", 2, aead_aes_gcm_encryptor_encrypt_batch_instrumented},
+  {"aead_aes_gcm_decryptor_new", 4, aead_aes_gcm_decryptor_new_instrumented},
+  {"aead_aes_gcm_decryptor_new", 5, aead_aes_gcm_decryptor_new_instrumented},
+  {"aead_chacha20_poly1305_decryptor_new", 4, aead_chacha20_poly1305_decryptor_new_instrumented},
+  {"aead_aes_gcm_decryptor_decrypt", 3, aead_aes_gcm_decryptor_decrypt_instrumented},
+  {"aead_aes_gcm_stream_init", 4, aead_aes_gcm_stream_init_instrumented},
+  {"aead_aes_gcm_stream_update", 3, aead_aes_gcm_stream_update_instrumented},
+  {"aead_aes_gcm_stream_finalize", 3, aead_aes_gcm_stream_finalize_instrumented},
+  {"deinit", 1, deinit_instrumented},
+  {"stats", 0, stats},
 };
 
-ERL_NIF_INIT(Elixir.Ockam.Vault.Software, nifs, NULL, NULL, NULL, NULL)
+static int open_resource_types(ErlNifEnv *env) {
+  if (0 != errors_load(env)) {
+    return -1;
+  }
+
+  if (0 != vault_resource_load(env)) {
+    return -1;
+  }
+
+  if (0 != sha256_load(env)) {
+    return -1;
+  }
+
+  if (0 != stats_load(env)) {
+    return -1;
+  }
+
+  if (0 != async_load(env)) {
+    return -1;
+  }
+
+  if (0 != aead_stream_load(env)) {
+    return -1;
+  }
+
+  return aead_aes_gcm_load(env);
+}
+
+static int load(ErlNifEnv *env, void **priv_data, ERL_NIF_TERM load_info) {
+  return open_resource_types(env);
+}
+
+static int upgrade(ErlNifEnv *env, void **priv_data, void **old_priv_data, ERL_NIF_TERM load_info) {
+  return open_resource_types(env);
+}
+
+static void unload(ErlNifEnv *env, void *priv_data) {
+  async_unload();
+}
+
+ERL_NIF_INIT(Elixir.Ockam.Vault.Software, nifs, load, NULL, upgrade, unload)
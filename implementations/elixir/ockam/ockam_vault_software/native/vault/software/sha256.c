@@ -0,0 +1,184 @@
+#include "common.h"
+#include "sha256.h"
+#include "ockam/vault.h"
+
+static const size_t SHA256_SIZE = 32;
+
+static ErlNifResourceType* sha256_resource_type = NULL;
+
+typedef struct {
+    ErlNifMutex*              lock;
+    ockam_vault_sha256_ctx_t* context;
+} sha256_resource_t;
+
+static void sha256_destructor(ErlNifEnv *env, void *obj) {
+    sha256_resource_t* resource = obj;
+
+    if (NULL != resource->context) {
+        ockam_vault_extern_error_t error = ockam_vault_sha256_free(resource->context);
+        extern_error_check_and_free_error(&error);
+    }
+
+    if (NULL != resource->lock) {
+        enif_mutex_destroy(resource->lock);
+    }
+}
+
+int sha256_load(ErlNifEnv *env) {
+    sha256_resource_type = enif_open_resource_type(env,
+                                                   NULL,
+                                                   "sha256_context",
+                                                   sha256_destructor,
+                                                   ERL_NIF_RT_CREATE | ERL_NIF_RT_TAKEOVER,
+                                                   NULL);
+    if (NULL == sha256_resource_type) {
+        return -1;
+    }
+
+    return 0;
+}
+
+// Takes ownership of `context`, which is freed by the resource destructor
+static ERL_NIF_TERM make_sha256_resource(ErlNifEnv *env, ockam_vault_sha256_ctx_t* context) {
+    sha256_resource_t* resource = enif_alloc_resource(sha256_resource_type, sizeof(sha256_resource_t));
+    if (NULL == resource) {
+        ockam_vault_extern_error_t error = ockam_vault_sha256_free(context);
+        extern_error_check_and_free_error(&error);
+        return error_tuple(env, "failed to create sha256 context");
+    }
+
+    resource->context = context;
+    resource->lock    = enif_mutex_create("sha256_context");
+
+    if (NULL == resource->lock) {
+        enif_release_resource(resource);
+        return error_tuple(env, "failed to create sha256 context");
+    }
+
+    ERL_NIF_TERM term = enif_make_resource(env, resource);
+    enif_release_resource(resource);
+
+    return ok(env, term);
+}
+
+static bool update(sha256_resource_t* resource, const uint8_t* data, size_t size) {
+    if (0 == size) {
+        return true;
+    }
+
+    if (size > UINT32_MAX) {
+        return false;
+    }
+
+    ockam_vault_extern_error_t error = ockam_vault_sha256_update(resource->context, data, size);
+    return !extern_error_check_and_free_error(&error);
+}
+
+ERL_NIF_TERM sha256_init(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]) {
+    if (0 != argc) {
+        return enif_make_badarg(env);
+    }
+
+    ockam_vault_sha256_ctx_t* context;
+
+    ockam_vault_extern_error_t error = ockam_vault_sha256_init(&context);
+    if (extern_error_has_error(&error)) {
+        return extern_error_tuple(env, &error);
+    }
+
+    return make_sha256_resource(env, context);
+}
+
+static ERL_NIF_TERM sha256_update_run(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]) {
+    if (2 != argc) {
+        return enif_make_badarg(env);
+    }
+
+    sha256_resource_t* resource;
+    if (0 == enif_get_resource(env, argv[0], sha256_resource_type, (void**) &resource)) {
+        return enif_make_badarg(env);
+    }
+
+    iodata_t input;
+    if (0 != inspect_iodata(env, argv[1], &input)) {
+        return enif_make_badarg(env);
+    }
+
+    bool updated = true;
+
+    enif_mutex_lock(resource->lock);
+    if (NULL == input.iovec) {
+        updated = update(resource, input.binary.data, input.binary.size);
+    } else {
+        // A flat list of binaries is absorbed in place, one FFI call per binary
+        for (int i = 0; updated && i < input.iovec->iovcnt; i++) {
+            updated = update(resource, input.iovec->iov[i].iov_base, input.iovec->iov[i].iov_len);
+        }
+    }
+    enif_mutex_unlock(resource->lock);
+
+    if (!updated) {
+        return error_tuple(env, "failed to update sha256 context");
+    }
+
+    return ok_void(env);
+}
+
+ERL_NIF_TERM sha256_update(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]) {
+    if (2 != argc) {
+        return enif_make_badarg(env);
+    }
+
+    return schedule_by_size(env, "sha256_update", sha256_update_run, argv[1], argc, argv);
+}
+
+ERL_NIF_TERM sha256_final(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]) {
+    if (1 != argc) {
+        return enif_make_badarg(env);
+    }
+
+    sha256_resource_t* resource;
+    if (0 == enif_get_resource(env, argv[0], sha256_resource_type, (void**) &resource)) {
+        return enif_make_badarg(env);
+    }
+
+    ERL_NIF_TERM term;
+    uint8_t* digest = enif_make_new_binary(env, SHA256_SIZE, &term);
+
+    if (NULL == digest) {
+        return error_tuple(env, "failed to create buffer for sha256");
+    }
+
+    enif_mutex_lock(resource->lock);
+    ockam_vault_extern_error_t error = ockam_vault_sha256_final(resource->context, digest);
+    enif_mutex_unlock(resource->lock);
+
+    if (extern_error_has_error(&error)) {
+        return extern_error_tuple(env, &error);
+    }
+
+    return ok(env, term);
+}
+
+ERL_NIF_TERM sha256_clone(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]) {
+    if (1 != argc) {
+        return enif_make_badarg(env);
+    }
+
+    sha256_resource_t* resource;
+    if (0 == enif_get_resource(env, argv[0], sha256_resource_type, (void**) &resource)) {
+        return enif_make_badarg(env);
+    }
+
+    ockam_vault_sha256_ctx_t* clone;
+
+    enif_mutex_lock(resource->lock);
+    ockam_vault_extern_error_t error = ockam_vault_sha256_clone(resource->context, &clone);
+    enif_mutex_unlock(resource->lock);
+
+    if (extern_error_has_error(&error)) {
+        return extern_error_tuple(env, &error);
+    }
+
+    return make_sha256_resource(env, clone);
+}
@@ -0,0 +1,16 @@
+#ifndef OCKAM_ELIXIR_SHA256_H
+#define OCKAM_ELIXIR_SHA256_H
+
+#include "erl_nif.h"
+
+int sha256_load(ErlNifEnv *env);
+
+ERL_NIF_TERM sha256_init(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]);
+
+ERL_NIF_TERM sha256_update(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]);
+
+ERL_NIF_TERM sha256_final(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]);
+
+ERL_NIF_TERM sha256_clone(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]);
+
+#endif //OCKAM_ELIXIR_SHA256_H
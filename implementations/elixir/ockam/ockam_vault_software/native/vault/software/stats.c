@@ -0,0 +1,252 @@
+#include <stdatomic.h>
+#include "common.h"
+#include "stats.h"
+#include "vault.h"
+#include "aead_aes_gcm.h"
+#include "sha256.h"
+#include "async.h"
+#include "aead_stream.h"
+
+// Counters are sharded, every thread updates the shard it was assigned on its first call,
+// so schedulers running NIFs concurrently don't bounce the same cache lines.
+#define STATS_SHARDS 16
+
+#define STAT_ID(name) STAT_##name,
+#define STAT_NAME(name) #name,
+
+typedef enum {
+    INSTRUMENTED_NIFS(STAT_ID)
+    STATS_COUNT
+} stat_id_t;
+
+static const char* const STAT_NAMES[STATS_COUNT] = {
+    INSTRUMENTED_NIFS(STAT_NAME)
+};
+
+typedef struct {
+    _Atomic uint64_t calls;
+    _Atomic uint64_t errors;
+    _Atomic uint64_t dirty;
+    _Atomic uint64_t bytes_in;
+    _Atomic uint64_t bytes_out;
+    _Atomic uint64_t latency[STATS_LATENCY_BUCKETS];
+} nif_stats_t;
+
+typedef struct {
+    _Alignas(64) nif_stats_t nifs[STATS_COUNT];
+} stats_shard_t;
+
+static stats_shard_t shards[STATS_SHARDS];
+
+static _Atomic unsigned int next_shard = 0;
+
+static _Thread_local int thread_shard = -1;
+
+// The wrapper of the instrumented NIF running on this thread, if any
+typedef struct {
+    nif_function_t wrapper;
+    bool           rescheduled;
+} running_nif_t;
+
+static _Thread_local running_nif_t running = {NULL, false};
+
+static ERL_NIF_TERM atom_ok;
+static ERL_NIF_TERM atom_error;
+
+int stats_load(ErlNifEnv *env) {
+    atom_ok    = enif_make_atom(env, "ok");
+    atom_error = enif_make_atom(env, "error");
+    return 0;
+}
+
+nif_function_t stats_dirty_function(nif_function_t function) {
+    if (NULL == running.wrapper) {
+        return function;
+    }
+
+    running.rescheduled = true;
+    return running.wrapper;
+}
+
+static nif_stats_t* thread_stats(stat_id_t id) {
+    if (thread_shard < 0) {
+        thread_shard = (int) (atomic_fetch_add_explicit(&next_shard, 1, memory_order_relaxed) % STATS_SHARDS);
+    }
+
+    return &shards[thread_shard].nifs[id];
+}
+
+static unsigned int latency_bucket(ErlNifTime nanoseconds) {
+    if (nanoseconds <= 0) {
+        return 0;
+    }
+
+    unsigned int bucket = 64 - __builtin_clzll((unsigned long long) nanoseconds);
+    return bucket < STATS_LATENCY_BUCKETS ? bucket : STATS_LATENCY_BUCKETS - 1;
+}
+
+// Top-level binaries only, inspecting them doesn't copy, unlike iodata which would have to be
+// flattened on every call
+static size_t terms_size(ErlNifEnv *env, const ERL_NIF_TERM terms[], int count) {
+    size_t total = 0;
+
+    for (int i = 0; i < count; i++) {
+        ErlNifBinary binary;
+        if (enif_inspect_binary(env, terms[i], &binary)) {
+            total += binary.size;
+        }
+    }
+
+    return total;
+}
+
+static void record(ErlNifEnv *env,
+                   stat_id_t id,
+                   ErlNifTime started,
+                   int argc,
+                   const ERL_NIF_TERM argv[],
+                   ERL_NIF_TERM result) {
+    ErlNifTime elapsed = enif_monotonic_time(ERL_NIF_NSEC) - started;
+    nif_stats_t* stats = thread_stats(id);
+
+    bool failed = enif_has_pending_exception(env, NULL);
+    size_t bytes_out = 0;
+
+    int arity;
+    const ERL_NIF_TERM* tuple;
+    if (!failed && enif_get_tuple(env, result, &arity, &tuple) && arity > 0) {
+        if (enif_is_identical(tuple[0], atom_error)) {
+            failed = true;
+        } else if (enif_is_identical(tuple[0], atom_ok)) {
+            bytes_out = terms_size(env, tuple + 1, arity - 1);
+        }
+    }
+
+    atomic_fetch_add_explicit(&stats->calls, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&stats->bytes_in, terms_size(env, argv, argc), memory_order_relaxed);
+    atomic_fetch_add_explicit(&stats->bytes_out, bytes_out, memory_order_relaxed);
+    atomic_fetch_add_explicit(&stats->latency[latency_bucket(elapsed)], 1, memory_order_relaxed);
+
+    if (failed) {
+        atomic_fetch_add_explicit(&stats->errors, 1, memory_order_relaxed);
+    }
+
+    if (ERL_NIF_THR_DIRTY_CPU_SCHEDULER == enif_thread_type()) {
+        atomic_fetch_add_explicit(&stats->dirty, 1, memory_order_relaxed);
+    }
+}
+
+static ERL_NIF_TERM run_instrumented(ErlNifEnv *env,
+                                     stat_id_t id,
+                                     nif_function_t function,
+                                     nif_function_t wrapper,
+                                     int argc,
+                                     const ERL_NIF_TERM argv[]) {
+    running_nif_t outer = running;
+    running.wrapper     = wrapper;
+    running.rescheduled = false;
+
+    ErlNifTime started  = enif_monotonic_time(ERL_NIF_NSEC);
+    ERL_NIF_TERM result = function(env, argc, argv);
+
+    // A rescheduled call is recorded when its wrapper completes on the dirty scheduler
+    bool rescheduled = running.rescheduled;
+    running          = outer;
+
+    if (!rescheduled) {
+        record(env, id, started, argc, argv, result);
+    }
+
+    return result;
+}
+
+#define DEFINE_INSTRUMENTED_NIF(name)                                                          \
+    ERL_NIF_TERM name##_instrumented(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]) {    \
+        return run_instrumented(env, STAT_##name, name, name##_instrumented, argc, argv);       \
+    }
+
+INSTRUMENTED_NIFS(DEFINE_INSTRUMENTED_NIF)
+
+static ERL_NIF_TERM make_nif_stats(ErlNifEnv *env, stat_id_t id) {
+    uint64_t calls = 0, errors = 0, dirty = 0, bytes_in = 0, bytes_out = 0;
+    uint64_t latency[STATS_LATENCY_BUCKETS] = {0};
+
+    for (int s = 0; s < STATS_SHARDS; s++) {
+        nif_stats_t* stats = &shards[s].nifs[id];
+
+        calls     += atomic_load_explicit(&stats->calls, memory_order_relaxed);
+        errors    += atomic_load_explicit(&stats->errors, memory_order_relaxed);
+        dirty     += atomic_load_explicit(&stats->dirty, memory_order_relaxed);
+        bytes_in  += atomic_load_explicit(&stats->bytes_in, memory_order_relaxed);
+        bytes_out += atomic_load_explicit(&stats->bytes_out, memory_order_relaxed);
+
+        for (int b = 0; b < STATS_LATENCY_BUCKETS; b++) {
+            latency[b] += atomic_load_explicit(&stats->latency[b], memory_order_relaxed);
+        }
+    }
+
+    ERL_NIF_TERM buckets[STATS_LATENCY_BUCKETS];
+    for (int b = 0; b < STATS_LATENCY_BUCKETS; b++) {
+        buckets[b] = enif_make_uint64(env, latency[b]);
+    }
+
+    ERL_NIF_TERM keys[] = {
+        enif_make_atom(env, "calls"),
+        enif_make_atom(env, "errors"),
+        enif_make_atom(env, "dirty"),
+        enif_make_atom(env, "bytes_in"),
+        enif_make_atom(env, "bytes_out"),
+        enif_make_atom(env, "latency"),
+    };
+    ERL_NIF_TERM values[] = {
+        enif_make_uint64(env, calls),
+        enif_make_uint64(env, errors),
+        enif_make_uint64(env, dirty),
+        enif_make_uint64(env, bytes_in),
+        enif_make_uint64(env, bytes_out),
+        enif_make_list_from_array(env, buckets, STATS_LATENCY_BUCKETS),
+    };
+
+    ERL_NIF_TERM map;
+    enif_make_map_from_arrays(env, keys, values, sizeof(keys) / sizeof(keys[0]), &map);
+    return map;
+}
+
+ERL_NIF_TERM stats(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]) {
+    if (0 != argc) {
+        return enif_make_badarg(env);
+    }
+
+    uint64_t vaults;
+    uint64_t secrets;
+
+    ockam_vault_extern_error_t error = ockam_vault_live_handles(&vaults, &secrets);
+    if (extern_error_has_error(&error)) {
+        return extern_error_tuple(env, &error);
+    }
+
+    ERL_NIF_TERM nif_names[STATS_COUNT];
+    ERL_NIF_TERM nif_stats[STATS_COUNT];
+    for (int id = 0; id < STATS_COUNT; id++) {
+        nif_names[id] = enif_make_atom(env, STAT_NAMES[id]);
+        nif_stats[id] = make_nif_stats(env, (stat_id_t) id);
+    }
+
+    ERL_NIF_TERM nifs;
+    enif_make_map_from_arrays(env, nif_names, nif_stats, STATS_COUNT, &nifs);
+
+    ERL_NIF_TERM keys[] = {
+        enif_make_atom(env, "nifs"),
+        enif_make_atom(env, "vaults"),
+        enif_make_atom(env, "secrets"),
+    };
+    ERL_NIF_TERM values[] = {
+        nifs,
+        enif_make_uint64(env, vaults),
+        enif_make_uint64(env, secrets),
+    };
+
+    ERL_NIF_TERM map;
+    enif_make_map_from_arrays(env, keys, values, sizeof(keys) / sizeof(keys[0]), &map);
+    return ok(env, map);
+}
@@ -0,0 +1,70 @@
+#ifndef OCKAM_ELIXIR_STATS_H
+#define OCKAM_ELIXIR_STATS_H
+
+#include "erl_nif.h"
+#include "common.h"
+
+// Number of latency buckets, bucket `i` counts the calls which took less than 2^i ns
+// and at least 2^(i - 1) ns. The last one also counts everything slower.
+#define STATS_LATENCY_BUCKETS 32
+
+// NIFs whose calls are counted and timed. `X(name)` must name the C function of the NIF.
+#define INSTRUMENTED_NIFS(X)                    \
+    X(default_init)                             \
+    X(deinit)                                   \
+    X(sha256)                                   \
+    X(sha256_many)                              \
+    X(sha256_init)                              \
+    X(sha256_update)                            \
+    X(sha256_final)                             \
+    X(sha256_clone)                             \
+    X(secret_generate)                          \
+    X(secret_generate_async)                    \
+    X(secret_import)                            \
+    X(secret_export)                            \
+    X(secret_publickey_get)                     \
+    X(secret_attributes_get)                    \
+    X(secret_destroy)                           \
+    X(ecdh)                                     \
+    X(ecdh_batch)                               \
+    X(ecdh_async)                               \
+    X(hkdf_sha256)                              \
+    X(ecdh_hkdf_sha256)                         \
+    X(aead_aes_gcm_encrypt)                     \
+    X(aead_aes_gcm_encrypt_async)               \
+    X(aead_aes_gcm_encrypt_framed)              \
+    X(aead_aes_gcm_encrypt_batch)               \
+    X(aead_aes_gcm_encrypt_and_hash)            \
+    X(aead_aes_gcm_decrypt_and_hash)            \
+    X(aead_aes_gcm_rekey)                       \
+    X(aead_aes_gcm_decrypt)                     \
+    X(aead_aes_gcm_decrypt_async)               \
+    X(aead_chacha20_poly1305_encrypt)           \
+    X(aead_chacha20_poly1305_decrypt)           \
+    X(aead_aes_gcm_encryptor_new)               \
+    X(aead_chacha20_poly1305_encryptor_new)     \
+    X(aead_aes_gcm_encryptor_encrypt)           \
+    X(aead_aes_gcm_encryptor_encrypt_batch)     \
+    X(aead_aes_gcm_decryptor_new)               \
+    X(aead_chacha20_poly1305_decryptor_new)     \
+    X(aead_aes_gcm_decryptor_decrypt)           \
+    X(aead_aes_gcm_stream_init)                 \
+    X(aead_aes_gcm_stream_update)               \
+    X(aead_aes_gcm_stream_finalize)
+
+// `name##_instrumented` wraps the NIF `name`, it's the function registered in the NIF table
+#define DECLARE_INSTRUMENTED_NIF(name) \
+    ERL_NIF_TERM name##_instrumented(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]);
+
+INSTRUMENTED_NIFS(DECLARE_INSTRUMENTED_NIF)
+
+int stats_load(ErlNifEnv *env);
+
+// The function to reschedule on a dirty scheduler in place of `function`. When an
+// instrumented NIF is running, that's its wrapper, so the call is recorded once it
+// completes on the dirty scheduler rather than when it's rescheduled.
+nif_function_t stats_dirty_function(nif_function_t function);
+
+ERL_NIF_TERM stats(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]);
+
+#endif //OCKAM_ELIXIR_STATS_H
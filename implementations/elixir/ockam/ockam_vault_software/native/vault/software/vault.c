@@ -9,6 +9,9 @@ static const size_t MAX_PUBLICKEY_SIZE       = 65;
 static const size_t MAX_DERIVED_OUTPUT_COUNT = 2;
 static const size_t MAX_PERSISTENCE_ID_SIZE  = 64;
 
+// Batches of at least this many ECDH run on a dirty scheduler, each one takes tens of µs
+static const unsigned int ECDH_BATCH_DIRTY_COUNT = 8;
+
 static const char* SECRET_TYPE_KEY        = "type";
 static const char* SECRET_TYPE_BUFFER     = "buffer";
 static const char* SECRET_TYPE_AES        = "aes";
@@ -21,7 +24,7 @@ static const char* SECRET_PERSISTENCE_PERSISTENT = "persistent";
 
 static const char* SECRET_LENGTH_KEY = "length";
 
-static int parse_secret_attributes(ErlNifEnv *env, ERL_NIF_TERM arg, ockam_vault_secret_attributes_t* attributes) {
+int parse_secret_attributes(ErlNifEnv *env, ERL_NIF_TERM arg, ockam_vault_secret_attributes_t* attributes) {
     size_t num_keys;
     if (0 == enif_get_map_size(env, arg, &num_keys)) {
         return -1;
@@ -138,27 +141,164 @@ static ERL_NIF_TERM create_term_from_secret_attributes(ErlNifEnv *env, const ock
     return ok(env, map);
 }
 
+static int parse_derived_outputs_attributes(ErlNifEnv *env,
+                                            ERL_NIF_TERM list,
+                                            ockam_vault_secret_attributes_t* attributes,
+                                            unsigned int* count) {
+    if (0 == enif_get_list_length(env, list, count)) {
+        return -1;
+    }
+
+    if (*count > MAX_DERIVED_OUTPUT_COUNT) {
+        return -1;
+    }
+
+    ERL_NIF_TERM current_list = list;
+    ERL_NIF_TERM head;
+    ERL_NIF_TERM tail;
+
+    for (unsigned int j = 0; j < *count; j++) {
+        if (0 == enif_get_list_cell(env, current_list, &head, &tail)) {
+            return -1;
+        }
+        current_list = tail;
+        if (0 != parse_secret_attributes(env, head, attributes + j)) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+static ERL_NIF_TERM make_derived_outputs_list(ErlNifEnv *env, const ockam_vault_secret_t* outputs, unsigned int count) {
+    ERL_NIF_TERM output_array[MAX_DERIVED_OUTPUT_COUNT];
+    for (size_t j = 0; j < count; j++) {
+        output_array[j] = enif_make_uint64(env, outputs[j]);
+    }
+
+    return enif_make_list_from_array(env, output_array, count);
+}
+
 ERL_NIF_TERM default_init(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]) {
-    if (0 != argc) {
+    if (0 != argc && 1 != argc) {
         return enif_make_badarg(env);
     }
 
     ockam_vault_t vault;
+    ockam_vault_extern_error_t error;
 
-    ockam_vault_extern_error_t error = ockam_vault_default_init(&vault);
-    if (extern_error_check_and_free_error(&error)) {
+    if (1 == argc) {
+        unsigned int affinity;
+        if (0 == enif_get_uint(env, argv[0], &affinity)) {
+            return enif_make_badarg(env);
+        }
+
+        error = ockam_vault_default_init_with_affinity(&vault, affinity);
+    } else {
+        error = ockam_vault_default_init(&vault);
+    }
+    if (extern_error_has_error(&error)) {
+        return extern_error_tuple(env, &error);
+    }
+
+    ERL_NIF_TERM vault_handle;
+    if (0 != make_vault_resource(env, vault, &vault_handle)) {
+        error = ockam_vault_deinit(vault);
+        extern_error_check_and_free_error(&error);
         return error_tuple(env, "failed to create vault connection");
     }
 
-    ERL_NIF_TERM handle = enif_make_uint64(env, vault.handle);
-    ERL_NIF_TERM vault_type = enif_make_uint64(env, vault.vault_type);
+    return ok(env, vault_handle);
+}
 
-    ERL_NIF_TERM vault_handle = enif_make_list2(env, handle, vault_type);
+ERL_NIF_TERM set_dirty_threshold(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]) {
+    if (1 != argc) {
+        return enif_make_badarg(env);
+    }
 
-    return ok(env, vault_handle);
+    ErlNifUInt64 threshold;
+    if (0 == enif_get_uint64(env, argv[0], &threshold)) {
+        return enif_make_badarg(env);
+    }
+
+    atomic_store_explicit(&dirty_threshold, threshold, memory_order_relaxed);
+
+    return ok_void(env);
 }
 
-ERL_NIF_TERM sha256(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]) {
+ERL_NIF_TERM set_async_runtime(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]) {
+    if (1 != argc) {
+        return enif_make_badarg(env);
+    }
+
+    bool enabled;
+    if (enif_is_identical(argv[0], enif_make_atom(env, "true"))) {
+        enabled = true;
+    } else if (enif_is_identical(argv[0], enif_make_atom(env, "false"))) {
+        enabled = false;
+    } else {
+        return enif_make_badarg(env);
+    }
+
+    ockam_vault_extern_error_t error = ockam_vault_set_async_runtime(enabled);
+    if (extern_error_has_error(&error)) {
+        return extern_error_tuple(env, &error);
+    }
+
+    return ok_void(env);
+}
+
+ERL_NIF_TERM backend_info(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]) {
+    if (0 != argc) {
+        return enif_make_badarg(env);
+    }
+
+    ockam_vault_backend_info_t info;
+    ockam_vault_extern_error_t error = ockam_vault_backend_info(&info);
+    if (extern_error_has_error(&error)) {
+        return extern_error_tuple(env, &error);
+    }
+
+    ERL_NIF_TERM keys[] = {
+        enif_make_atom(env, "aes"),
+        enif_make_atom(env, "ghash"),
+        enif_make_atom(env, "sha256"),
+    };
+    ERL_NIF_TERM values[] = {
+        enif_make_atom(env, info.aes),
+        enif_make_atom(env, info.ghash),
+        enif_make_atom(env, info.sha256),
+    };
+
+    ERL_NIF_TERM map;
+    enif_make_map_from_arrays(env, keys, values, sizeof(keys) / sizeof(keys[0]), &map);
+    return ok(env, map);
+}
+
+ERL_NIF_TERM set_keypair_pool_watermark(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]) {
+    if (2 != argc) {
+        return enif_make_badarg(env);
+    }
+
+    ockam_vault_t vault;
+    if (0 != parse_vault_handle(env, argv[0], &vault)) {
+        return enif_make_badarg(env);
+    }
+
+    unsigned int watermark;
+    if (0 == enif_get_uint(env, argv[1], &watermark)) {
+        return enif_make_badarg(env);
+    }
+
+    ockam_vault_extern_error_t error = ockam_vault_set_keypair_pool_watermark(vault, watermark);
+    if (extern_error_has_error(&error)) {
+        return extern_error_tuple(env, &error);
+    }
+
+    return ok_void(env);
+}
+
+static ERL_NIF_TERM sha256_run(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]) {
     if (2 != argc) {
         return enif_make_badarg(env);
     }
@@ -169,7 +309,7 @@ ERL_NIF_TERM sha256(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]) {
     }
 
     ErlNifBinary input;
-    if (0 == enif_inspect_binary(env, argv[1], &input)) {
+    if (0 != inspect_iodata_as_binary(env, argv[1], &input)) {
         return enif_make_badarg(env);
     }
 
@@ -180,16 +320,105 @@ ERL_NIF_TERM sha256(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]) {
         return error_tuple(env, "failed to create buffer for hash");
     }
 
-    memset(digest, 0, 32);
-
     ockam_vault_extern_error_t error = ockam_vault_sha256(vault, input.data, input.size, digest);
-    if (extern_error_check_and_free_error(&error)) {
-        return error_tuple(env,  "failed to compute sha256 digest");
+    if (extern_error_has_error(&error)) {
+        return extern_error_tuple(env, &error);
     }
 
     return ok(env, term);
 }
 
+ERL_NIF_TERM sha256(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]) {
+    if (2 != argc) {
+        return enif_make_badarg(env);
+    }
+
+    return schedule_by_size(env, "sha256", sha256_run, argv[1], argc, argv);
+}
+
+static int parse_sha256_inputs(ErlNifEnv *env, ERL_NIF_TERM list, unsigned int count, ockam_vault_buffer_t* inputs) {
+    ERL_NIF_TERM current_list = list;
+    ERL_NIF_TERM head;
+    ERL_NIF_TERM tail;
+
+    for (unsigned int i = 0; i < count; i++) {
+        ErlNifBinary input;
+
+        if (0 == enif_get_list_cell(env, current_list, &head, &tail)
+            || 0 != inspect_iodata_as_binary(env, head, &input)
+            || input.size > UINT32_MAX) {
+            return -1;
+        }
+        current_list = tail;
+
+        inputs[i].data   = input.data;
+        inputs[i].length = input.size;
+    }
+
+    return 0;
+}
+
+static ERL_NIF_TERM sha256_many_run(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]) {
+    if (2 != argc) {
+        return enif_make_badarg(env);
+    }
+
+    ockam_vault_t vault;
+    if (0 != parse_vault_handle(env, argv[0], &vault)) {
+        return enif_make_badarg(env);
+    }
+
+    unsigned int count;
+    if (0 == enif_get_list_length(env, argv[1], &count)) {
+        return enif_make_badarg(env);
+    }
+
+    if (0 == count) {
+        return ok(env, enif_make_list(env, 0));
+    }
+
+    ockam_vault_buffer_t* inputs = enif_alloc(count * sizeof(ockam_vault_buffer_t));
+    if (NULL == inputs) {
+        return error_tuple(env, "failed to create buffer for sha256_many");
+    }
+
+    if (0 != parse_sha256_inputs(env, argv[1], count, inputs)) {
+        enif_free(inputs);
+        return enif_make_badarg(env);
+    }
+
+    // All digests share a single binary, each one is returned as a sub binary of it
+    ERL_NIF_TERM term;
+    uint8_t* digests = enif_make_new_binary(env, 32 * (size_t) count, &term);
+
+    if (NULL == digests) {
+        enif_free(inputs);
+        return error_tuple(env, "failed to create buffer for sha256_many");
+    }
+
+    ockam_vault_extern_error_t error = ockam_vault_sha256_many(vault, inputs, count, digests);
+    enif_free(inputs);
+
+    if (extern_error_has_error(&error)) {
+        return extern_error_tuple(env, &error);
+    }
+
+    ERL_NIF_TERM list = enif_make_list(env, 0);
+    for (unsigned int i = count; i > 0; i--) {
+        list = enif_make_list_cell(env, enif_make_sub_binary(env, term, 32 * (size_t) (i - 1), 32), list);
+    }
+
+    return ok(env, list);
+}
+
+ERL_NIF_TERM sha256_many(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]) {
+    if (2 != argc) {
+        return enif_make_badarg(env);
+    }
+
+    return schedule_by_size(env, "sha256_many", sha256_many_run, argv[1], argc, argv);
+}
+
 ERL_NIF_TERM secret_generate(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]) {
     if (2 != argc) {
         return enif_make_badarg(env);
@@ -207,8 +436,8 @@ ERL_NIF_TERM secret_generate(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]
 
     ockam_vault_secret_t secret;
     ockam_vault_extern_error_t error = ockam_vault_secret_generate(vault, &secret, attributes);
-    if (extern_error_check_and_free_error(&error)) {
-        return error_tuple(env, "unable to generate the secret");
+    if (extern_error_has_error(&error)) {
+        return extern_error_tuple(env, &error);
     }
 
     ERL_NIF_TERM secret_handle = enif_make_uint64(env, secret);
@@ -238,8 +467,8 @@ ERL_NIF_TERM secret_import(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
 
     ockam_vault_secret_t secret;
     ockam_vault_extern_error_t error = ockam_vault_secret_import(vault, &secret, attributes, input.data, input.size);
-    if (extern_error_check_and_free_error(&error)) {
-        return error_tuple(env, "unable to import the secret");
+    if (extern_error_has_error(&error)) {
+        return extern_error_tuple(env, &error);
     }
 
     ERL_NIF_TERM secret_handle = enif_make_uint64(env, secret);
@@ -266,8 +495,8 @@ ERL_NIF_TERM secret_export(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
     uint32_t length = 0;
 
     ockam_vault_extern_error_t error = ockam_vault_secret_export(vault, secret_handle, buffer, MAX_SECRET_EXPORT_SIZE, &length);
-    if (extern_error_check_and_free_error(&error)) {
-        return error_tuple(env, "failed to ockam_vault_secret_export");
+    if (extern_error_has_error(&error)) {
+        return extern_error_tuple(env, &error);
     }
 
     ERL_NIF_TERM output;
@@ -300,8 +529,8 @@ ERL_NIF_TERM secret_publickey_get(ErlNifEnv *env, int argc, const ERL_NIF_TERM a
     uint32_t length = 0;
 
     ockam_vault_extern_error_t error = ockam_vault_secret_publickey_get(vault, secret_handle, buffer, MAX_SECRET_EXPORT_SIZE, &length);
-    if (extern_error_check_and_free_error(&error)) {
-        return error_tuple(env, "failed to ockam_vault_secret_publickey_get");
+    if (extern_error_has_error(&error)) {
+        return extern_error_tuple(env, &error);
     }
 
     ERL_NIF_TERM output;
@@ -332,8 +561,8 @@ ERL_NIF_TERM secret_attributes_get(ErlNifEnv *env, int argc, const ERL_NIF_TERM
 
     ockam_vault_secret_attributes_t attributes;
     ockam_vault_extern_error_t error = ockam_vault_secret_attributes_get(vault, secret_handle, &attributes);
-    if (extern_error_check_and_free_error(&error)) {
-        return error_tuple(env, "failed to secret_attributes_get");
+    if (extern_error_has_error(&error)) {
+        return extern_error_tuple(env, &error);
     }
 
     return create_term_from_secret_attributes(env, &attributes);
@@ -355,8 +584,8 @@ ERL_NIF_TERM secret_destroy(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[])
     }
 
     ockam_vault_extern_error_t error = ockam_vault_secret_destroy(vault, secret_handle);
-    if (extern_error_check_and_free_error(&error)) {
-        return error_tuple(env, "failed to secret_destroy");
+    if (extern_error_has_error(&error)) {
+        return extern_error_tuple(env, &error);
     }
 
     return ok_void(env);
@@ -384,8 +613,8 @@ ERL_NIF_TERM ecdh(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]) {
 
     ockam_vault_secret_t shared_secret;
     ockam_vault_extern_error_t error = ockam_vault_ecdh(vault, secret_handle, input.data,  input.size, &shared_secret);
-    if (extern_error_check_and_free_error(&error)) {
-        return error_tuple(env, "failed to ecdh");
+    if (extern_error_has_error(&error)) {
+        return extern_error_tuple(env, &error);
     }
 
     ERL_NIF_TERM shared_secret_term = enif_make_uint64(env, shared_secret);
@@ -393,6 +622,122 @@ ERL_NIF_TERM ecdh(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]) {
     return ok(env, shared_secret_term);
 }
 
+static int parse_ecdh_requests(ErlNifEnv *env,
+                               ERL_NIF_TERM list,
+                               unsigned int count,
+                               ockam_vault_ecdh_request_t* requests) {
+    ERL_NIF_TERM current_list = list;
+    ERL_NIF_TERM head;
+    ERL_NIF_TERM tail;
+
+    for (unsigned int i = 0; i < count; i++) {
+        if (0 == enif_get_list_cell(env, current_list, &head, &tail)) {
+            return -1;
+        }
+
+        int arity;
+        const ERL_NIF_TERM* request;
+        if (0 == enif_get_tuple(env, head, &arity, &request) || 2 != arity) {
+            return -1;
+        }
+
+        ErlNifUInt64 secret_handle;
+        if (0 == enif_get_uint64(env, request[0], &secret_handle)) {
+            return -1;
+        }
+
+        ErlNifBinary peer_publickey;
+        if (0 == enif_inspect_binary(env, request[1], &peer_publickey) || 0 == peer_publickey.size) {
+            return -1;
+        }
+
+        requests[i].privatekey            = secret_handle;
+        requests[i].peer_publickey        = peer_publickey.data;
+        requests[i].peer_publickey_length = peer_publickey.size;
+
+        current_list = tail;
+    }
+
+    return 0;
+}
+
+static ERL_NIF_TERM run_ecdh_batch(ErlNifEnv *env,
+                                   ockam_vault_t vault,
+                                   const ockam_vault_ecdh_request_t* requests,
+                                   unsigned int count) {
+    ockam_vault_secret_t* shared_secrets = enif_alloc(count * sizeof(ockam_vault_secret_t));
+    int32_t* errors                      = enif_alloc(count * sizeof(int32_t));
+    ERL_NIF_TERM* results                = enif_alloc(count * sizeof(ERL_NIF_TERM));
+
+    ERL_NIF_TERM result;
+
+    if (NULL == shared_secrets || NULL == errors || NULL == results) {
+        result = error_tuple(env, "failed to create buffer for ecdh_batch");
+    } else {
+        ockam_vault_extern_error_t error = ockam_vault_ecdh_batch(vault, requests, count, shared_secrets, errors);
+
+        if (extern_error_has_error(&error)) {
+            result = extern_error_tuple(env, &error);
+        } else {
+            for (unsigned int i = 0; i < count; i++) {
+                if (0 == errors[i]) {
+                    results[i] = ok(env, enif_make_uint64(env, shared_secrets[i]));
+                } else {
+                    results[i] = error_code_tuple(env, errors[i]);
+                }
+            }
+
+            result = ok(env, enif_make_list_from_array(env, results, count));
+        }
+    }
+
+    enif_free(shared_secrets);
+    enif_free(errors);
+    enif_free(results);
+
+    return result;
+}
+
+ERL_NIF_TERM ecdh_batch(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]) {
+    if (2 != argc) {
+        return enif_make_badarg(env);
+    }
+
+    ockam_vault_t vault;
+    if (0 != parse_vault_handle(env, argv[0], &vault)) {
+        return enif_make_badarg(env);
+    }
+
+    unsigned int count;
+    if (0 == enif_get_list_length(env, argv[1], &count)) {
+        return enif_make_badarg(env);
+    }
+
+    if (0 == count) {
+        return ok(env, enif_make_list(env, 0));
+    }
+
+    if (count >= ECDH_BATCH_DIRTY_COUNT && ERL_NIF_THR_NORMAL_SCHEDULER == enif_thread_type()) {
+        return schedule_dirty(env, "ecdh_batch", ecdh_batch, argc, argv);
+    }
+
+    ockam_vault_ecdh_request_t* requests = enif_alloc(count * sizeof(ockam_vault_ecdh_request_t));
+    if (NULL == requests) {
+        return error_tuple(env, "failed to create buffer for ecdh_batch");
+    }
+
+    if (0 != parse_ecdh_requests(env, argv[1], count, requests)) {
+        enif_free(requests);
+        return enif_make_badarg(env);
+    }
+
+    ERL_NIF_TERM result = run_ecdh_batch(env, vault, requests, count);
+
+    enif_free(requests);
+
+    return result;
+}
+
 ERL_NIF_TERM hkdf_sha256(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]) {
     if (4 != argc && 3 != argc) {
         return enif_make_badarg(env);
@@ -422,45 +767,109 @@ ERL_NIF_TERM hkdf_sha256(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]) {
     }
 
     unsigned int derived_outputs_count;
-    if (0 == enif_get_list_length(env, argv[i], &derived_outputs_count)) {
+    ockam_vault_secret_attributes_t attributes[MAX_DERIVED_OUTPUT_COUNT];
+    if (0 != parse_derived_outputs_attributes(env, argv[i], attributes, &derived_outputs_count)) {
         return enif_make_badarg(env);
     }
 
-    if (derived_outputs_count > MAX_DERIVED_OUTPUT_COUNT) {
+    ockam_vault_secret_t shared_secrets[MAX_DERIVED_OUTPUT_COUNT];
+    ockam_vault_extern_error_t error = ockam_vault_hkdf_sha256(vault, salt_handle, ikm_handle_ptr, attributes, derived_outputs_count, shared_secrets);
+    if (extern_error_has_error(&error)) {
+        return extern_error_tuple(env, &error);
+    }
+
+    return ok(env, make_derived_outputs_list(env, shared_secrets, derived_outputs_count));
+}
+
+ERL_NIF_TERM ecdh_hkdf_sha256(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]) {
+    if (5 != argc) {
         return enif_make_badarg(env);
     }
 
-    ockam_vault_secret_attributes_t attributes[MAX_DERIVED_OUTPUT_COUNT];
-    ockam_vault_secret_attributes_t* attr = attributes;
+    ockam_vault_t vault;
+    if (0 != parse_vault_handle(env, argv[0], &vault)) {
+        return enif_make_badarg(env);
+    }
 
-    ERL_NIF_TERM current_list = argv[i];
-    ERL_NIF_TERM head;
-    ERL_NIF_TERM tail;
+    ErlNifUInt64 secret_handle;
+    if (0 == enif_get_uint64(env, argv[1], &secret_handle)) {
+        return enif_make_badarg(env);
+    }
 
-    for (unsigned int j = 0; j < derived_outputs_count; j++, attr++) {
-        if (0 == enif_get_list_cell(env, current_list, &head, &tail)) {
-            return enif_make_badarg(env);
-        }
-        current_list = tail;
-        if (0 != parse_secret_attributes(env, head, attr)) {
-            return enif_make_badarg(env);
-        }
+    ErlNifBinary peer_publickey;
+    if (0 == enif_inspect_binary(env, argv[2], &peer_publickey)) {
+        return enif_make_badarg(env);
+    }
+
+    ErlNifUInt64 salt_handle;
+    if (0 == enif_get_uint64(env, argv[3], &salt_handle)) {
+        return enif_make_badarg(env);
+    }
+
+    unsigned int derived_outputs_count;
+    ockam_vault_secret_attributes_t attributes[MAX_DERIVED_OUTPUT_COUNT];
+    if (0 != parse_derived_outputs_attributes(env, argv[4], attributes, &derived_outputs_count)) {
+        return enif_make_badarg(env);
     }
 
     ockam_vault_secret_t shared_secrets[MAX_DERIVED_OUTPUT_COUNT];
-    ockam_vault_extern_error_t error = ockam_vault_hkdf_sha256(vault, salt_handle, ikm_handle_ptr, attributes, derived_outputs_count, shared_secrets);
-    if (extern_error_check_and_free_error(&error)) {
-        return error_tuple(env, "failed to hkdf_sha256");
+    ockam_vault_extern_error_t error = ockam_vault_ecdh_hkdf_sha256(vault,
+                                                                    secret_handle,
+                                                                    peer_publickey.data,
+                                                                    peer_publickey.size,
+                                                                    salt_handle,
+                                                                    attributes,
+                                                                    derived_outputs_count,
+                                                                    shared_secrets);
+    if (extern_error_has_error(&error)) {
+        return extern_error_tuple(env, &error);
+    }
+
+    return ok(env, make_derived_outputs_list(env, shared_secrets, derived_outputs_count));
+}
+
+static ERL_NIF_TERM aead_encrypt_with(ErlNifEnv *env,
+                                      int argc,
+                                      const ERL_NIF_TERM argv[],
+                                      aead_cipher_t cipher,
+                                      bool framed) {
+    if (5 != argc) {
+        return enif_make_badarg(env);
     }
 
-    ERL_NIF_TERM output_array[MAX_DERIVED_OUTPUT_COUNT];
-    for (size_t j = 0; j < derived_outputs_count; j++) {
-        output_array[j] = enif_make_uint64(env, shared_secrets[j]);
+    ockam_vault_t vault;
+    if (0 != parse_vault_handle(env, argv[0], &vault)) {
+        return enif_make_badarg(env);
     }
 
-    ERL_NIF_TERM output = enif_make_list_from_array(env, output_array, derived_outputs_count);
+    ErlNifUInt64 key_handle;
+    if (0 == enif_get_uint64(env, argv[1], &key_handle)) {
+        return enif_make_badarg(env);
+    }
 
-    return ok(env, output);
+    ErlNifUInt64 nonce;
+    if (0 == enif_get_uint64(env, argv[2], &nonce)) {
+        return enif_make_badarg(env);
+    }
+
+    ErlNifBinary ad;
+    if (0 != inspect_iodata_as_binary(env, argv[3], &ad)) {
+        return enif_make_badarg(env);
+    }
+
+    iodata_t plain_text;
+    if (0 != inspect_iodata(env, argv[4], &plain_text)) {
+        return enif_make_badarg(env);
+    }
+
+    ERL_NIF_TERM result;
+    aead_encrypt_iodata(env, vault, cipher, key_handle, nonce, &ad, &plain_text, framed, &result);
+
+    return result;
+}
+
+static ERL_NIF_TERM aead_aes_gcm_encrypt_run(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]) {
+    return aead_encrypt_with(env, argc, argv, AEAD_AES_GCM, false);
 }
 
 ERL_NIF_TERM aead_aes_gcm_encrypt(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]) {
@@ -468,6 +877,113 @@ ERL_NIF_TERM aead_aes_gcm_encrypt(ErlNifEnv *env, int argc, const ERL_NIF_TERM a
         return enif_make_badarg(env);
     }
 
+    return schedule_by_size(env, "aead_aes_gcm_encrypt", aead_aes_gcm_encrypt_run, argv[4], argc, argv);
+}
+
+static ERL_NIF_TERM aead_aes_gcm_encrypt_framed_run(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]) {
+    return aead_encrypt_with(env, argc, argv, AEAD_AES_GCM, true);
+}
+
+ERL_NIF_TERM aead_aes_gcm_encrypt_framed(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]) {
+    if (5 != argc) {
+        return enif_make_badarg(env);
+    }
+
+    return schedule_by_size(env, "aead_aes_gcm_encrypt_framed", aead_aes_gcm_encrypt_framed_run, argv[4], argc, argv);
+}
+
+ERL_NIF_TERM aead_aes_gcm_encrypt_batch(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]) {
+    if (4 != argc) {
+        return enif_make_badarg(env);
+    }
+
+    ockam_vault_t vault;
+    if (0 != parse_vault_handle(env, argv[0], &vault)) {
+        return enif_make_badarg(env);
+    }
+
+    ErlNifUInt64 key_handle;
+    if (0 == enif_get_uint64(env, argv[1], &key_handle)) {
+        return enif_make_badarg(env);
+    }
+
+    ErlNifUInt64 start_nonce;
+    if (0 == enif_get_uint64(env, argv[2], &start_nonce)) {
+        return enif_make_badarg(env);
+    }
+
+    unsigned int count;
+    if (0 == enif_get_list_length(env, argv[3], &count)) {
+        return enif_make_badarg(env);
+    }
+
+    if (0 == count) {
+        return ok(env, enif_make_list(env, 0));
+    }
+
+    ockam_vault_aead_message_t* messages = enif_alloc(count * sizeof(ockam_vault_aead_message_t));
+    if (NULL == messages) {
+        return error_tuple(env, "failed to create buffer for aead_aes_gcm_encrypt_batch");
+    }
+
+    size_t size = 0;
+    if (0 != parse_aead_messages(env, argv[3], count, messages, &size)) {
+        enif_free(messages);
+        return enif_make_badarg(env);
+    }
+
+    if (size > UINT32_MAX) {
+        enif_free(messages);
+        return enif_make_badarg(env);
+    }
+
+    if (above_dirty_threshold(size) && ERL_NIF_THR_NORMAL_SCHEDULER == enif_thread_type()) {
+        enif_free(messages);
+        return schedule_dirty(env, "aead_aes_gcm_encrypt_batch", aead_aes_gcm_encrypt_batch, argc, argv);
+    }
+
+    ERL_NIF_TERM term;
+    uint8_t* output = enif_make_new_binary(env, size, &term);
+
+    if (NULL == output) {
+        enif_free(messages);
+        return error_tuple(env, "failed to create buffer for aead_aes_gcm_encrypt_batch");
+    }
+
+    uint32_t length = 0;
+
+    ockam_vault_extern_error_t error = ockam_vault_aead_aes_gcm_encrypt_batch(vault,
+                                                                              key_handle,
+                                                                              start_nonce,
+                                                                              messages,
+                                                                              count,
+                                                                              output,
+                                                                              size,
+                                                                              &length);
+    if (extern_error_has_error(&error)) {
+        enif_free(messages);
+        return extern_error_tuple(env, &error);
+    }
+
+    if (length != size) {
+        enif_free(messages);
+        return error_tuple(env, "buffer size is invalid during aead_aes_gcm_encrypt_batch");
+    }
+
+    ERL_NIF_TERM frames = make_frames_list(env, term, size, messages, count);
+
+    enif_free(messages);
+
+    return ok(env, frames);
+}
+
+static const size_t HANDSHAKE_HASH_SIZE = 32;
+
+static ERL_NIF_TERM aead_aes_gcm_encrypt_and_hash_run(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]) {
+    if (5 != argc) {
+        return enif_make_badarg(env);
+    }
+
     ockam_vault_t vault;
     if (0 != parse_vault_handle(env, argv[0], &vault)) {
         return enif_make_badarg(env);
@@ -483,51 +999,164 @@ ERL_NIF_TERM aead_aes_gcm_encrypt(ErlNifEnv *env, int argc, const ERL_NIF_TERM a
         return enif_make_badarg(env);
     }
 
-    ErlNifBinary ad;
-    if (0 == enif_inspect_binary(env, argv[3], &ad)) {
+    ErlNifBinary h;
+    if (0 == enif_inspect_binary(env, argv[3], &h) || HANDSHAKE_HASH_SIZE != h.size) {
         return enif_make_badarg(env);
     }
 
     ErlNifBinary plain_text;
-    if (0 == enif_inspect_binary(env, argv[4], &plain_text)) {
+    if (0 != inspect_iodata_as_binary(env, argv[4], &plain_text) || plain_text.size > UINT32_MAX - AEAD_TAG_SIZE) {
         return enif_make_badarg(env);
     }
 
-    ERL_NIF_TERM term;
-    // FIXME: Allocated size should be provided by the rust lib
-    size_t size = plain_text.size + 16;
-    uint8_t* cipher_text = enif_make_new_binary(env, size, &term);
+    ERL_NIF_TERM cipher_text_term;
+    size_t size = plain_text.size + AEAD_TAG_SIZE;
+    uint8_t* cipher_text = enif_make_new_binary(env, size, &cipher_text_term);
+
+    ERL_NIF_TERM new_h_term;
+    uint8_t* new_h = enif_make_new_binary(env, HANDSHAKE_HASH_SIZE, &new_h_term);
+
+    if (NULL == cipher_text || NULL == new_h) {
+        return error_tuple(env, "failed to create buffer for aead_aes_gcm_encrypt_and_hash");
+    }
+
+    uint32_t length = 0;
+
+    ockam_vault_extern_error_t error = ockam_vault_aead_aes_gcm_encrypt_and_hash(vault,
+                                                                                 key_handle,
+                                                                                 nonce,
+                                                                                 h.data,
+                                                                                 plain_text.data,
+                                                                                 plain_text.size,
+                                                                                 cipher_text,
+                                                                                 size,
+                                                                                 &length,
+                                                                                 new_h);
+    if (extern_error_has_error(&error)) {
+        return extern_error_tuple(env, &error);
+    }
+
+    if (length != size) {
+        return error_tuple(env, "buffer size is invalid during aead_aes_gcm_encrypt_and_hash");
+    }
+
+    return enif_make_tuple3(env, enif_make_atom(env, "ok"), cipher_text_term, new_h_term);
+}
+
+ERL_NIF_TERM aead_aes_gcm_encrypt_and_hash(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]) {
+    if (5 != argc) {
+        return enif_make_badarg(env);
+    }
+
+    return schedule_by_size(env, "aead_aes_gcm_encrypt_and_hash", aead_aes_gcm_encrypt_and_hash_run, argv[4], argc, argv);
+}
+
+static ERL_NIF_TERM aead_aes_gcm_decrypt_and_hash_run(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]) {
+    if (5 != argc) {
+        return enif_make_badarg(env);
+    }
+
+    ockam_vault_t vault;
+    if (0 != parse_vault_handle(env, argv[0], &vault)) {
+        return enif_make_badarg(env);
+    }
+
+    ErlNifUInt64 key_handle;
+    if (0 == enif_get_uint64(env, argv[1], &key_handle)) {
+        return enif_make_badarg(env);
+    }
 
-    if (NULL == cipher_text) {
-        return error_tuple(env, "failed to create buffer for aead_aes_gcm_encrypt");
+    ErlNifUInt64 nonce;
+    if (0 == enif_get_uint64(env, argv[2], &nonce)) {
+        return enif_make_badarg(env);
     }
 
-    memset(cipher_text, 0, size);
+    ErlNifBinary h;
+    if (0 == enif_inspect_binary(env, argv[3], &h) || HANDSHAKE_HASH_SIZE != h.size) {
+        return enif_make_badarg(env);
+    }
+
+    ErlNifBinary cipher_text;
+    if (0 != inspect_iodata_as_binary(env, argv[4], &cipher_text) || cipher_text.size < AEAD_TAG_SIZE) {
+        return enif_make_badarg(env);
+    }
+
+    ERL_NIF_TERM plain_text_term;
+    size_t size = cipher_text.size - AEAD_TAG_SIZE;
+    uint8_t* plain_text = enif_make_new_binary(env, size, &plain_text_term);
+
+    ERL_NIF_TERM new_h_term;
+    uint8_t* new_h = enif_make_new_binary(env, HANDSHAKE_HASH_SIZE, &new_h_term);
+
+    if (NULL == plain_text || NULL == new_h) {
+        return error_tuple(env, "failed to create buffer for aead_aes_gcm_decrypt_and_hash");
+    }
 
     uint32_t length = 0;
 
-    ockam_vault_extern_error_t error = ockam_vault_aead_aes_gcm_encrypt(vault,
-                                                                        key_handle,
-                                                                        nonce,
-                                                                        ad.data,
-                                                                        ad.size,
-                                                                        plain_text.data,
-                                                                        plain_text.size,
-                                                                        cipher_text,
-                                                                        size,
-                                                                        &length);
-    if (extern_error_check_and_free_error(&error)) {
-        return error_tuple(env, "failed to aead_aes_gcm_encrypt");
+    ockam_vault_extern_error_t error = ockam_vault_aead_aes_gcm_decrypt_and_hash(vault,
+                                                                                 key_handle,
+                                                                                 nonce,
+                                                                                 h.data,
+                                                                                 cipher_text.data,
+                                                                                 cipher_text.size,
+                                                                                 plain_text,
+                                                                                 size,
+                                                                                 &length,
+                                                                                 new_h);
+    if (extern_error_has_error(&error)) {
+        return extern_error_tuple(env, &error);
     }
 
     if (length != size) {
-        return error_tuple(env, "buffer size is invalid during aead_aes_gcm_encrypt");
+        return error_tuple(env, "buffer size is invalid during aead_aes_gcm_decrypt_and_hash");
     }
 
-    return ok(env, term);
+    return enif_make_tuple3(env, enif_make_atom(env, "ok"), plain_text_term, new_h_term);
 }
 
-ERL_NIF_TERM aead_aes_gcm_decrypt(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]) {
+ERL_NIF_TERM aead_aes_gcm_decrypt_and_hash(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]) {
+    if (5 != argc) {
+        return enif_make_badarg(env);
+    }
+
+    return schedule_by_size(env, "aead_aes_gcm_decrypt_and_hash", aead_aes_gcm_decrypt_and_hash_run, argv[4], argc, argv);
+}
+
+ERL_NIF_TERM aead_aes_gcm_rekey(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]) {
+    if (3 != argc) {
+        return enif_make_badarg(env);
+    }
+
+    ockam_vault_t vault;
+    if (0 != parse_vault_handle(env, argv[0], &vault)) {
+        return enif_make_badarg(env);
+    }
+
+    ErlNifUInt64 key_handle;
+    if (0 == enif_get_uint64(env, argv[1], &key_handle)) {
+        return enif_make_badarg(env);
+    }
+
+    bool destroy_old;
+    if (enif_is_identical(argv[2], enif_make_atom(env, "true"))) {
+        destroy_old = true;
+    } else if (enif_is_identical(argv[2], enif_make_atom(env, "false"))) {
+        destroy_old = false;
+    } else {
+        return enif_make_badarg(env);
+    }
+
+    ockam_vault_secret_t new_key;
+    ockam_vault_extern_error_t error = ockam_vault_aead_aes_gcm_rekey(vault, key_handle, destroy_old, &new_key);
+    if (extern_error_has_error(&error)) {
+        return extern_error_tuple(env, &error);
+    }
+
+    return ok(env, enif_make_uint64(env, new_key));
+}
+
+static ERL_NIF_TERM aead_decrypt_with(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[], aead_cipher_t cipher) {
     if (5 != argc) {
         return enif_make_badarg(env);
     }
@@ -548,67 +1177,107 @@ ERL_NIF_TERM aead_aes_gcm_decrypt(ErlNifEnv *env, int argc, const ERL_NIF_TERM a
     }
 
     ErlNifBinary ad;
-    if (0 == enif_inspect_binary(env, argv[3], &ad)) {
+    if (0 != inspect_iodata_as_binary(env, argv[3], &ad)) {
         return enif_make_badarg(env);
     }
 
     ErlNifBinary cipher_text;
-    if (0 == enif_inspect_binary(env, argv[4], &cipher_text)) {
+    if (0 != inspect_iodata_as_binary(env, argv[4], &cipher_text)) {
         return enif_make_badarg(env);
     }
 
-    if (cipher_text.size < 16) {
+    if (cipher_text.size < AEAD_TAG_SIZE) {
         return enif_make_badarg(env);
     }
 
     ERL_NIF_TERM term;
-    // FIXME: Allocated size should be provided by the rust lib
-    size_t size = cipher_text.size - 16;
+    size_t size = cipher_text.size - AEAD_TAG_SIZE;
     uint8_t* plain_text = enif_make_new_binary(env, size, &term);
 
     if (NULL == plain_text) {
         return error_tuple(env, "failed to create buffer for aead_aes_gcm_decrypt");
     }
 
-    memset(plain_text, 0, size);
-
     uint32_t length = 0;
 
-    ockam_vault_extern_error_t error = ockam_vault_aead_aes_gcm_decrypt(vault,
-                                                                        key_handle,
-                                                                        nonce,
-                                                                        ad.data,
-                                                                        ad.size,
-                                                                        cipher_text.data,
-                                                                        cipher_text.size,
-                                                                        plain_text,
-                                                                        size,
-                                                                        &length);
-    if (extern_error_check_and_free_error(&error)) {
-        return error_tuple(env, "failed to aead_aes_gcm_decrypt");
+    ockam_vault_extern_error_t error = aead_decrypt(cipher,
+                                                    vault,
+                                                    key_handle,
+                                                    nonce,
+                                                    ad.data,
+                                                    ad.size,
+                                                    cipher_text.data,
+                                                    cipher_text.size,
+                                                    plain_text,
+                                                    size,
+                                                    &length);
+    if (extern_error_has_error(&error)) {
+        return extern_error_tuple(env, &error);
     }
 
     if (length != size) {
-        return error_tuple(env, "buffer size is invalid during aead_aes_gcm_decrypt");
+        return error_tuple(env, "buffer size is invalid during aead_decrypt");
     }
 
     return ok(env, term);
 }
 
+static ERL_NIF_TERM aead_aes_gcm_decrypt_run(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]) {
+    return aead_decrypt_with(env, argc, argv, AEAD_AES_GCM);
+}
+
+ERL_NIF_TERM aead_aes_gcm_decrypt(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]) {
+    if (5 != argc) {
+        return enif_make_badarg(env);
+    }
+
+    return schedule_by_size(env, "aead_aes_gcm_decrypt", aead_aes_gcm_decrypt_run, argv[4], argc, argv);
+}
+
+static ERL_NIF_TERM aead_chacha20_poly1305_encrypt_run(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]) {
+    return aead_encrypt_with(env, argc, argv, AEAD_CHACHA20_POLY1305, false);
+}
+
+ERL_NIF_TERM aead_chacha20_poly1305_encrypt(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]) {
+    if (5 != argc) {
+        return enif_make_badarg(env);
+    }
+
+    return schedule_by_size(env, "aead_chacha20_poly1305_encrypt", aead_chacha20_poly1305_encrypt_run, argv[4], argc, argv);
+}
+
+static ERL_NIF_TERM aead_chacha20_poly1305_decrypt_run(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]) {
+    return aead_decrypt_with(env, argc, argv, AEAD_CHACHA20_POLY1305);
+}
+
+ERL_NIF_TERM aead_chacha20_poly1305_decrypt(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]) {
+    if (5 != argc) {
+        return enif_make_badarg(env);
+    }
+
+    return schedule_by_size(env, "aead_chacha20_poly1305_decrypt", aead_chacha20_poly1305_decrypt_run, argv[4], argc, argv);
+}
+
 ERL_NIF_TERM deinit(ErlNifEnv *env, int argc, const ERL_NIF_TERM argv[]) {
     if (1 != argc) {
         return enif_make_badarg(env);
     }
 
-    ockam_vault_t vault;
-    if (0 != parse_vault_handle(env, argv[0], &vault)) {
+    vault_resource_t* resource;
+    if (0 != parse_vault_resource(env, argv[0], &resource)) {
         return enif_make_badarg(env);
     }
 
-    ockam_vault_extern_error_t error = ockam_vault_deinit(vault);
-    if (extern_error_check_and_free_error(&error)) {
+    if (!resource->alive) {
         return error_tuple(env, "failed to deinit vault");
     }
 
+    resource->alive = false;
+
+    ockam_vault_extern_error_t error = ockam_vault_deinit(resource->vault);
+    if (extern_error_has_error(&error)) {
+        return extern_error_tuple(env, &error);
+    }
+
     return ok_void(env);
 }
@@ -0,0 +1,488 @@
+// Benchmark of the ockam_ffi vault API, outside of the BEAM.
+//
+// Every result is printed on stdout as one JSON object per line:
+//
+//   {"op":"aead_aes_gcm_encrypt","payload":1024,"threads":4,"vault":"shared",
+//    "ops":40000,"ops_per_sec":812345.6,"p50_ns":4200,"p99_ns":9800}
+//
+// Usage: ockam_vault_bench [-n iterations] [-t threads[,threads...]] [-s] [-S] [-o op]
+//
+//   -n  timed iterations per thread and payload size, defaults to 10000
+//   -t  comma separated thread counts to run every benchmark with, defaults to 1
+//   -s  share a single vault between the threads, to expose contention on its secrets,
+//       instead of one vault per thread registered with the thread index as affinity
+//   -S  disable the async runtime, see ockam_vault_set_async_runtime
+//   -o  only run the benchmarks whose name contains `op`
+
+#include <errno.h>
+#include <inttypes.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ockam/vault.h"
+
+#define AES_KEY_SIZE     32
+#define TAG_SIZE         16
+#define PUBLIC_KEY_SIZE  32
+#define MAX_THREADS      256
+#define MAX_THREAD_RUNS  16
+#define WARMUP_DIVISOR   10
+
+static const size_t PAYLOAD_SIZES[] = {64, 1024, 16 * 1024, 64 * 1024};
+static const size_t PAYLOAD_SIZES_COUNT = sizeof(PAYLOAD_SIZES) / sizeof(PAYLOAD_SIZES[0]);
+
+// The vault rejects NULL buffers, even empty ones
+static const uint8_t NO_ADDITIONAL_DATA[1] = {0};
+
+typedef enum {
+    OP_SHA256,
+    OP_SECRET_GENERATE,
+    OP_ECDH,
+    OP_HKDF_SHA256,
+    OP_AEAD_ENCRYPT,
+    OP_AEAD_DECRYPT,
+} op_t;
+
+typedef struct {
+    const char* name;
+    op_t        op;
+    bool        sized;
+} benchmark_t;
+
+static const benchmark_t BENCHMARKS[] = {
+    {"sha256", OP_SHA256, true},
+    {"secret_generate", OP_SECRET_GENERATE, false},
+    {"ecdh", OP_ECDH, false},
+    {"hkdf_sha256", OP_HKDF_SHA256, false},
+    {"aead_aes_gcm_encrypt", OP_AEAD_ENCRYPT, true},
+    {"aead_aes_gcm_decrypt", OP_AEAD_DECRYPT, true},
+};
+
+typedef struct {
+    const benchmark_t* benchmark;
+    size_t             payload;
+    size_t             iterations;
+    bool               shared_vault;
+    ockam_vault_t      vault;
+} run_t;
+
+typedef struct {
+    const run_t*         run;
+    size_t               index;
+    ockam_vault_t        vault;
+    ockam_vault_secret_t private_key;
+    ockam_vault_secret_t aes_key;
+    ockam_vault_secret_t salt;
+    ockam_vault_secret_t ikm;
+    uint8_t              peer_public_key[PUBLIC_KEY_SIZE];
+    uint8_t*             input;
+    uint8_t*             output;
+    size_t               output_size;
+    uint64_t             nonce;
+    uint64_t*            latencies;
+    uint64_t             started_ns;
+    uint64_t             finished_ns;
+} worker_t;
+
+static pthread_mutex_t start_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t  start_cond = PTHREAD_COND_INITIALIZER;
+static size_t          ready_workers;
+static bool            started;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ull + (uint64_t) ts.tv_nsec;
+}
+
+static void check(ockam_vault_extern_error_t error, const char* what) {
+    if (0 != error.code) {
+        fprintf(stderr, "%s failed with code %" PRId32 "\n", what, error.code);
+        ockam_vault_free_error(&error);
+        exit(EXIT_FAILURE);
+    }
+}
+
+static void* checked_malloc(size_t size) {
+    void* ptr = malloc(size);
+    if (NULL == ptr) {
+        fprintf(stderr, "failed to allocate %zu bytes\n", size);
+        exit(EXIT_FAILURE);
+    }
+    return ptr;
+}
+
+static ockam_vault_secret_t import_buffer(ockam_vault_t vault, uint8_t type, uint8_t fill) {
+    uint8_t data[AES_KEY_SIZE];
+    memset(data, fill, sizeof(data));
+
+    ockam_vault_secret_attributes_t attributes = {
+        .type        = type,
+        .persistence = OCKAM_VAULT_SECRET_EPHEMERAL,
+        .length      = sizeof(data),
+    };
+
+    ockam_vault_secret_t secret;
+    check(ockam_vault_secret_import(vault, &secret, attributes, data, sizeof(data)), "secret_import");
+    return secret;
+}
+
+static ockam_vault_secret_t generate_keypair(ockam_vault_t vault) {
+    ockam_vault_secret_attributes_t attributes = {
+        .type        = OCKAM_VAULT_SECRET_TYPE_CURVE25519_PRIVATEKEY,
+        .persistence = OCKAM_VAULT_SECRET_EPHEMERAL,
+        .length      = PUBLIC_KEY_SIZE,
+    };
+
+    ockam_vault_secret_t secret;
+    check(ockam_vault_secret_generate(vault, &secret, attributes), "secret_generate");
+    return secret;
+}
+
+static void destroy(ockam_vault_t vault, ockam_vault_secret_t secret) {
+    check(ockam_vault_secret_destroy(vault, secret), "secret_destroy");
+}
+
+// Everything an operation needs is created up front, so that only the operation is timed
+static void worker_setup(worker_t* worker) {
+    const run_t* run = worker->run;
+
+    if (run->shared_vault) {
+        worker->vault = run->vault;
+    } else {
+        check(ockam_vault_default_init_with_affinity(&worker->vault, (uint32_t) worker->index), "default_init");
+    }
+
+    ockam_vault_t vault = worker->vault;
+
+    worker->private_key = generate_keypair(vault);
+    worker->aes_key     = import_buffer(vault, OCKAM_VAULT_SECRET_TYPE_AES_KEY, 0x11);
+    worker->salt        = import_buffer(vault, OCKAM_VAULT_SECRET_TYPE_BUFFER, 0x22);
+    worker->ikm         = import_buffer(vault, OCKAM_VAULT_SECRET_TYPE_BUFFER, 0x33);
+
+    ockam_vault_secret_t peer = generate_keypair(vault);
+    uint32_t             length;
+    check(ockam_vault_secret_publickey_get(vault, peer, worker->peer_public_key, PUBLIC_KEY_SIZE, &length),
+          "secret_publickey_get");
+    destroy(vault, peer);
+
+    worker->input = checked_malloc(run->payload + TAG_SIZE);
+    memset(worker->input, 0x5a, run->payload);
+
+    worker->output_size = run->payload + TAG_SIZE;
+    worker->output      = checked_malloc(worker->output_size);
+
+    if (OP_AEAD_DECRYPT == run->benchmark->op) {
+        // Decrypt the same frame over and over, the input becomes its ciphertext
+        check(ockam_vault_aead_aes_gcm_encrypt(vault,
+                                               worker->aes_key,
+                                               0,
+                                               NO_ADDITIONAL_DATA,
+                                               0,
+                                               worker->input,
+                                               (uint32_t) run->payload,
+                                               worker->output,
+                                               (uint32_t) worker->output_size,
+                                               &length),
+              "aead_aes_gcm_encrypt");
+        memcpy(worker->input, worker->output, length);
+    }
+
+    worker->latencies = checked_malloc(run->iterations * sizeof(uint64_t));
+}
+
+static void worker_teardown(worker_t* worker) {
+    destroy(worker->vault, worker->private_key);
+    destroy(worker->vault, worker->aes_key);
+    destroy(worker->vault, worker->salt);
+    destroy(worker->vault, worker->ikm);
+
+    if (!worker->run->shared_vault) {
+        check(ockam_vault_deinit(worker->vault), "deinit");
+    }
+
+    free(worker->input);
+    free(worker->output);
+}
+
+// Run the operation once and return how long it took. Secrets it creates are destroyed
+// after the clock is stopped.
+static uint64_t run_once(worker_t* worker) {
+    const run_t*         run   = worker->run;
+    ockam_vault_t        vault = worker->vault;
+    ockam_vault_secret_t created[2];
+    size_t               created_count = 0;
+    uint32_t             length;
+
+    uint64_t started = now_ns();
+
+    switch (run->benchmark->op) {
+    case OP_SHA256:
+        check(ockam_vault_sha256(vault, worker->input, (uint32_t) run->payload, worker->output), "sha256");
+        break;
+    case OP_SECRET_GENERATE:
+        created[created_count++] = generate_keypair(vault);
+        break;
+    case OP_ECDH:
+        check(ockam_vault_ecdh(vault, worker->private_key, worker->peer_public_key, PUBLIC_KEY_SIZE, &created[0]),
+              "ecdh");
+        created_count = 1;
+        break;
+    case OP_HKDF_SHA256: {
+        ockam_vault_secret_attributes_t attributes[2] = {
+            {.type = OCKAM_VAULT_SECRET_TYPE_AES_KEY, .persistence = OCKAM_VAULT_SECRET_EPHEMERAL, .length = AES_KEY_SIZE},
+            {.type = OCKAM_VAULT_SECRET_TYPE_AES_KEY, .persistence = OCKAM_VAULT_SECRET_EPHEMERAL, .length = AES_KEY_SIZE},
+        };
+        check(ockam_vault_hkdf_sha256(vault, worker->salt, &worker->ikm, attributes, 2, created), "hkdf_sha256");
+        created_count = 2;
+        break;
+    }
+    case OP_AEAD_ENCRYPT:
+        check(ockam_vault_aead_aes_gcm_encrypt(vault,
+                                               worker->aes_key,
+                                               worker->nonce++,
+                                               NO_ADDITIONAL_DATA,
+                                               0,
+                                               worker->input,
+                                               (uint32_t) run->payload,
+                                               worker->output,
+                                               (uint32_t) worker->output_size,
+                                               &length),
+              "aead_aes_gcm_encrypt");
+        break;
+    case OP_AEAD_DECRYPT:
+        check(ockam_vault_aead_aes_gcm_decrypt(vault,
+                                               worker->aes_key,
+                                               0,
+                                               NO_ADDITIONAL_DATA,
+                                               0,
+                                               worker->input,
+                                               (uint32_t) (run->payload + TAG_SIZE),
+                                               worker->output,
+                                               (uint32_t) worker->output_size,
+                                               &length),
+              "aead_aes_gcm_decrypt");
+        break;
+    }
+
+    uint64_t elapsed = now_ns() - started;
+
+    for (size_t i = 0; i < created_count; i++) {
+        destroy(vault, created[i]);
+    }
+
+    return elapsed;
+}
+
+static void* worker_main(void* arg) {
+    worker_t* worker = arg;
+
+    worker_setup(worker);
+
+    for (size_t i = 0; i < worker->run->iterations / WARMUP_DIVISOR; i++) {
+        run_once(worker);
+    }
+
+    pthread_mutex_lock(&start_lock);
+    ready_workers++;
+    pthread_cond_broadcast(&start_cond);
+    while (!started) {
+        pthread_cond_wait(&start_cond, &start_lock);
+    }
+    pthread_mutex_unlock(&start_lock);
+
+    worker->started_ns = now_ns();
+    for (size_t i = 0; i < worker->run->iterations; i++) {
+        worker->latencies[i] = run_once(worker);
+    }
+    worker->finished_ns = now_ns();
+
+    worker_teardown(worker);
+    return NULL;
+}
+
+static int compare_latencies(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*) a;
+    uint64_t y = *(const uint64_t*) b;
+    return (x > y) - (x < y);
+}
+
+static void run_benchmark(const run_t* run, size_t threads) {
+    worker_t*  workers = calloc(threads, sizeof(worker_t));
+    pthread_t* ids     = calloc(threads, sizeof(pthread_t));
+    if (NULL == workers || NULL == ids) {
+        fprintf(stderr, "failed to allocate %zu workers\n", threads);
+        exit(EXIT_FAILURE);
+    }
+
+    ready_workers = 0;
+    started       = false;
+
+    for (size_t i = 0; i < threads; i++) {
+        workers[i].run   = run;
+        workers[i].index = i;
+        int error        = pthread_create(&ids[i], NULL, worker_main, &workers[i]);
+        if (0 != error) {
+            fprintf(stderr, "failed to start a worker thread: %s\n", strerror(error));
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    // Release the workers together once they are all set up and warmed up
+    pthread_mutex_lock(&start_lock);
+    while (ready_workers < threads) {
+        pthread_cond_wait(&start_cond, &start_lock);
+    }
+    started = true;
+    pthread_cond_broadcast(&start_cond);
+    pthread_mutex_unlock(&start_lock);
+
+    for (size_t i = 0; i < threads; i++) {
+        pthread_join(ids[i], NULL);
+    }
+
+    size_t    ops       = run->iterations * threads;
+    uint64_t* latencies = checked_malloc(ops * sizeof(uint64_t));
+    uint64_t  first     = UINT64_MAX;
+    uint64_t  last      = 0;
+
+    for (size_t i = 0; i < threads; i++) {
+        memcpy(latencies + i * run->iterations, workers[i].latencies, run->iterations * sizeof(uint64_t));
+        free(workers[i].latencies);
+
+        first = workers[i].started_ns < first ? workers[i].started_ns : first;
+        last  = workers[i].finished_ns > last ? workers[i].finished_ns : last;
+    }
+
+    qsort(latencies, ops, sizeof(uint64_t), compare_latencies);
+
+    double seconds = (double) (last - first) / 1e9;
+
+    printf("{\"op\":\"%s\",\"payload\":%zu,\"threads\":%zu,\"vault\":\"%s\",\"ops\":%zu,"
+           "\"ops_per_sec\":%.1f,\"p50_ns\":%" PRIu64 ",\"p99_ns\":%" PRIu64 "}\n",
+           run->benchmark->name,
+           run->payload,
+           threads,
+           run->shared_vault ? "shared" : "per_thread",
+           ops,
+           seconds > 0 ? (double) ops / seconds : 0.0,
+           latencies[ops / 2],
+           latencies[ops * 99 / 100]);
+    fflush(stdout);
+
+    free(latencies);
+    free(workers);
+    free(ids);
+}
+
+static size_t parse_size(const char* value, const char* what) {
+    char*              end;
+    unsigned long long parsed;
+
+    errno  = 0;
+    parsed = strtoull(value, &end, 10);
+    if (0 != errno || end == value || 0 == parsed) {
+        fprintf(stderr, "invalid %s: %s\n", what, value);
+        exit(EXIT_FAILURE);
+    }
+    return (size_t) parsed;
+}
+
+static size_t parse_threads(char* value, size_t* threads) {
+    size_t count = 0;
+
+    for (char* token = strtok(value, ","); NULL != token; token = strtok(NULL, ",")) {
+        if (MAX_THREAD_RUNS == count) {
+            fprintf(stderr, "at most %d thread counts are supported\n", MAX_THREAD_RUNS);
+            exit(EXIT_FAILURE);
+        }
+
+        threads[count] = parse_size(token, "thread count");
+        if (threads[count] > MAX_THREADS) {
+            fprintf(stderr, "at most %d threads are supported\n", MAX_THREADS);
+            exit(EXIT_FAILURE);
+        }
+        count++;
+    }
+    return count;
+}
+
+int main(int argc, char* argv[]) {
+    size_t      iterations               = 10000;
+    size_t      threads[MAX_THREAD_RUNS] = {1};
+    size_t      threads_count            = 1;
+    bool        shared_vault             = false;
+    bool        async_runtime            = true;
+    const char* filter                   = NULL;
+
+    int option;
+    while (-1 != (option = getopt(argc, argv, "n:t:sSo:"))) {
+        switch (option) {
+        case 'n':
+            iterations = parse_size(optarg, "iteration count");
+            break;
+        case 't':
+            threads_count = parse_threads(optarg, threads);
+            break;
+        case 's':
+            shared_vault = true;
+            break;
+        case 'S':
+            async_runtime = false;
+            break;
+        case 'o':
+            filter = optarg;
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-n iterations] [-t threads[,threads...]] [-s] [-S] [-o op]\n", argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    check(ockam_vault_set_async_runtime(async_runtime), "set_async_runtime");
+
+    ockam_vault_backend_info_t backend;
+    check(ockam_vault_backend_info(&backend), "backend_info");
+    printf("{\"backend\":{\"aes\":\"%s\",\"ghash\":\"%s\",\"sha256\":\"%s\"}}\n",
+           backend.aes,
+           backend.ghash,
+           backend.sha256);
+
+    ockam_vault_t vault = {0};
+    if (shared_vault) {
+        check(ockam_vault_default_init(&vault), "default_init");
+    }
+
+    for (size_t b = 0; b < sizeof(BENCHMARKS) / sizeof(BENCHMARKS[0]); b++) {
+        const benchmark_t* benchmark = &BENCHMARKS[b];
+        if (NULL != filter && NULL == strstr(benchmark->name, filter)) {
+            continue;
+        }
+
+        size_t sizes = benchmark->sized ? PAYLOAD_SIZES_COUNT : 1;
+        for (size_t s = 0; s < sizes; s++) {
+            run_t run = {
+                .benchmark    = benchmark,
+                .payload      = benchmark->sized ? PAYLOAD_SIZES[s] : 0,
+                .iterations   = iterations,
+                .shared_vault = shared_vault,
+                .vault        = vault,
+            };
+
+            for (size_t t = 0; t < threads_count; t++) {
+                run_benchmark(&run, threads[t]);
+            }
+        }
+    }
+
+    if (shared_vault) {
+        check(ockam_vault_deinit(vault), "deinit");
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -3,6 +3,20 @@ defmodule Ockam.Vault.Software.Tests do
   doctest Ockam.Vault.Software
   alias Ockam.Vault.Software, as: SoftwareVault
 
+  describe "Ockam.Vault.Software.default_init/1" do
+    test "can run natively implemented functions" do
+      {:ok, handle} = SoftwareVault.default_init(:erlang.system_info(:scheduler_id))
+      {:ok, _hash} = SoftwareVault.sha256(handle, "test")
+
+      :ok = SoftwareVault.deinit(handle)
+
+      # the freed slot is reused, but the stale handle doesn't reach the new vault
+      {:ok, other} = SoftwareVault.default_init(:erlang.system_info(:scheduler_id))
+      assert_raise ArgumentError, fn -> SoftwareVault.sha256(handle, "test") end
+      {:ok, _hash} = SoftwareVault.sha256(other, "test")
+    end
+  end
+
   describe "Ockam.Vault.Software.sha256/2" do
     test "can run natively implemented functions" do
       {:ok, handle} = SoftwareVault.default_init()
@@ -14,6 +28,60 @@ defmodule Ockam.Vault.Software.Tests do
     end
   end
 
+  describe "Ockam.Vault.Software.sha256/2 on dirty schedulers" do
+    test "hashes payloads above the dirty threshold" do
+      {:ok, handle} = SoftwareVault.default_init()
+      input = :crypto.strong_rand_bytes(SoftwareVault.dirty_threshold() * 4)
+      {:ok, %{nifs: %{sha256: %{dirty: dirty_before}}}} = SoftwareVault.stats()
+      {:ok, hash} = SoftwareVault.sha256(handle, input)
+      {:ok, %{nifs: %{sha256: %{dirty: dirty_after}}}} = SoftwareVault.stats()
+
+      assert hash == :crypto.hash(:sha256, input)
+      assert dirty_after > dirty_before
+    end
+
+    test "hashes nested iolists above the dirty threshold" do
+      {:ok, handle} = SoftwareVault.default_init()
+      body = :crypto.strong_rand_bytes(SoftwareVault.dirty_threshold() * 4)
+      input = ["header", [[body], "trailer"] | "tail"]
+      {:ok, %{nifs: %{sha256: %{dirty: dirty_before}}}} = SoftwareVault.stats()
+      {:ok, hash} = SoftwareVault.sha256(handle, input)
+      {:ok, %{nifs: %{sha256: %{dirty: dirty_after}}}} = SoftwareVault.stats()
+
+      assert hash == :crypto.hash(:sha256, input)
+      assert dirty_after > dirty_before
+    end
+  end
+
+  describe "Ockam.Vault.Software.sha256_many/2" do
+    test "can run natively implemented functions" do
+      {:ok, handle} = SoftwareVault.default_init()
+      inputs = ["test", <<>>, ["te", ["st"]] | Enum.map(1..100, &:crypto.strong_rand_bytes/1)]
+      {:ok, hashes} = SoftwareVault.sha256_many(handle, inputs)
+
+      assert hashes == Enum.map(inputs, &:crypto.hash(:sha256, &1))
+      assert {:ok, []} = SoftwareVault.sha256_many(handle, [])
+    end
+  end
+
+  describe "Ockam.Vault.Software.sha256_update/2" do
+    test "can run natively implemented functions" do
+      {:ok, context} = SoftwareVault.sha256_init()
+      :ok = SoftwareVault.sha256_update(context, "te")
+      {:ok, prefix} = SoftwareVault.sha256_clone(context)
+      :ok = SoftwareVault.sha256_update(context, ["s", ["t"]])
+      :ok = SoftwareVault.sha256_update(context, [<<>>, "ing"])
+      {:ok, hash} = SoftwareVault.sha256_final(context)
+
+      assert hash == :crypto.hash(:sha256, "testing")
+
+      :ok = SoftwareVault.sha256_update(prefix, 'st')
+      {:ok, hash} = SoftwareVault.sha256_final(prefix)
+
+      assert hash == :crypto.hash(:sha256, "test")
+    end
+  end
+
   describe "Ockam.Vault.Software.secret_generate/2" do
     test "can run natively implemented functions" do
       {:ok, handle} = SoftwareVault.default_init()
@@ -23,6 +91,36 @@ defmodule Ockam.Vault.Software.Tests do
     end
   end
 
+  describe "Ockam.Vault.Software.set_keypair_pool_watermark/2" do
+    test "can run natively implemented functions" do
+      {:ok, handle} = SoftwareVault.default_init()
+      :ok = SoftwareVault.set_keypair_pool_watermark(handle, 4)
+      attributes = %{type: :curve25519, persistence: :ephemeral, length: 32}
+
+      for _ <- 1..8 do
+        {:ok, secret} = SoftwareVault.secret_generate(handle, attributes)
+        {:ok, private_key} = SoftwareVault.secret_export(handle, secret)
+        {:ok, public_key} = SoftwareVault.secret_publickey_get(handle, secret)
+
+        assert {^public_key, _} = :crypto.generate_key(:ecdh, :x25519, private_key)
+        :ok = SoftwareVault.secret_destroy(handle, secret)
+      end
+
+      :ok = SoftwareVault.set_keypair_pool_watermark(handle, 0)
+      :ok = SoftwareVault.deinit(handle)
+    end
+  end
+
+  describe "Ockam.Vault.Software.backend_info/0" do
+    test "can run natively implemented functions" do
+      {:ok, %{aes: aes, ghash: ghash, sha256: sha256}} = SoftwareVault.backend_info()
+
+      assert aes in [:aes_ni, :soft]
+      assert ghash in [:pclmulqdq, :soft]
+      assert sha256 in [:sha_ni, :armv8_sha2, :soft]
+    end
+  end
+
   describe "Ockam.Vault.Software.secret_import/3" do
     test "can run natively implemented functions" do
       {:ok, handle} = SoftwareVault.default_init()
@@ -95,6 +193,24 @@ defmodule Ockam.Vault.Software.Tests do
 
       :ok = SoftwareVault.secret_destroy(handle, secret)
     end
+
+    test "rejects a destroyed secret once its slot is reused" do
+      {:ok, handle} = SoftwareVault.default_init()
+      attributes = %{type: :curve25519, persistence: :ephemeral, length: 32}
+      {:ok, destroyed} = SoftwareVault.secret_generate(handle, attributes)
+      :ok = SoftwareVault.secret_destroy(handle, destroyed)
+
+      {:ok, reused} = SoftwareVault.secret_generate(handle, attributes)
+      # Handles are `generation << 32 | slot`, the new secret takes the freed slot
+      assert Bitwise.band(reused, 0xFFFFFFFF) == Bitwise.band(destroyed, 0xFFFFFFFF)
+      assert reused != destroyed
+
+      assert {:error, :entry_not_found} = SoftwareVault.secret_export(handle, destroyed)
+      assert {:error, :entry_not_found} = SoftwareVault.secret_destroy(handle, destroyed)
+      assert {:ok, _public_key} = SoftwareVault.secret_publickey_get(handle, reused)
+
+      :ok = SoftwareVault.deinit(handle)
+    end
   end
 
   describe "Ockam.Vault.Software.ecdh/3" do
@@ -122,6 +238,181 @@ defmodule Ockam.Vault.Software.Tests do
     end
   end
 
+  describe "Ockam.Vault.Software.ecdh_batch/2" do
+    test "can run natively implemented functions" do
+      {:ok, handle} = SoftwareVault.default_init()
+      attributes = %{type: :curve25519, persistence: :ephemeral, length: 32}
+
+      peers =
+        for _ <- 1..20 do
+          {:ok, secret} = SoftwareVault.secret_generate(handle, attributes)
+          {:ok, peer_secret} = SoftwareVault.secret_generate(handle, attributes)
+          {:ok, peer_public} = SoftwareVault.secret_publickey_get(handle, peer_secret)
+          {secret, peer_public}
+        end
+
+      {:ok, results} = SoftwareVault.ecdh_batch(handle, peers)
+
+      assert length(results) == length(peers)
+
+      for {{secret, peer_public}, {:ok, dh}} <- Enum.zip(peers, results) do
+        {:ok, expected} = SoftwareVault.ecdh(handle, secret, peer_public)
+        assert SoftwareVault.secret_export(handle, dh) ==
+                 SoftwareVault.secret_export(handle, expected)
+      end
+
+      {:ok, secret} = SoftwareVault.secret_generate(handle, attributes)
+      {:ok, public} = SoftwareVault.secret_publickey_get(handle, secret)
+
+      assert {:ok, [{:ok, _}, {:error, :entry_not_found}]} =
+               SoftwareVault.ecdh_batch(handle, [{secret, public}, {secret + 1000, public}])
+
+      assert {:ok, []} = SoftwareVault.ecdh_batch(handle, [])
+    end
+  end
+
+  describe "Ockam.Vault.Software.aead_aes_gcm_stream_update/3" do
+    test "can run natively implemented functions" do
+      {:ok, handle} = SoftwareVault.default_init()
+      attributes = %{type: :aes, persistence: :ephemeral, length: 32}
+      {:ok, key} = SoftwareVault.secret_import(handle, attributes, :binary.copy(<<3>>, 32))
+      prefix = :crypto.strong_rand_bytes(7)
+      chunks = for size <- [1000, 0, 4096, 17], do: :crypto.strong_rand_bytes(size)
+
+      {:ok, encryptor} = SoftwareVault.aead_aes_gcm_stream_init(handle, key, prefix, :encrypt)
+      cipher_chunks = stream_chunks(encryptor, chunks)
+
+      assert {:error, :invalid_param} =
+               SoftwareVault.aead_aes_gcm_stream_update(encryptor, "ad", "too late")
+
+      {:ok, decryptor} = SoftwareVault.aead_aes_gcm_stream_init(handle, key, prefix, :decrypt)
+      assert stream_chunks(decryptor, cipher_chunks) == chunks
+
+      # A truncated stream doesn't authenticate: its last chunk wasn't encrypted as the last one
+      {:ok, decryptor} = SoftwareVault.aead_aes_gcm_stream_init(handle, key, prefix, :decrypt)
+      [first | _] = cipher_chunks
+
+      assert {:error, :aead_auth_failed} =
+               SoftwareVault.aead_aes_gcm_stream_finalize(decryptor, "ad", first)
+    end
+
+    test "don't share nonces with the per-message functions" do
+      {:ok, handle} = SoftwareVault.default_init()
+      attributes = %{type: :aes, persistence: :ephemeral, length: 32}
+      {:ok, key} = SoftwareVault.secret_import(handle, attributes, :binary.copy(<<3>>, 32))
+
+      # With a zero prefix the first chunk's nonce is the nonce of message 0
+      prefix = <<0::56>>
+      {:ok, encryptor} = SoftwareVault.aead_aes_gcm_stream_init(handle, key, prefix, :encrypt)
+      {:ok, chunk} = SoftwareVault.aead_aes_gcm_stream_update(encryptor, "ad", "plaintext")
+      {:ok, message} = SoftwareVault.aead_aes_gcm_encrypt(handle, key, 0, "ad", "plaintext")
+      assert chunk != message
+
+      {:ok, decryptor} = SoftwareVault.aead_aes_gcm_stream_init(handle, key, prefix, :decrypt)
+
+      assert {:error, :aead_auth_failed} =
+               SoftwareVault.aead_aes_gcm_stream_update(decryptor, "ad", message)
+    end
+  end
+
+  describe "Ockam.Vault.Software asynchronous operations" do
+    test "deliver their results as messages" do
+      {:ok, handle} = SoftwareVault.default_init()
+      attributes = %{type: :curve25519, persistence: :ephemeral, length: 32}
+
+      {:ok, ref} = SoftwareVault.secret_generate_async(handle, attributes)
+      {:ok, secret} = SoftwareVault.await(ref)
+      {:ok, peer_secret} = SoftwareVault.secret_generate(handle, attributes)
+      {:ok, peer_public} = SoftwareVault.secret_publickey_get(handle, peer_secret)
+
+      {:ok, ref} = SoftwareVault.ecdh_async(handle, secret, peer_public)
+      assert_receive {^ref, {:ok, dh}}
+      {:ok, expected} = SoftwareVault.ecdh(handle, secret, peer_public)
+
+      assert SoftwareVault.secret_export(handle, dh) ==
+               SoftwareVault.secret_export(handle, expected)
+
+      key_attributes = %{type: :aes, persistence: :ephemeral, length: 32}
+      {:ok, key} = SoftwareVault.secret_import(handle, key_attributes, :binary.copy(<<7>>, 32))
+
+      plain_text = ["plain", "text"]
+      {:ok, ref} = SoftwareVault.aead_aes_gcm_encrypt_async(handle, key, 3, "ad", plain_text)
+      {:ok, cipher_text} = SoftwareVault.await(ref)
+
+      assert {:ok, cipher_text} ==
+               SoftwareVault.aead_aes_gcm_encrypt(handle, key, 3, "ad", "plaintext")
+
+      {:ok, ref} = SoftwareVault.aead_aes_gcm_decrypt_async(handle, key, 3, "ad", cipher_text)
+      assert {:ok, "plaintext"} = SoftwareVault.await(ref)
+
+      {:ok, ref} = SoftwareVault.aead_aes_gcm_decrypt_async(handle, key, 4, "ad", cipher_text)
+      assert {:error, :aead_auth_failed} = SoftwareVault.await(ref)
+    end
+
+    test "run the ECDH of concurrent processes" do
+      {:ok, handle} = SoftwareVault.default_init()
+      attributes = %{type: :curve25519, persistence: :ephemeral, length: 32}
+
+      results =
+        1..50
+        |> Enum.map(fn _ ->
+          Task.async(fn ->
+            {:ok, secret} = SoftwareVault.secret_generate(handle, attributes)
+            {:ok, peer_secret} = SoftwareVault.secret_generate(handle, attributes)
+            {:ok, peer_public} = SoftwareVault.secret_publickey_get(handle, peer_secret)
+            {:ok, ref} = SoftwareVault.ecdh_async(handle, secret, peer_public)
+            {:ok, dh} = SoftwareVault.await(ref)
+            {:ok, expected} = SoftwareVault.ecdh(handle, secret, peer_public)
+
+            SoftwareVault.secret_export(handle, dh) ==
+              SoftwareVault.secret_export(handle, expected)
+          end)
+        end)
+        |> Enum.map(&Task.await/1)
+
+      assert Enum.all?(results)
+    end
+
+    test "keep their thread count once the threads are started" do
+      {:ok, handle} = SoftwareVault.default_init()
+      attributes = %{type: :curve25519, persistence: :ephemeral, length: 32}
+      {:ok, ref} = SoftwareVault.secret_generate_async(handle, attributes)
+      {:ok, _secret} = SoftwareVault.await(ref)
+
+      assert {:error, :already_started} = SoftwareVault.set_async_threads(3)
+    end
+  end
+
+  describe "Ockam.Vault.Software.ecdh_hkdf_sha256/5" do
+    test "can run natively implemented functions" do
+      {:ok, handle} = SoftwareVault.default_init()
+      attributes = %{type: :curve25519, persistence: :ephemeral, length: 32}
+      buffer_attributes = %{type: :buffer, persistence: :ephemeral, length: 32}
+
+      {:ok, secret1} = SoftwareVault.secret_generate(handle, attributes)
+      {:ok, secret2} = SoftwareVault.secret_generate(handle, attributes)
+      {:ok, public2} = SoftwareVault.secret_publickey_get(handle, secret2)
+      {:ok, salt} = SoftwareVault.secret_generate(handle, buffer_attributes)
+
+      {:ok, dh} = SoftwareVault.ecdh(handle, secret1, public2)
+
+      {:ok, [expected1, expected2]} =
+        SoftwareVault.hkdf_sha256(handle, salt, dh, [buffer_attributes, buffer_attributes])
+
+      {:ok, [derived1, derived2]} =
+        SoftwareVault.ecdh_hkdf_sha256(handle, secret1, public2, salt, [
+          buffer_attributes,
+          buffer_attributes
+        ])
+
+      assert SoftwareVault.secret_export(handle, derived1) ==
+               SoftwareVault.secret_export(handle, expected1)
+
+      assert SoftwareVault.secret_export(handle, derived2) ==
+               SoftwareVault.secret_export(handle, expected2)
+    end
+  end
+
   describe "Ockam.Vault.Software.hkdf_sha256/4" do
     test "can run natively implemented functions" do
       {:ok, handle} = SoftwareVault.default_init()
@@ -190,6 +481,37 @@ defmodule Ockam.Vault.Software.Tests do
     end
   end
 
+  describe "Ockam.Vault.Software.aead_aes_gcm_encrypt_framed/5" do
+    test "can run natively implemented functions" do
+      {:ok, handle} = SoftwareVault.default_init()
+      attributes = %{type: :aes, persistence: :ephemeral, length: 32}
+
+      key_data =
+        <<60, 39, 4, 177, 160, 228, 92, 103, 87, 110, 249, 2, 175, 175, 130, 92, 196, 211, 49,
+          250, 51, 157, 6, 45, 39, 205, 207, 84, 126, 153, 104, 209>>
+
+      {:ok, key} = SoftwareVault.secret_import(handle, attributes, key_data)
+
+      nonce = 5
+
+      {:ok, frame} =
+        SoftwareVault.aead_aes_gcm_encrypt_framed(handle, key, nonce, ["To", "ken"], [
+          "Hello",
+          [", "],
+          'nif'
+        ])
+
+      assert frame ==
+               <<0, 0, 0, 0, 0, 0, 0, 5, 125, 225, 184, 225, 253, 238, 233, 167, 41, 157, 48, 205,
+                 146, 233, 209, 117, 3, 243, 166, 199, 19, 203, 229, 132, 96, 13>>
+
+      {:ok, cipher_text} =
+        SoftwareVault.aead_aes_gcm_encrypt(handle, key, nonce, "Token", ["Hello, ", "nif"])
+
+      assert <<nonce::unsigned-big-integer-size(64), cipher_text::binary>> == frame
+    end
+  end
+
   describe "Ockam.Vault.Software.aead_aes_gcm_decrypt/5" do
     test "can run natively implemented functions" do
       {:ok, handle} = SoftwareVault.default_init()
@@ -213,6 +535,22 @@ defmodule Ockam.Vault.Software.Tests do
 
       assert plain_text == decrypted
     end
+
+    test "reports forged cipher texts with an atom" do
+      {:ok, handle} = SoftwareVault.default_init()
+      attributes = %{type: :aes, persistence: :ephemeral, length: 32}
+      {:ok, key} = SoftwareVault.secret_import(handle, attributes, :binary.copy(<<1>>, 32))
+
+      {:ok, cipher_text} = SoftwareVault.aead_aes_gcm_encrypt(handle, key, 1, "ad", "secret")
+      <<first, rest::binary>> = cipher_text
+      forged = <<Bitwise.bxor(first, 1), rest::binary>>
+
+      assert {:error, :aead_auth_failed} ==
+               SoftwareVault.aead_aes_gcm_decrypt(handle, key, 1, "ad", forged)
+
+      assert {:error, :entry_not_found} ==
+               SoftwareVault.aead_aes_gcm_decrypt(handle, key + 1000, 1, "ad", cipher_text)
+    end
   end
 
   describe "Ockam.Vault.Software.aead_aes_gcm_encrypt_decrypt/5" do
@@ -234,11 +572,286 @@ defmodule Ockam.Vault.Software.Tests do
     end
   end
 
+  describe "Ockam.Vault.Software.aead_chacha20_poly1305_decrypt/5" do
+    test "can run natively implemented functions" do
+      {:ok, handle} = SoftwareVault.default_init()
+      attributes = %{type: :aes, persistence: :ephemeral, length: 32}
+
+      key_data =
+        <<60, 39, 4, 177, 160, 228, 92, 103, 87, 110, 249, 2, 175, 175, 130, 92, 196, 211, 49,
+          250, 51, 157, 6, 45, 39, 205, 207, 84, 126, 153, 104, 209>>
+
+      {:ok, key} = SoftwareVault.secret_import(handle, attributes, key_data)
+
+      plain_text = "Hello, nif"
+      ad = "Token"
+      nonce = 5
+
+      cipher_text =
+        <<92, 228, 97, 5, 45, 224, 202, 87, 7, 68, 202, 157, 12, 56, 248, 147, 18, 85, 127, 225,
+          196, 180, 251, 7, 77, 183>>
+
+      {:ok, ^cipher_text} =
+        SoftwareVault.aead_chacha20_poly1305_encrypt(handle, key, nonce, ad, plain_text)
+
+      {:ok, decrypted} =
+        SoftwareVault.aead_chacha20_poly1305_decrypt(handle, key, nonce, ad, cipher_text)
+
+      assert plain_text == decrypted
+
+      <<first, rest::binary>> = cipher_text
+      forged = <<Bitwise.bxor(first, 1), rest::binary>>
+
+      assert {:error, :aead_auth_failed} ==
+               SoftwareVault.aead_chacha20_poly1305_decrypt(handle, key, nonce, ad, forged)
+
+      assert {:error, :aead_auth_failed} ==
+               SoftwareVault.aead_aes_gcm_decrypt(handle, key, nonce, ad, cipher_text)
+    end
+
+    test "runs in the encryptor and decryptor resources" do
+      {:ok, handle} = SoftwareVault.default_init()
+      attributes = %{type: :aes, persistence: :ephemeral, length: 32}
+
+      {:ok, key} = SoftwareVault.secret_generate(handle, attributes)
+      {:ok, key_bytes} = SoftwareVault.secret_export(handle, key)
+      {:ok, decryptor_key} = SoftwareVault.secret_import(handle, attributes, key_bytes)
+
+      {:ok, encryptor} =
+        SoftwareVault.aead_aes_gcm_encryptor_new(handle, key, 0, 2, :chacha20_poly1305)
+
+      {:ok, decryptor} =
+        SoftwareVault.aead_chacha20_poly1305_decryptor_new(handle, decryptor_key, 0, 2)
+
+      {:ok, first} = SoftwareVault.aead_aes_gcm_encryptor_encrypt(encryptor, "Token", "Hello")
+
+      {:ok, frames} =
+        SoftwareVault.aead_aes_gcm_encryptor_encrypt_batch(encryptor, [
+          {"", "Hello again"},
+          {"", "and again"},
+          {"", "and again"}
+        ])
+
+      {:ok, "Hello"} = SoftwareVault.aead_aes_gcm_decryptor_decrypt(decryptor, "Token", first)
+
+      ["Hello again", "and again", "and again"] =
+        Enum.map(frames, fn frame ->
+          {:ok, plain_text} = SoftwareVault.aead_aes_gcm_decryptor_decrypt(decryptor, "", frame)
+          plain_text
+        end)
+    end
+  end
+
+  describe "Ockam.Vault.Software.aead_aes_gcm_encrypt_and_hash/5" do
+    test "can run natively implemented functions" do
+      {:ok, handle} = SoftwareVault.default_init()
+
+      key_data =
+        <<60, 39, 4, 177, 160, 228, 92, 103, 87, 110, 249, 2, 175, 175, 130, 92, 196, 211, 49,
+          250, 51, 157, 6, 45, 39, 205, 207, 84, 126, 153, 104, 209>>
+
+      {:ok, aes_key} =
+        SoftwareVault.secret_import(handle, %{type: :aes, persistence: :ephemeral}, key_data)
+
+      {:ok, buffer_key} =
+        SoftwareVault.secret_import(
+          handle,
+          %{type: :buffer, persistence: :ephemeral, length: 32},
+          key_data
+        )
+
+      h = :crypto.hash(:sha256, "handshake")
+      nonce = 1
+
+      {:ok, expected} = SoftwareVault.aead_aes_gcm_encrypt(handle, aes_key, nonce, h, "payload")
+      expected_h = :crypto.hash(:sha256, h <> expected)
+
+      {:ok, ^expected, ^expected_h} =
+        SoftwareVault.aead_aes_gcm_encrypt_and_hash(handle, buffer_key, nonce, h, "payload")
+
+      {:ok, "payload", ^expected_h} =
+        SoftwareVault.aead_aes_gcm_decrypt_and_hash(handle, buffer_key, nonce, h, expected)
+
+      {:error, _} =
+        SoftwareVault.aead_aes_gcm_decrypt_and_hash(handle, buffer_key, nonce + 1, h, expected)
+    end
+  end
+
+  describe "Ockam.Vault.Software.aead_aes_gcm_rekey/3" do
+    test "can run natively implemented functions" do
+      {:ok, handle} = SoftwareVault.default_init()
+      attributes = %{type: :aes, persistence: :ephemeral, length: 32}
+
+      {:ok, key} = SoftwareVault.secret_generate(handle, attributes)
+
+      max_nonce = 0xFFFFFFFFFFFFFFFF
+
+      {:ok, <<expected::binary-size(32), _tag::binary>>} =
+        SoftwareVault.aead_aes_gcm_encrypt(handle, key, max_nonce, "", <<0::size(256)>>)
+
+      {:ok, new_key} = SoftwareVault.aead_aes_gcm_rekey(handle, key, false)
+      {:ok, ^expected} = SoftwareVault.secret_export(handle, new_key)
+
+      {:ok, next_key} = SoftwareVault.aead_aes_gcm_rekey(handle, key, true)
+      {:ok, ^expected} = SoftwareVault.secret_export(handle, next_key)
+      {:error, _} = SoftwareVault.secret_export(handle, key)
+    end
+  end
+
+  describe "Ockam.Vault.Software.aead_aes_gcm_encrypt_batch/4" do
+    test "can run natively implemented functions" do
+      {:ok, handle} = SoftwareVault.default_init()
+      attributes = %{type: :aes, persistence: :ephemeral, length: 32}
+
+      {:ok, key} = SoftwareVault.secret_generate(handle, attributes)
+
+      messages = [{"Token", "Hello, nif"}, {"", "Hello again"}, {"Token", ""}]
+      start_nonce = 5
+
+      {:ok, frames} = SoftwareVault.aead_aes_gcm_encrypt_batch(handle, key, start_nonce, messages)
+
+      frames
+      |> Enum.zip(messages)
+      |> Enum.with_index(start_nonce)
+      |> Enum.each(fn {{frame, {ad, plain_text}}, nonce} ->
+        <<^nonce::unsigned-big-integer-size(64), cipher_text::binary>> = frame
+
+        {:ok, ^cipher_text} =
+          SoftwareVault.aead_aes_gcm_encrypt(handle, key, nonce, ad, plain_text)
+      end)
+
+      {:ok, []} = SoftwareVault.aead_aes_gcm_encrypt_batch(handle, key, start_nonce, [])
+    end
+  end
+
+  describe "Ockam.Vault.Software.aead_aes_gcm_encryptor_encrypt/3" do
+    test "can run natively implemented functions" do
+      {:ok, handle} = SoftwareVault.default_init()
+      attributes = %{type: :aes, persistence: :ephemeral, length: 32}
+
+      {:ok, key} = SoftwareVault.secret_generate(handle, attributes)
+      {:ok, key_bytes} = SoftwareVault.secret_export(handle, key)
+      {:ok, decryptor_key} = SoftwareVault.secret_import(handle, attributes, key_bytes)
+
+      {:ok, encryptor} = SoftwareVault.aead_aes_gcm_encryptor_new(handle, key, 0, 2)
+      {:ok, decryptor} = SoftwareVault.aead_aes_gcm_decryptor_new(handle, decryptor_key, 0, 2)
+
+      {:ok, <<0::unsigned-big-integer-size(64), _::binary>> = first} =
+        SoftwareVault.aead_aes_gcm_encryptor_encrypt(encryptor, "Token", "Hello, nif")
+
+      {:ok, frames} =
+        SoftwareVault.aead_aes_gcm_encryptor_encrypt_batch(encryptor, [
+          {"", "Hello again"},
+          {"", "and again"},
+          {"", "and again"}
+        ])
+
+      {:ok, "Hello, nif"} =
+        SoftwareVault.aead_aes_gcm_decryptor_decrypt(decryptor, "Token", first)
+
+      ["Hello again", "and again", "and again"] =
+        Enum.map(frames, fn frame ->
+          {:ok, plain_text} = SoftwareVault.aead_aes_gcm_decryptor_decrypt(decryptor, "", frame)
+          plain_text
+        end)
+    end
+  end
+
+  describe "Ockam.Vault.Software.aead_aes_gcm_decryptor_decrypt/3" do
+    test "can run natively implemented functions" do
+      {:ok, handle} = SoftwareVault.default_init()
+      attributes = %{type: :aes, persistence: :ephemeral, length: 32}
+
+      {:ok, key} = SoftwareVault.secret_generate(handle, attributes)
+
+      messages = [{"Token", "Hello, nif"}, {"", "Hello again"}]
+      {:ok, [first, second]} = SoftwareVault.aead_aes_gcm_encrypt_batch(handle, key, 0, messages)
+
+      {:ok, decryptor} = SoftwareVault.aead_aes_gcm_decryptor_new(handle, key, 0, 32)
+
+      {:ok, "Hello again"} = SoftwareVault.aead_aes_gcm_decryptor_decrypt(decryptor, "", second)
+      {:ok, "Hello, nif"} =
+        SoftwareVault.aead_aes_gcm_decryptor_decrypt(decryptor, "Token", first)
+
+      {:error, :repeated_nonce} =
+        SoftwareVault.aead_aes_gcm_decryptor_decrypt(decryptor, "Token", first)
+
+      {:error, :invalid_frame} = SoftwareVault.aead_aes_gcm_decryptor_decrypt(decryptor, "", "")
+    end
+  end
+
+  describe "Ockam.Vault.Software.aead_aes_gcm_encrypt_decrypt/5 on dirty schedulers" do
+    test "encrypts and decrypts payloads above the dirty threshold" do
+      {:ok, handle} = SoftwareVault.default_init()
+      attributes = %{type: :aes, persistence: :ephemeral, length: 32}
+
+      {:ok, key} = SoftwareVault.secret_generate(handle, attributes)
+
+      plain_text = :crypto.strong_rand_bytes(SoftwareVault.dirty_threshold() * 4)
+      ad = "Token"
+      nonce = 5
+
+      {:ok, cipher_text} = SoftwareVault.aead_aes_gcm_encrypt(handle, key, nonce, ad, plain_text)
+
+      {:ok, decrypted} = SoftwareVault.aead_aes_gcm_decrypt(handle, key, nonce, ad, cipher_text)
+
+      assert plain_text == decrypted
+    end
+  end
+
   describe "Ockam.Vault.Software.deinit/1" do
     test "can run natively implemented functions" do
       {:ok, handle} = SoftwareVault.default_init()
 
       :ok = SoftwareVault.deinit(handle)
     end
+
+    test "keeps other vaults usable" do
+      {:ok, first} = SoftwareVault.default_init()
+      {:ok, second} = SoftwareVault.default_init()
+
+      :ok = SoftwareVault.deinit(first)
+
+      {:error, _} = SoftwareVault.deinit(first)
+      assert_raise ArgumentError, fn -> SoftwareVault.sha256(first, "test") end
+
+      {:ok, _hash} = SoftwareVault.sha256(second, "test")
+    end
+  end
+
+  describe "Ockam.Vault.Software.stats/0" do
+    test "can run natively implemented functions" do
+      {:ok, handle} = SoftwareVault.default_init()
+      {:ok, _hash} = SoftwareVault.sha256(handle, "test")
+      {:error, _} = SoftwareVault.secret_export(handle, 0)
+
+      {:ok, %{nifs: nifs, vaults: vaults, secrets: secrets}} = SoftwareVault.stats()
+
+      %{calls: calls, bytes_in: bytes_in, bytes_out: bytes_out, latency: latency} = nifs.sha256
+      assert calls >= 1
+      assert bytes_in >= 4
+      assert bytes_out >= 32
+      assert length(latency) == 32
+      assert Enum.sum(latency) == calls
+
+      assert nifs.secret_export.errors >= 1
+      assert vaults >= 1
+      assert secrets >= 0
+
+      :ok = SoftwareVault.deinit(handle)
+    end
+  end
+
+  defp stream_chunks(stream, chunks) do
+    {init, [last]} = Enum.split(chunks, -1)
+
+    outputs =
+      Enum.map(init, fn chunk ->
+        {:ok, output} = SoftwareVault.aead_aes_gcm_stream_update(stream, "ad", chunk)
+        output
+      end)
+
+    {:ok, output} = SoftwareVault.aead_aes_gcm_stream_finalize(stream, "ad", last)
+    outputs ++ [output]
   end
 end
@@ -3,6 +3,7 @@
 #ifndef RUST_VAULT_H
 #define RUST_VAULT_H
 
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdint.h>
 
@@ -21,15 +22,37 @@ typedef uint64_t ockam_vault_secret_t;
  * @struct ockam_vault_extern_error_t
  * @brief Represents an error that occurred in one of the `ockam_vault` functions.
  *
- * In the case of an error, resources associated with this error (the `domain` string)
- * must be released using @ref ockam_vault_free_error (which is a no-op if an error did
- * not occur) in order to avoid a memory leak.
+ * `code` is 0 when no error occurred. `domain` is a static string: "ockam_ffi" for the
+ * errors raised by the FFI layer, listed below, and "ockam" for the errors raised by
+ * the vault, coded as `origin * 10000 + kind`. Reporting an error never allocates,
+ * @ref ockam_vault_free_error only clears `domain`.
  */
 typedef struct {
     int32_t code;
     const char *domain;
 } ockam_vault_extern_error_t;
 
+/**
+ * @enum    ockam_vault_error_code_t
+ * @brief   Codes of the errors raised by the FFI layer.
+ */
+typedef enum {
+    OCKAM_VAULT_ERROR_PERSISTENCE_NOT_SUPPORTED = 50101,
+    OCKAM_VAULT_ERROR_CREATING_FILESYSTEM_VAULT,
+    OCKAM_VAULT_ERROR_INVALID_PARAM,
+    OCKAM_VAULT_ERROR_ENTRY_NOT_FOUND,
+    OCKAM_VAULT_ERROR_UNKNOWN_PUBLIC_KEY_TYPE,
+    OCKAM_VAULT_ERROR_INVALID_STRING,
+    OCKAM_VAULT_ERROR_BUFFER_TOO_SMALL,
+    OCKAM_VAULT_ERROR_INVALID_PUBLIC_KEY,
+    OCKAM_VAULT_ERROR_VAULT_NOT_FOUND,
+    OCKAM_VAULT_ERROR_OWNERSHIP,
+    OCKAM_VAULT_ERROR_UNEXPECTED_PANIC,
+    OCKAM_VAULT_ERROR_TOO_MANY_SECRETS,
+    OCKAM_VAULT_ERROR_TOO_MANY_VAULTS,
+    OCKAM_VAULT_ERROR_AEAD_AUTH_FAILED,
+} ockam_vault_error_code_t;
+
 /**
  * @enum    ockam_vault_secret_t
  * @brief   Supported secret types for AES and Elliptic Curves.
@@ -60,6 +83,54 @@ typedef struct {
     uint32_t length;
 } ockam_vault_secret_attributes_t;
 
+/**
+ * @brief   Opaque streaming SHA-256 context.
+ */
+typedef struct ockam_vault_sha256_ctx ockam_vault_sha256_ctx_t;
+
+/**
+ * @brief   Opaque chunked AES-GCM stream.
+ */
+typedef struct ockam_vault_aead_stream ockam_vault_aead_stream_t;
+
+/**
+ * @struct  ockam_vault_buffer_t
+ * @brief   A single input of a batch operation.
+ */
+typedef struct {
+    const uint8_t* data;
+    uint32_t       length;
+} ockam_vault_buffer_t;
+
+/**
+ * @struct  ockam_vault_aead_message_t
+ * @brief   A single message of a batch AEAD operation.
+ */
+typedef struct {
+    const uint8_t* additional_data;
+    uint32_t       additional_data_length;
+    const uint8_t* plaintext;
+    uint32_t       plaintext_length;
+} ockam_vault_aead_message_t;
+
+/**
+ * @struct  ockam_vault_ecdh_request_t
+ * @brief   A single operation of a batch ECDH.
+ */
+typedef struct {
+    ockam_vault_secret_t privatekey;
+    const uint8_t*       peer_publickey;
+    uint32_t             peer_publickey_length;
+} ockam_vault_ecdh_request_t;
+
+/**
+ * @brief   Enable or disable the async runtime used to run vault operations.
+ * @param   enabled[in] When false, operations run on the calling thread and the runtime is never started.
+ *                      Call it before any other vault function to avoid starting the runtime at all.
+ * @return  an error, which should be freed using @ref ockam_vault_free_error.
+ */
+ockam_vault_extern_error_t ockam_vault_set_async_runtime(bool enabled);
+
 /**
  * @brief   Initialize the specified ockam vault object
  * @param   vault[out] The ockam vault object to initialize with the default vault.
@@ -67,6 +138,23 @@ typedef struct {
  */
 ockam_vault_extern_error_t ockam_vault_default_init(ockam_vault_t* vault);
 
+/**
+ * @brief   Initialize the specified ockam vault object in the registry shard picked by an affinity value.
+ * @param   vault[out]   The ockam vault object to initialize with the default vault.
+ * @param   affinity[in] Vaults created with the same affinity, e.g. a scheduler id, share a registry lock.
+ * @return  an error, which should be freed using @ref ockam_vault_free_error.
+ */
+ockam_vault_extern_error_t ockam_vault_default_init_with_affinity(ockam_vault_t* vault, uint32_t affinity);
+
+/**
+ * @brief   Keep ephemeral X25519 keypairs pre-generated by a background thread.
+ * @param   vault[in]     The ockam vault state.
+ * @param   watermark[in] Number of keypairs to keep ready. @ref ockam_vault_secret_generate hands them out
+ *                        for X25519 attributes. 0 stops the refill and destroys the pooled keypairs.
+ * @return  an error, which should be freed using @ref ockam_vault_free_error.
+ */
+ockam_vault_extern_error_t ockam_vault_set_keypair_pool_watermark(ockam_vault_t vault, uint32_t watermark);
+
 /**
  * @brief   Compute a SHA-256 hash based on input data.
  * @param   vault[in]           Vault object to use for SHA-256.
@@ -80,6 +168,62 @@ ockam_vault_extern_error_t ockam_vault_sha256(ockam_vault_t  vault,
                                               uint32_t       input_length,
                                               uint8_t*       digest);
 
+/**
+ * @brief   Compute the SHA-256 hashes of many independent inputs in a single call.
+ * @param   vault[in]         Vault object to use for SHA-256.
+ * @param   inputs[in]        Array of buffers containing the data to run through SHA-256.
+ * @param   inputs_count[in]  Length of the inputs array.
+ * @param   digests[out]      Buffer to place the resulting SHA-256 hashes in, one after the other, in the order of
+ *                            inputs. Must be 32 * inputs_count bytes.
+ * @return  an error, which should be freed using @ref ockam_vault_free_error.
+ */
+ockam_vault_extern_error_t ockam_vault_sha256_many(ockam_vault_t               vault,
+                                                   const ockam_vault_buffer_t* inputs,
+                                                   uint32_t                    inputs_count,
+                                                   uint8_t*                    digests);
+
+/**
+ * @brief   Create a streaming SHA-256 context.
+ * @param   context[out]  The new context, which must be freed using @ref ockam_vault_sha256_free.
+ * @return  an error, which should be freed using @ref ockam_vault_free_error.
+ */
+ockam_vault_extern_error_t ockam_vault_sha256_init(ockam_vault_sha256_ctx_t** context);
+
+/**
+ * @brief   Absorb input data into a streaming SHA-256 context.
+ * @param   context[in]       Context to update.
+ * @param   input[in]         Buffer containing data to run through SHA-256.
+ * @param   input_length[in]  Length of the data to run through SHA-256.
+ * @return  an error, which should be freed using @ref ockam_vault_free_error.
+ */
+ockam_vault_extern_error_t ockam_vault_sha256_update(ockam_vault_sha256_ctx_t* context,
+                                                     const uint8_t*            input,
+                                                     uint32_t                  input_length);
+
+/**
+ * @brief   Compute the SHA-256 hash of all the data absorbed so far. The context can keep absorbing data.
+ * @param   context[in]  Context to hash.
+ * @param   digest[out]  Buffer to place the resulting SHA-256 hash in. Must be 32 bytes.
+ * @return  an error, which should be freed using @ref ockam_vault_free_error.
+ */
+ockam_vault_extern_error_t ockam_vault_sha256_final(const ockam_vault_sha256_ctx_t* context, uint8_t* digest);
+
+/**
+ * @brief   Copy a streaming SHA-256 context.
+ * @param   context[in]  Context to copy.
+ * @param   clone[out]   The copy, which must be freed using @ref ockam_vault_sha256_free.
+ * @return  an error, which should be freed using @ref ockam_vault_free_error.
+ */
+ockam_vault_extern_error_t ockam_vault_sha256_clone(const ockam_vault_sha256_ctx_t* context,
+                                                    ockam_vault_sha256_ctx_t**      clone);
+
+/**
+ * @brief   Free a streaming SHA-256 context.
+ * @param   context[in]  Context to free.
+ * @return  an error, which should be freed using @ref ockam_vault_free_error.
+ */
+ockam_vault_extern_error_t ockam_vault_sha256_free(ockam_vault_sha256_ctx_t* context);
+
 /**
  * @brief   Generate an ockam secret. Attributes struct must specify the configuration for the type of secret to
  *          generate. For EC keys and AES keys, length is ignored.
@@ -173,6 +317,24 @@ ockam_vault_extern_error_t ockam_vault_ecdh(ockam_vault_t         vault,
                                             uint32_t              peer_publickey_length,
                                             ockam_vault_secret_t* shared_secret);
 
+/**
+ * @brief   Perform the ECDH operations of a batch, e.g. the handshakes of many peers connecting at once. The vault
+ *          is looked up once and the operations are split between the calling thread and a pool of threads,
+ *          shared by all the batches and started on the first batch.
+ * @param   vault[in]           Vault object to use for ECDH.
+ * @param   requests[in]        Array of private keys and peer public keys.
+ * @param   requests_count[in]  Length of the requests array.
+ * @param   shared_secrets[out] Array of requests_count shared secrets. Invalid when the matching error is not 0.
+ * @param   errors[out]         Array of requests_count error codes, 0 when the matching operation succeeded,
+ *                              otherwise an @ref ockam_vault_error_code_t or another ockam error code.
+ * @return  an error if the batch itself couldn't be run, which should be freed using @ref ockam_vault_free_error.
+ */
+ockam_vault_extern_error_t ockam_vault_ecdh_batch(ockam_vault_t                     vault,
+                                                  const ockam_vault_ecdh_request_t* requests,
+                                                  uint32_t                          requests_count,
+                                                  ockam_vault_secret_t*             shared_secrets,
+                                                  int32_t*                          errors);
+
 /**
  * @brief   Perform an HMAC-SHA256 based key derivation function on the supplied salt and input key material.
  * @param   vault[in]                      Vault object to use for encryption.
@@ -190,6 +352,28 @@ ockam_vault_extern_error_t ockam_vault_hkdf_sha256(ockam_vault_t
                                                    uint8_t                                derived_outputs_count,
                                                    ockam_vault_secret_t*                  derived_outputs);
 
+/**
+ * @brief   Perform an ECDH operation followed by an HMAC-SHA256 based key derivation function, using the shared
+ *          secret as input key material. The shared secret is discarded inside the vault.
+ * @param   vault[in]                      Vault object to use.
+ * @param   privatekey[in]                 Ockam vault secret containing the private key to use for ECDH.
+ * @param   peer_publickey[in]             Public key data to use for ECDH.
+ * @param   peer_publickey_length[in]      Length of the public key.
+ * @param   salt[in]                       Ockam vault secret containing the salt for HKDF.
+ * @param   derived_outputs_attributes[in] Attributes of output secrets.
+ * @param   derived_outputs_count[in]      Length of outputs attributes array.
+ * @param   derived_outputs[out]           Array of ockam vault secrets resulting from HKDF.
+ * @return  an error, which should be freed using @ref ockam_vault_free_error.
+ */
+ockam_vault_extern_error_t ockam_vault_ecdh_hkdf_sha256(ockam_vault_t                          vault,
+                                                        ockam_vault_secret_t                   privatekey,
+                                                        const uint8_t*                         peer_publickey,
+                                                        uint32_t                               peer_publickey_length,
+                                                        ockam_vault_secret_t                   salt,
+                                                        const ockam_vault_secret_attributes_t* derived_outputs_attributes,
+                                                        uint8_t                                derived_outputs_count,
+                                                        ockam_vault_secret_t*                  derived_outputs);
+
 /**
  * @brief   Encrypt a payload using AES-GCM.
  * @param   vault[in]                       Vault object to use for encryption.
@@ -215,6 +399,119 @@ ockam_vault_extern_error_t ockam_vault_aead_aes_gcm_encrypt(ockam_vault_t
                                                             uint32_t             ciphertext_and_tag_size,
                                                             uint32_t*            ciphertext_and_tag_length);
 
+/**
+ * @brief   Encrypt a payload in place using AES-GCM. The plaintext is read from the start of the buffer,
+ *          overwritten by the ciphertext and followed by the tag.
+ * @param   vault[in]                       Vault object to use for encryption.
+ * @param   key[in]                         Ockam secret key to use for encryption.
+ * @param   nonce[in]                       Nonce value to use for encryption.
+ * @param   additional_data[in]             Additional data to use for encryption.
+ * @param   additional_data_length[in]      Length of the additional data.
+ * @param   buffer[in,out]                  Buffer containing the plaintext, receives the ciphertext and tag.
+ * @param   plaintext_length[in]            Length of plaintext data to encrypt.
+ * @param   buffer_size[in]                 Size of the buffer. Must be at least plaintext_length + 16.
+ * @param   ciphertext_and_tag_length[out]  Amount of data placed in the buffer.
+ * @return  an error, which should be freed using @ref ockam_vault_free_error.
+ */
+ockam_vault_extern_error_t ockam_vault_aead_aes_gcm_encrypt_in_place(ockam_vault_t        vault,
+                                                                     ockam_vault_secret_t key,
+                                                                     uint64_t             nonce,
+                                                                     const uint8_t*       additional_data,
+                                                                     uint32_t             additional_data_length,
+                                                                     uint8_t*             buffer,
+                                                                     uint32_t             plaintext_length,
+                                                                     uint32_t             buffer_size,
+                                                                     uint32_t*            ciphertext_and_tag_length);
+
+/**
+ * @brief   Encrypt a batch of payloads using AES-GCM. The key is resolved once for the whole batch and
+ *          message i is encrypted with nonce start_nonce + i. Each message is written to the output buffer
+ *          as an 8 byte big-endian nonce followed by its ciphertext and tag.
+ * @param   vault[in]           Vault object to use for encryption.
+ * @param   key[in]             Ockam secret key to use for encryption.
+ * @param   start_nonce[in]     Nonce value to use for the first message.
+ * @param   messages[in]        Array of additional data and plaintext pairs to encrypt.
+ * @param   messages_count[in]  Number of messages in the array.
+ * @param   output[out]         Buffer to place the framed ciphertexts in.
+ * @param   output_size[in]     Size of the output buffer. Must be the sum of 8 + plaintext_length + 16 for all messages.
+ * @param   output_length[out]  Amount of data placed in the output buffer.
+ * @return  an error, which should be freed using @ref ockam_vault_free_error.
+ */
+ockam_vault_extern_error_t ockam_vault_aead_aes_gcm_encrypt_batch(ockam_vault_t                     vault,
+                                                                  ockam_vault_secret_t              key,
+                                                                  uint64_t                          start_nonce,
+                                                                  const ockam_vault_aead_message_t* messages,
+                                                                  uint32_t                          messages_count,
+                                                                  uint8_t*                          output,
+                                                                  uint32_t                          output_size,
+                                                                  uint32_t*                         output_length);
+
+/**
+ * @brief   Noise EncryptAndHash: encrypt a payload using AES-GCM with h as the additional data, then compute
+ *          the next handshake hash SHA256(h || ciphertext_and_tag). The key can be any secret of 16 or 32 bytes.
+ * @param   vault[in]                       Vault object to use for encryption.
+ * @param   key[in]                         Ockam secret key to use for encryption.
+ * @param   nonce[in]                       Nonce value to use for encryption.
+ * @param   h[in]                           Current handshake hash, 32 bytes.
+ * @param   plaintext[in]                   Buffer containing plaintext data to encrypt.
+ * @param   plaintext_length[in]            Length of plaintext data to encrypt.
+ * @param   ciphertext_and_tag[out]         Buffer containing the generated ciphertext and tag data.
+ * @param   ciphertext_and_tag_size[in]     Size of the ciphertext + tag buffer. Must be plaintext_size + 16.
+ * @param   ciphertext_and_tag_length[out]  Amount of data placed in the ciphertext + tag buffer.
+ * @param   new_h[out]                      Next handshake hash, 32 bytes.
+ * @return  an error, which should be freed using @ref ockam_vault_free_error.
+ */
+ockam_vault_extern_error_t ockam_vault_aead_aes_gcm_encrypt_and_hash(ockam_vault_t        vault,
+                                                                     ockam_vault_secret_t key,
+                                                                     uint64_t             nonce,
+                                                                     const uint8_t*       h,
+                                                                     const uint8_t*       plaintext,
+                                                                     uint32_t             plaintext_length,
+                                                                     uint8_t*             ciphertext_and_tag,
+                                                                     uint32_t             ciphertext_and_tag_size,
+                                                                     uint32_t*            ciphertext_and_tag_length,
+                                                                     uint8_t*             new_h);
+
+/**
+ * @brief   Noise DecryptAndHash: decrypt a payload using AES-GCM with h as the additional data, then compute
+ *          the next handshake hash SHA256(h || ciphertext_and_tag). The key can be any secret of 16 or 32 bytes.
+ * @param   vault[in]                       Vault object to use for decryption.
+ * @param   key[in]                         Ockam secret key to use for decryption.
+ * @param   nonce[in]                       Nonce value to use for decryption.
+ * @param   h[in]                           Current handshake hash, 32 bytes.
+ * @param   ciphertext_and_tag[in]          Buffer containing the ciphertext and tag data to decrypt.
+ * @param   ciphertext_and_tag_length[in]   Length of the ciphertext and tag data to decrypt.
+ * @param   plaintext[out]                  Buffer to place the decrypted data in.
+ * @param   plaintext_size[in]              Size of the plaintext buffer. Must be ciphertext_and_tag_length - 16.
+ * @param   plaintext_length[out]           Amount of data placed in the plaintext buffer.
+ * @param   new_h[out]                      Next handshake hash, 32 bytes, only written on success.
+ * @return  an error, which should be freed using @ref ockam_vault_free_error.
+ */
+ockam_vault_extern_error_t ockam_vault_aead_aes_gcm_decrypt_and_hash(ockam_vault_t        vault,
+                                                                     ockam_vault_secret_t key,
+                                                                     uint64_t             nonce,
+                                                                     const uint8_t*       h,
+                                                                     const uint8_t*       ciphertext_and_tag,
+                                                                     uint32_t             ciphertext_and_tag_length,
+                                                                     uint8_t*             plaintext,
+                                                                     uint32_t             plaintext_size,
+                                                                     uint32_t*            plaintext_length,
+                                                                     uint8_t*             new_h);
+
+/**
+ * @brief   Derive the next AES-GCM key of a secure channel and store it in the vault. The new key is the
+ *          first 32 bytes of the encryption of 32 zero bytes with the max nonce, it never leaves the vault.
+ * @param   vault[in]        Vault object to use for rekeying.
+ * @param   key[in]          Ockam secret key to derive the next key from.
+ * @param   destroy_old[in]  Whether to destroy key once the new key is stored.
+ * @param   new_key[out]     Ockam secret key derived from key.
+ * @return  an error, which should be freed using @ref ockam_vault_free_error.
+ */
+ockam_vault_extern_error_t ockam_vault_aead_aes_gcm_rekey(ockam_vault_t         vault,
+                                                          ockam_vault_secret_t  key,
+                                                          bool                  destroy_old,
+                                                          ockam_vault_secret_t* new_key);
+
 /**
  * @brief   Decrypt a payload using AES-GCM.
  * @param   vault[in]                     Vault object to use for decryption.
@@ -240,6 +537,174 @@ ockam_vault_extern_error_t ockam_vault_aead_aes_gcm_decrypt(ockam_vault_t
                                                             uint32_t             plaintext_size,
                                                             uint32_t*            plaintext_length);
 
+/**
+ * @brief   Encrypt a payload using ChaCha20-Poly1305, which is faster than AES-GCM on CPUs without AES instructions.
+ *          The key is the 32 bytes of any secret. The 12 bytes nonce is 4 zero bytes followed by the little-endian
+ *          nonce value, as in the Noise ChaChaPoly cipher.
+ * @param   vault[in]                       Vault object to use for encryption.
+ * @param   key[in]                         Ockam secret key to use for encryption.
+ * @param   nonce[in]                       Nonce value to use for encryption.
+ * @param   additional_data[in]             Additional data to use for encryption.
+ * @param   additional_data_length[in]      Length of the additional data.
+ * @param   plaintext[in]                   Buffer containing plaintext data to encrypt.
+ * @param   plaintext_length[in]            Length of plaintext data to encrypt.
+ * @param   ciphertext_and_tag[in]          Buffer containing the generated ciphertext and tag data.
+ * @param   ciphertext_and_tag_size[in]     Size of the ciphertext + tag buffer. Must be plaintext_size + 16.
+ * @param   ciphertext_and_tag_length[out]  Amount of data placed in the ciphertext + tag buffer.
+ * @return  an error, which should be freed using @ref ockam_vault_free_error.
+ */
+ockam_vault_extern_error_t ockam_vault_aead_chacha20_poly1305_encrypt(ockam_vault_t        vault,
+                                                                     ockam_vault_secret_t key,
+                                                                     uint64_t             nonce,
+                                                                     const uint8_t*       additional_data,
+                                                                     uint32_t             additional_data_length,
+                                                                     const uint8_t*       plaintext,
+                                                                     uint32_t             plaintext_length,
+                                                                     uint8_t*             ciphertext_and_tag,
+                                                                     uint32_t             ciphertext_and_tag_size,
+                                                                     uint32_t*            ciphertext_and_tag_length);
+
+/**
+ * @brief   Encrypt a payload in place using ChaCha20-Poly1305, see @ref ockam_vault_aead_aes_gcm_encrypt_in_place.
+ * @param   vault[in]                       Vault object to use for encryption.
+ * @param   key[in]                         Ockam secret key to use for encryption.
+ * @param   nonce[in]                       Nonce value to use for encryption.
+ * @param   additional_data[in]             Additional data to use for encryption.
+ * @param   additional_data_length[in]      Length of the additional data.
+ * @param   buffer[in,out]                  Buffer containing the plaintext, receives the ciphertext and tag.
+ * @param   plaintext_length[in]            Length of plaintext data to encrypt.
+ * @param   buffer_size[in]                 Size of the buffer. Must be at least plaintext_length + 16.
+ * @param   ciphertext_and_tag_length[out]  Amount of data placed in the buffer.
+ * @return  an error, which should be freed using @ref ockam_vault_free_error.
+ */
+ockam_vault_extern_error_t ockam_vault_aead_chacha20_poly1305_encrypt_in_place(ockam_vault_t        vault,
+                                                                              ockam_vault_secret_t key,
+                                                                              uint64_t             nonce,
+                                                                              const uint8_t*       additional_data,
+                                                                              uint32_t             additional_data_length,
+                                                                              uint8_t*             buffer,
+                                                                              uint32_t             plaintext_length,
+                                                                              uint32_t             buffer_size,
+                                                                              uint32_t*            ciphertext_and_tag_length);
+
+/**
+ * @brief   Decrypt a payload using ChaCha20-Poly1305.
+ * @param   vault[in]                     Vault object to use for decryption.
+ * @param   key[in]                       Ockam secret key to use for decryption.
+ * @param   nonce[in]                     Nonce value to use for decryption.
+ * @param   additional_data[in]           Additional data to use for decryption.
+ * @param   additional_data_length[in]    Length of the additional data.
+ * @param   ciphertext_and_tag[in]        The ciphertext + tag data to decrypt.
+ * @param   ciphertext_and_tag_length[in] Length of the ciphertext + tag data to decrypt.
+ * @param   plaintext[out]                Buffer to place the decrypted data in, zeroed when authentication fails.
+ * @param   plaintext_size[in]            Size of the plaintext buffer. Must be ciphertext_tag_size - 16.
+ * @param   plaintext_length[out]         Amount of data placed in the plaintext buffer.
+ * @return  an error, which should be freed using @ref ockam_vault_free_error.
+ */
+ockam_vault_extern_error_t ockam_vault_aead_chacha20_poly1305_decrypt(ockam_vault_t       vault,
+                                                                     ockam_vault_secret_t key,
+                                                                     uint64_t             nonce,
+                                                                     const uint8_t*       additional_data,
+                                                                     uint32_t             additional_data_length,
+                                                                     const uint8_t*       ciphertext_and_tag,
+                                                                     uint32_t             ciphertext_and_tag_length,
+                                                                     uint8_t*             plaintext,
+                                                                     uint32_t             plaintext_size,
+                                                                     uint32_t*            plaintext_length);
+
+/**
+ * @brief   Derive the next ChaCha20-Poly1305 key of a secure channel and store it in the vault, with the same
+ *          construction as @ref ockam_vault_aead_aes_gcm_rekey. The new key is stored as a 32 bytes buffer secret.
+ * @param   vault[in]        Vault object to use for rekeying.
+ * @param   key[in]          Ockam secret key to derive the next key from.
+ * @param   destroy_old[in]  Whether to destroy key once the new key is stored.
+ * @param   new_key[out]     Ockam secret key derived from key.
+ * @return  an error, which should be freed using @ref ockam_vault_free_error.
+ */
+ockam_vault_extern_error_t ockam_vault_aead_chacha20_poly1305_rekey(ockam_vault_t         vault,
+                                                                   ockam_vault_secret_t  key,
+                                                                   bool                  destroy_old,
+                                                                   ockam_vault_secret_t* new_key);
+
+/**
+ * @brief   Start encrypting or decrypting a payload in chunks using AES-GCM, following the STREAM construction.
+ *          Each chunk is authenticated on its own, with a nonce made of the nonce prefix, the big-endian 32 bits chunk
+ *          counter and a byte set to 1 for the last chunk only, so chunks can't be reordered, dropped or truncated.
+ *          The chunks are encrypted with a key derived from the key and the nonce prefix using HKDF-SHA256, so they
+ *          never share a key and nonce with @ref ockam_vault_aead_aes_gcm_encrypt and the other per-message functions.
+ * @param   vault[in]               Vault object to use for encryption or decryption.
+ * @param   key[in]                 Ockam secret key to use for encryption or decryption.
+ * @param   encrypt[in]             Non-zero to encrypt, zero to decrypt.
+ * @param   nonce_prefix[in]        Nonce prefix of the stream. Must never be reused with the same key.
+ * @param   nonce_prefix_length[in] Length of the nonce prefix. Must be 7.
+ * @param   stream[out]             The new stream, which must be freed using @ref ockam_vault_aead_aes_gcm_stream_free.
+ * @return  an error, which should be freed using @ref ockam_vault_free_error.
+ */
+ockam_vault_extern_error_t ockam_vault_aead_aes_gcm_stream_init(ockam_vault_t               vault,
+                                                                ockam_vault_secret_t        key,
+                                                                uint8_t                     encrypt,
+                                                                const uint8_t*              nonce_prefix,
+                                                                uint32_t                    nonce_prefix_length,
+                                                                ockam_vault_aead_stream_t** stream);
+
+/**
+ * @brief   Encrypt or decrypt the next chunk of a stream. No chunk is accepted after the last one, or after a chunk
+ *          failed to authenticate.
+ * @param   stream[in]                 Stream to use.
+ * @param   additional_data[in]        Additional data of the chunk.
+ * @param   additional_data_length[in] Length of the additional data.
+ * @param   input[in]                  Plaintext chunk to encrypt, or ciphertext + tag chunk to decrypt.
+ * @param   input_length[in]           Length of the input.
+ * @param   last[in]                   Non-zero for the last chunk of the payload only.
+ * @param   output[out]                Buffer to place the ciphertext + tag or the plaintext in.
+ * @param   output_size[in]            Size of the output buffer. Must be input_length + 16 when encrypting, and
+ *                                     input_length - 16 when decrypting.
+ * @param   output_length[out]         Amount of data placed in the output buffer.
+ * @return  an error, which should be freed using @ref ockam_vault_free_error.
+ */
+ockam_vault_extern_error_t ockam_vault_aead_aes_gcm_stream_update(ockam_vault_aead_stream_t* stream,
+                                                                  const uint8_t*             additional_data,
+                                                                  uint32_t                   additional_data_length,
+                                                                  const uint8_t*             input,
+                                                                  uint32_t                   input_length,
+                                                                  uint8_t                    last,
+                                                                  uint8_t*                   output,
+                                                                  uint32_t                   output_size,
+                                                                  uint32_t*                  output_length);
+
+/**
+ * @brief   Free a chunked AES-GCM stream.
+ * @param   stream[in]  Stream to free.
+ * @return  an error, which should be freed using @ref ockam_vault_free_error.
+ */
+ockam_vault_extern_error_t ockam_vault_aead_aes_gcm_stream_free(ockam_vault_aead_stream_t* stream);
+
+/**
+ * @brief   Count the live vaults and the live secrets summed over all of them, for monitoring.
+ * @param   vaults[out]  Number of vaults initialized and not deinitialized yet.
+ * @param   secrets[out] Number of secret handles not destroyed yet.
+ * @return  an error, which should be freed using @ref ockam_vault_free_error.
+ */
+ockam_vault_extern_error_t ockam_vault_live_handles(uint64_t* vaults, uint64_t* secrets);
+
+/**
+ * @struct  ockam_vault_backend_info_t
+ * @brief   Implementations selected at runtime on this CPU, as static strings: "aes_ni",
+ *          "pclmulqdq", "sha_ni", "armv8_sha2" or "soft" for the portable fallbacks.
+ */
+typedef struct {
+    const char* aes;
+    const char* ghash;
+    const char* sha256;
+} ockam_vault_backend_info_t;
+
+/**
+ * @brief   Report the AES block cipher, GHASH and SHA-256 implementations in use.
+ * @param   info[out] The names of the implementations, which must not be freed.
+ * @return  an error, which should be freed using @ref ockam_vault_free_error.
+ */
+ockam_vault_extern_error_t ockam_vault_backend_info(ockam_vault_backend_info_t* info);
+
 /**
  * @brief   Deinitialize the specified ockam vault object
  * @param   vault[in] The ockam vault object to deinitialize.
@@ -248,7 +713,8 @@ ockam_vault_extern_error_t ockam_vault_aead_aes_gcm_decrypt(ockam_vault_t
 ockam_vault_extern_error_t ockam_vault_deinit(ockam_vault_t vault);
 
 /**
- * @brief   Free any resources associated with a @ref ockam_vault_extern_error_t.
+ * @brief   Release a @ref ockam_vault_extern_error_t. Its domain is static, so this only
+ *          clears it, it's kept for callers written against allocated domains.
  * @param   error[in] the error to free.
  */
 void ockam_vault_free_error(ockam_vault_extern_error_t *error);
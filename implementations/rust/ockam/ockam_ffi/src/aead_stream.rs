@@ -0,0 +1,116 @@
+use crate::FfiError;
+use hkdf::Hkdf;
+use ockam_vault::constants::AES_GCM_TAG_LENGTH_USIZE;
+use ockam_vault::AesGen;
+use sha2::Sha256;
+
+/// Length of the nonce prefix chosen by the caller, the rest of the 12 bytes nonce holds
+/// the chunk counter and the last chunk flag
+pub(crate) const NONCE_PREFIX_LENGTH: usize = 7;
+
+/// HKDF info of the stream keys, see `AeadStream::new`
+const STREAM_KEY_INFO: &[u8] = b"ockam_vault_aead_stream";
+
+/// STREAM chunked AEAD (Hoang, Reyhanitabar, Rogaway and Vizár), with the nonce layout of
+/// `aead::stream::StreamBE32`: the prefix, the big-endian 32 bits chunk counter and a byte
+/// set to 1 for the last chunk only.
+///
+/// Every chunk is authenticated on its own, so a payload is processed one chunk at a time
+/// in constant memory. Chunks can't be reordered, dropped or replayed across streams, and a
+/// truncated payload is rejected since its last chunk isn't flagged as such.
+///
+/// The chunks aren't encrypted with the caller's key but with a key derived from it and the
+/// nonce prefix, otherwise a zero prefix would make the chunk nonces collide with the
+/// 4 zero bytes and big-endian 64 bits counter nonces of the per-message AEAD functions.
+pub(crate) struct AeadStream {
+    aes: AesGen,
+    encrypt: bool,
+    nonce_prefix: [u8; NONCE_PREFIX_LENGTH],
+    counter: u32,
+    finished: bool,
+}
+
+impl AeadStream {
+    /// Start a stream with the AES-GCM key derived, with HKDF-SHA256, from the bytes of the
+    /// AES `key` and the nonce prefix. The derived key has the length of `key`.
+    pub(crate) fn new(key: &[u8], encrypt: bool, nonce_prefix: &[u8]) -> Result<Self, FfiError> {
+        let nonce_prefix: [u8; NONCE_PREFIX_LENGTH] = nonce_prefix
+            .try_into()
+            .map_err(|_| FfiError::InvalidParam)?;
+
+        let mut stream_key = [0u8; 32];
+        let stream_key = stream_key
+            .get_mut(..key.len())
+            .ok_or(FfiError::InvalidParam)?;
+        Hkdf::<Sha256>::new(Some(&nonce_prefix), key)
+            .expand(STREAM_KEY_INFO, stream_key)
+            .map_err(|_| FfiError::InvalidParam)?;
+        let aes = AesGen::from_key(stream_key).map_err(|_| FfiError::InvalidParam)?;
+
+        Ok(Self {
+            aes,
+            encrypt,
+            nonce_prefix,
+            counter: 0,
+            finished: false,
+        })
+    }
+
+    /// Length of the output of a chunk of `input_length` bytes
+    pub(crate) fn output_length(&self, input_length: usize) -> Result<usize, FfiError> {
+        if self.encrypt {
+            Ok(input_length + AES_GCM_TAG_LENGTH_USIZE)
+        } else {
+            input_length
+                .checked_sub(AES_GCM_TAG_LENGTH_USIZE)
+                .ok_or(FfiError::InvalidParam)
+        }
+    }
+
+    /// Encrypt or decrypt the next chunk into `output`, which must be `output_length` bytes
+    /// long. No chunk is accepted after the last one or after a chunk failed to decrypt.
+    pub(crate) fn next_chunk(
+        &mut self,
+        aad: &[u8],
+        input: &[u8],
+        last: bool,
+        output: &mut [u8],
+    ) -> Result<(), FfiError> {
+        if self.finished {
+            return Err(FfiError::InvalidParam);
+        }
+        if output.len() != self.output_length(input.len())? {
+            return Err(FfiError::BufferTooSmall);
+        }
+
+        let nonce = self.nonce(last);
+        // A failed chunk ends the stream, as does the last one or a counter overflow
+        self.finished = true;
+
+        if self.encrypt {
+            self.aes
+                .encrypt_message_into(input, &nonce, aad, output)
+                .map_err(|_| FfiError::InvalidParam)?;
+        } else {
+            self.aes
+                .try_decrypt_message_into(input, &nonce, aad, output)
+                .map_err(|_| FfiError::AeadAuthFailed)?;
+        }
+
+        if !last {
+            if let Some(counter) = self.counter.checked_add(1) {
+                self.counter = counter;
+                self.finished = false;
+            }
+        }
+        Ok(())
+    }
+
+    fn nonce(&self, last: bool) -> [u8; 12] {
+        let mut nonce = [0u8; 12];
+        nonce[..NONCE_PREFIX_LENGTH].copy_from_slice(&self.nonce_prefix);
+        nonce[NONCE_PREFIX_LENGTH..11].copy_from_slice(&self.counter.to_be_bytes());
+        nonce[11] = last as u8;
+        nonce
+    }
+}
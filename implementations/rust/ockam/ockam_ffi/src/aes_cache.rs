@@ -0,0 +1,45 @@
+use ockam_core::compat::collections::HashMap;
+use ockam_core::compat::sync::Arc;
+use ockam_vault::{AesGen, KeyId};
+use std::sync::{PoisonError, RwLock};
+
+/// Maximum number of ciphers kept per vault
+const CAPACITY: usize = 1024;
+
+/// AES-GCM ciphers of a vault's keys, with their key schedules already expanded.
+///
+/// A secure channel encrypts many messages with the same key, so the ciphers are built
+/// once per key rather than once per message. Entries must be removed when their secret
+/// is deleted. When the cache is full an arbitrary entry is evicted, it's rebuilt on its
+/// next use.
+#[derive(Default)]
+pub(crate) struct AesCache {
+    ciphers: RwLock<HashMap<KeyId, Arc<AesGen>>>,
+}
+
+impl AesCache {
+    pub(crate) fn get(&self, key_id: &KeyId) -> Option<Arc<AesGen>> {
+        self.ciphers
+            .read()
+            .unwrap_or_else(PoisonError::into_inner)
+            .get(key_id)
+            .cloned()
+    }
+
+    pub(crate) fn insert(&self, key_id: KeyId, aes: Arc<AesGen>) {
+        let mut ciphers = self.ciphers.write().unwrap_or_else(PoisonError::into_inner);
+        if ciphers.len() >= CAPACITY && !ciphers.contains_key(&key_id) {
+            if let Some(evicted) = ciphers.keys().next().cloned() {
+                ciphers.remove(&evicted);
+            }
+        }
+        ciphers.insert(key_id, aes);
+    }
+
+    pub(crate) fn remove(&self, key_id: &KeyId) {
+        self.ciphers
+            .write()
+            .unwrap_or_else(PoisonError::into_inner)
+            .remove(key_id);
+    }
+}
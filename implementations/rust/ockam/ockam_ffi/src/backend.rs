@@ -0,0 +1,58 @@
+//! Implementations of AES-GCM and SHA-256 selected at runtime on this CPU.
+//!
+//! `aes`, `polyval` and `sha2` pick their hardware backend on the first call, from the CPU
+//! features detected by `cpufeatures`. The checks below mirror theirs, so that callers can
+//! confirm the fast path is in use. They assume the `force-soft` features are off, as they
+//! are in `std` builds.
+
+/// Backend names, nul-terminated for the FFI
+const SOFT: &[u8] = b"soft\0";
+#[cfg(any(target_arch = "x86", target_arch = "x86_64"))]
+const AES_NI: &[u8] = b"aes_ni\0";
+#[cfg(any(target_arch = "x86", target_arch = "x86_64"))]
+const PCLMULQDQ: &[u8] = b"pclmulqdq\0";
+#[cfg(any(target_arch = "x86", target_arch = "x86_64"))]
+const SHA_NI: &[u8] = b"sha_ni\0";
+#[cfg(target_arch = "aarch64")]
+const ARMV8_SHA2: &[u8] = b"armv8_sha2\0";
+
+/// AES block cipher: AES-NI on x86. `aes` 0.7 only has ARMv8 intrinsics on nightly.
+pub(crate) fn aes() -> &'static [u8] {
+    #[cfg(any(target_arch = "x86", target_arch = "x86_64"))]
+    if std::is_x86_feature_detected!("aes") && std::is_x86_feature_detected!("sse2") {
+        return AES_NI;
+    }
+
+    SOFT
+}
+
+/// GHASH universal hash: carry-less multiplication on x86. `polyval` 0.5 only has PMULL
+/// intrinsics on nightly.
+pub(crate) fn ghash() -> &'static [u8] {
+    #[cfg(any(target_arch = "x86", target_arch = "x86_64"))]
+    if std::is_x86_feature_detected!("pclmulqdq") && std::is_x86_feature_detected!("sse4.1") {
+        return PCLMULQDQ;
+    }
+
+    SOFT
+}
+
+/// SHA-256 compression: SHA-NI on x86, the ARMv8 SHA2 extension on aarch64, enabled by
+/// the `asm` feature of `sha2`
+pub(crate) fn sha256() -> &'static [u8] {
+    #[cfg(any(target_arch = "x86", target_arch = "x86_64"))]
+    if std::is_x86_feature_detected!("sha")
+        && std::is_x86_feature_detected!("sse2")
+        && std::is_x86_feature_detected!("ssse3")
+        && std::is_x86_feature_detected!("sse4.1")
+    {
+        return SHA_NI;
+    }
+
+    #[cfg(target_arch = "aarch64")]
+    if std::arch::is_aarch64_feature_detected!("sha2") {
+        return ARMV8_SHA2;
+    }
+
+    SOFT
+}
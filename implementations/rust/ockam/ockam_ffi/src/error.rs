@@ -2,9 +2,16 @@ use ockam_core::{
     errcode::{Kind, Origin},
     Error,
 };
-use std::ffi::CString;
+use ockam_vault::VaultError;
+use std::error::Error as StdError;
 use std::os::raw::c_char;
 
+/// Domain of the errors raised by the FFI layer itself, see `FfiError::code`
+const FFI_DOMAIN: &[u8] = b"ockam_ffi\0";
+
+/// Domain of the errors raised by the Ockam crates, coded as `origin * 10_000 + kind`
+const OCKAM_DOMAIN: &[u8] = b"ockam\0";
+
 #[repr(C)]
 #[derive(Debug, PartialEq, Eq)]
 /// Error type relating to FFI specific failures.
@@ -14,12 +21,13 @@ pub struct FfiOckamError {
 }
 
 impl FfiOckamError {
-    /// Create a new error.
-    pub fn new(code: i32, domain: &str) -> Self {
+    /// Create a new error. `domain` must be nul-terminated, it's static so that reporting
+    /// an error never allocates.
+    pub fn new(code: i32, domain: &'static [u8]) -> Self {
+        debug_assert_eq!(domain.last(), Some(&0));
         Self {
             code,
-            // TODO: Should this graciously fail?
-            domain: CString::new(domain.as_bytes()).unwrap().into_raw(),
+            domain: domain.as_ptr() as *const c_char,
         }
     }
 
@@ -30,6 +38,11 @@ impl FfiOckamError {
             domain: std::ptr::null(),
         }
     }
+
+    /// Error code, `0` for no error.
+    pub fn code(&self) -> i32 {
+        self.code
+    }
 }
 
 /// Represents the failures that can occur in an Ockam FFI Vault.
@@ -67,6 +80,23 @@ pub enum FfiError {
 
     /// Caught a panic (which would be UB if we let it unwind across the FFI).
     UnexpectedPanic,
+
+    /// No secret handle is left in this Vault.
+    TooManySecrets,
+
+    /// No vault handle is left in this shard.
+    TooManyVaults,
+
+    /// A ciphertext failed AES-GCM authentication.
+    AeadAuthFailed,
+}
+
+impl FfiError {
+    /// FFI errors use the `Api` origin with codes above the range of `Kind`s, so they
+    /// never collide with the `origin * 10_000 + kind` codes of other errors
+    pub fn code(self) -> i32 {
+        Origin::Api as i32 * 10_000 + 100 + self as i32
+    }
 }
 impl ockam_core::compat::error::Error for FfiError {}
 impl From<FfiError> for Error {
@@ -98,32 +128,42 @@ impl core::fmt::Display for FfiError {
                 f,
                 "caught a panic (which would be UB if we let it unwind across the FFI)."
             ),
+            Self::TooManySecrets => write!(f, "no secret handle is left in this Vault."),
+            Self::TooManyVaults => write!(f, "no vault handle is left in this shard."),
+            Self::AeadAuthFailed => write!(f, "a ciphertext failed AEAD authentication."),
         }
     }
 }
 
 impl From<Error> for FfiOckamError {
     fn from(err: Error) -> Self {
+        // Keep the specific code of the errors which crossed an async boundary as an `Error`
+        if let Some(cause) = err.source() {
+            if let Some(err) = cause.downcast_ref::<FfiError>() {
+                return Self::from(*err);
+            }
+            if let Some(VaultError::AeadAesGcmDecrypt) = cause.downcast_ref::<VaultError>() {
+                return Self::from(FfiError::AeadAuthFailed);
+            }
+        }
+
         Self::new(
             err.code().origin as i32 * 10_000 + err.code().kind as i32,
-            "unknown",
+            OCKAM_DOMAIN,
         )
     }
 }
 
 impl From<FfiError> for FfiOckamError {
     fn from(err: FfiError) -> Self {
-        let err2: Error = err.into();
-        Self::from(err2)
+        Self::new(err.code(), FFI_DOMAIN)
     }
 }
 
 /// # Safety
-/// frees `FfiOckamError::domain` if it's non-null
+/// `FfiOckamError::domain` is static, this only clears it. Kept so that callers written
+/// against allocated domains keep working.
 #[no_mangle]
 pub unsafe extern "C" fn ockam_vault_free_error(context: &mut FfiOckamError) {
-    if !context.domain.is_null() {
-        let _ = CString::from_raw(context.domain as *mut _);
-        context.domain = core::ptr::null();
-    }
+    context.domain = core::ptr::null();
 }
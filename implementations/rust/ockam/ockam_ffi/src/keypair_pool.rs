@@ -0,0 +1,162 @@
+use crate::vault::block_on_current_thread;
+use crate::vault_types::SecretKeyHandle;
+use ockam_core::errcode::{Kind, Origin};
+use ockam_core::{Error, Result};
+use ockam_vault::{
+    EphemeralSecretsStore, KeyId, PublicKey, SecretAttributes, SecretsStoreReader, Vault,
+};
+use std::collections::HashMap;
+use std::sync::{Arc, Condvar, Mutex, MutexGuard, PoisonError};
+use std::thread;
+
+/// Ephemeral X25519 keypairs generated ahead of time, so that handshakes don't pay for the
+/// RNG and the scalar-base multiplication on their critical path.
+///
+/// The pool is disabled until a watermark is set. A background thread then keeps
+/// `watermark` keypairs ready in the vault and is woken up whenever one is taken. The public
+/// keys of the keypairs handed out are cached until their secret is destroyed.
+#[derive(Default)]
+pub(crate) struct KeypairPool {
+    state: Mutex<PoolState>,
+    refill: Condvar,
+    public_keys: Mutex<HashMap<SecretKeyHandle, PublicKey>>,
+}
+
+#[derive(Default)]
+struct PoolState {
+    keypairs: Vec<(KeyId, PublicKey)>,
+    watermark: usize,
+    refilling: bool,
+    stopped: bool,
+}
+
+impl KeypairPool {
+    /// Set the number of keypairs to keep ready, `0` disables the pool and deletes the
+    /// keypairs it holds
+    pub(crate) fn set_watermark(self: &Arc<Self>, vault: &Vault, watermark: usize) -> Result<()> {
+        let discarded = {
+            let mut state = self.lock_state();
+            if state.stopped {
+                return Ok(());
+            }
+
+            state.watermark = watermark;
+            if watermark > 0 && !state.refilling {
+                let pool = self.clone();
+                let vault = vault.clone();
+                thread::Builder::new()
+                    .name("ockam-keypair-pool".into())
+                    .spawn(move || pool.refill(vault))
+                    .map_err(|err| Error::new(Origin::Other, Kind::ResourceExhausted, err))?;
+                state.refilling = true;
+            }
+            self.refill.notify_one();
+
+            let keep = state.keypairs.len().min(watermark);
+            state.keypairs.split_off(keep)
+        };
+
+        delete_keypairs(vault, discarded);
+        Ok(())
+    }
+
+    /// Take a ready keypair, if any
+    pub(crate) fn pop(&self) -> Option<(KeyId, PublicKey)> {
+        let mut state = self.lock_state();
+        let keypair = state.keypairs.pop();
+        if keypair.is_some() {
+            self.refill.notify_one();
+        }
+        keypair
+    }
+
+    /// Stop refilling and delete the ready keypairs, called when the vault is deinitialized
+    pub(crate) fn stop(&self, vault: &Vault) {
+        let discarded = {
+            let mut state = self.lock_state();
+            state.stopped = true;
+            self.refill.notify_one();
+            core::mem::take(&mut state.keypairs)
+        };
+
+        delete_keypairs(vault, discarded);
+    }
+
+    pub(crate) fn cache_public_key(&self, secret: SecretKeyHandle, public_key: PublicKey) {
+        self.lock_public_keys().insert(secret, public_key);
+    }
+
+    pub(crate) fn public_key(&self, secret: SecretKeyHandle) -> Option<PublicKey> {
+        self.lock_public_keys().get(&secret).cloned()
+    }
+
+    pub(crate) fn forget_public_key(&self, secret: SecretKeyHandle) {
+        self.lock_public_keys().remove(&secret);
+    }
+
+    fn refill(&self, vault: Vault) {
+        loop {
+            {
+                let mut state = self.lock_state();
+                while !state.stopped && state.keypairs.len() >= state.watermark {
+                    state = self
+                        .refill
+                        .wait(state)
+                        .unwrap_or_else(PoisonError::into_inner);
+                }
+                if state.stopped {
+                    return;
+                }
+            }
+
+            let keypair = match block_on_current_thread(generate_keypair(&vault)) {
+                Ok(keypair) => keypair,
+                Err(_) => {
+                    // Callers fall back to generating their keys, enabling the pool again
+                    // restarts the refill
+                    self.lock_state().refilling = false;
+                    return;
+                }
+            };
+
+            let mut state = self.lock_state();
+            if state.stopped {
+                drop(state);
+                delete_keypairs(&vault, vec![keypair]);
+                return;
+            }
+            state.keypairs.push(keypair);
+        }
+    }
+
+    fn lock_state(&self) -> MutexGuard<'_, PoolState> {
+        self.state.lock().unwrap_or_else(PoisonError::into_inner)
+    }
+
+    fn lock_public_keys(&self) -> MutexGuard<'_, HashMap<SecretKeyHandle, PublicKey>> {
+        self.public_keys
+            .lock()
+            .unwrap_or_else(PoisonError::into_inner)
+    }
+}
+
+async fn generate_keypair(vault: &Vault) -> Result<(KeyId, PublicKey)> {
+    let key_id = vault
+        .create_ephemeral_secret(SecretAttributes::X25519)
+        .await?;
+    let public_key = vault.get_public_key(&key_id).await?;
+    Ok((key_id, public_key))
+}
+
+fn delete_keypairs(vault: &Vault, keypairs: Vec<(KeyId, PublicKey)>) {
+    if keypairs.is_empty() {
+        return;
+    }
+
+    let _ = block_on_current_thread(async {
+        for (key_id, _) in keypairs {
+            vault.delete_ephemeral_secret(key_id).await?;
+        }
+        Ok::<(), Error>(())
+    });
+}
@@ -0,0 +1,118 @@
+//! Per-call latency of the FFI entry points, with and without the async runtime.
+//!
+//! Run with `cargo test --release -p ockam-ffi latency -- --ignored --nocapture`
+
+use crate::vault_types::{FfiSecretAttributes, FfiVaultFatPointer, SecretKeyHandle};
+use crate::*;
+use core::sync::atomic::Ordering;
+use std::time::Instant;
+
+const ITERATIONS: u32 = 100_000;
+
+fn measure<F: FnMut()>(name: &str, mut f: F) {
+    // Warm up caches, the lazy runtime and the vault maps
+    for _ in 0..ITERATIONS / 10 {
+        f();
+    }
+
+    let start = Instant::now();
+    for _ in 0..ITERATIONS {
+        f();
+    }
+    let elapsed = start.elapsed();
+
+    println!(
+        "{:<48} {:>10.0} ns/call",
+        name,
+        elapsed.as_nanos() as f64 / ITERATIONS as f64
+    );
+}
+
+fn set_async_runtime(enabled: bool) {
+    assert_eq!(
+        ockam_vault_set_async_runtime(enabled),
+        FfiOckamError::none()
+    );
+}
+
+#[test]
+#[ignore]
+fn latency() {
+    let mut vault = FfiVaultFatPointer::new(0, crate::vault_types::FfiVaultType::Software);
+    assert_eq!(ockam_vault_default_init(&mut vault), FfiOckamError::none());
+
+    let mut key: SecretKeyHandle = 0;
+    assert_eq!(
+        ockam_vault_secret_generate(vault, &mut key, FfiSecretAttributes::new(1, 32)),
+        FfiOckamError::none()
+    );
+
+    measure("block_future (runtime)", || {
+        crate::vault::block_future(async {});
+    });
+    measure("block_on_current_thread", || {
+        crate::vault::block_on_current_thread(async {});
+    });
+
+    for enabled in [true, false] {
+        set_async_runtime(enabled);
+        assert_eq!(
+            crate::vault::ASYNC_RUNTIME_ENABLED.load(Ordering::Relaxed),
+            enabled
+        );
+
+        let mode = if enabled { "runtime" } else { "no runtime" };
+
+        let mut attributes = FfiSecretAttributes::new(0, 0);
+        measure(
+            &format!("ockam_vault_secret_attributes_get ({})", mode),
+            || {
+                assert_eq!(
+                    ockam_vault_secret_attributes_get(vault, key, &mut attributes),
+                    FfiOckamError::none()
+                );
+            },
+        );
+    }
+
+    set_async_runtime(true);
+
+    let input = [0u8; 64];
+    let mut digest = [0u8; 32];
+    measure("ockam_vault_sha256 64 bytes (sync path)", || {
+        assert_eq!(
+            ockam_vault_sha256(
+                vault,
+                input.as_ptr(),
+                input.len() as u32,
+                digest.as_mut_ptr()
+            ),
+            FfiOckamError::none()
+        );
+    });
+
+    let mut cipher_text = [0u8; 64 + 16];
+    let mut length = 0u32;
+    measure(
+        "ockam_vault_aead_aes_gcm_encrypt 64 bytes (sync path)",
+        || {
+            assert_eq!(
+                ockam_vault_aead_aes_gcm_encrypt(
+                    vault,
+                    key,
+                    1,
+                    input.as_ptr(),
+                    0,
+                    input.as_ptr(),
+                    input.len() as u32,
+                    &mut cipher_text[0],
+                    cipher_text.len() as u32,
+                    &mut length
+                ),
+                FfiOckamError::none()
+            );
+        },
+    );
+
+    assert_eq!(ockam_vault_deinit(vault), FfiOckamError::none());
+}
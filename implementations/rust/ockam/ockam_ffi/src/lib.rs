@@ -12,10 +12,19 @@
 )]
 #![allow(clippy::not_unsafe_ptr_arg_deref)]
 
+mod aead_stream;
+mod aes_cache;
+mod backend;
 mod error;
+mod keypair_pool;
+#[cfg(test)]
+mod latency_bench;
 mod macros;
+mod secrets_mapping;
 mod vault;
+mod vault_registry;
 mod vault_types;
+mod worker_pool;
 
 pub use error::*;
 pub use vault::*;
@@ -0,0 +1,377 @@
+use crate::FfiError;
+use core::cell::UnsafeCell;
+use core::mem::MaybeUninit;
+use core::ops::Deref;
+use core::ptr;
+use core::sync::atomic::{AtomicPtr, AtomicU32, AtomicU64, Ordering};
+use ockam_core::Result;
+use ockam_vault::KeyId;
+
+/// Number of slots allocated at once. Segments are never moved nor freed before the
+/// mapping is dropped, so a slot reference stays valid without holding any lock.
+const SEGMENT_SIZE: usize = 1024;
+const MAX_SEGMENTS: usize = 4096;
+
+/// Marks an empty free list, slot indexes are stored shifted by one
+const EMPTY: u32 = 0;
+
+/// Generational slab mapping FFI secret handles to vault [`KeyId`]s.
+///
+/// A handle is `generation << 32 | index`. The generation of a slot is odd while it holds
+/// a secret and is bumped on every insertion and removal, so a handle to a destroyed
+/// secret is rejected even once its slot is reused. Lookups are lock-free: a reader pins
+/// the slot, checks its generation and borrows the [`KeyId`] in place.
+pub(crate) struct SecretsMapping {
+    segments: [AtomicPtr<Slot>; MAX_SEGMENTS],
+    /// Number of slots handed out so far, free slots are recycled first
+    len: AtomicU32,
+    /// Treiber stack of free slots: `tag << 32 | (index + 1)`, the tag avoids ABA
+    free_head: AtomicU64,
+    /// Number of secrets currently mapped, for monitoring
+    live: AtomicU32,
+}
+
+struct Slot {
+    generation: AtomicU32,
+    pins: AtomicU32,
+    next_free: AtomicU32,
+    key_id: UnsafeCell<MaybeUninit<KeyId>>,
+}
+
+// Access to `key_id` is synchronized by the generation and pin counters
+unsafe impl Send for SecretsMapping {}
+unsafe impl Sync for SecretsMapping {}
+
+/// A [`KeyId`] borrowed from the mapping, its secret can't be removed until the guard is dropped
+pub(crate) struct KeyIdGuard<'a> {
+    slot: &'a Slot,
+}
+
+impl Deref for KeyIdGuard<'_> {
+    type Target = KeyId;
+
+    fn deref(&self) -> &KeyId {
+        unsafe { (*self.slot.key_id.get()).assume_init_ref() }
+    }
+}
+
+impl Drop for KeyIdGuard<'_> {
+    fn drop(&mut self) {
+        self.slot.pins.fetch_sub(1, Ordering::Release);
+    }
+}
+
+impl Default for SecretsMapping {
+    fn default() -> Self {
+        Self {
+            segments: [(); MAX_SEGMENTS].map(|_| AtomicPtr::new(ptr::null_mut())),
+            len: AtomicU32::new(0),
+            free_head: AtomicU64::new(EMPTY as u64),
+            live: AtomicU32::new(0),
+        }
+    }
+}
+
+impl SecretsMapping {
+    pub(crate) fn insert(&self, key_id: KeyId) -> Result<u64> {
+        let index = match self.pop_free() {
+            Some(index) => index,
+            None => self.grow()?,
+        };
+
+        // The slot is vacant and owned by this thread until its generation is published
+        let slot = self.slot(index).ok_or(FfiError::EntryNotFound)?;
+        unsafe { (*slot.key_id.get()).write(key_id) };
+        let generation = slot.generation.load(Ordering::Relaxed).wrapping_add(1);
+        slot.generation.store(generation, Ordering::SeqCst);
+        self.live.fetch_add(1, Ordering::Relaxed);
+
+        Ok(((generation as u64) << 32) | index as u64)
+    }
+
+    pub(crate) fn get(&self, handle: u64) -> Result<KeyIdGuard<'_>> {
+        let (index, generation) = split(handle);
+        let slot = self.slot(index).ok_or(FfiError::EntryNotFound)?;
+
+        slot.pins.fetch_add(1, Ordering::SeqCst);
+        let guard = KeyIdGuard { slot };
+
+        if slot.generation.load(Ordering::SeqCst) != generation || !is_occupied(generation) {
+            return Err(FfiError::EntryNotFound.into());
+        }
+
+        Ok(guard)
+    }
+
+    pub(crate) fn take(&self, handle: u64) -> Result<KeyId> {
+        let (index, generation) = split(handle);
+        let slot = self.slot(index).ok_or(FfiError::EntryNotFound)?;
+
+        if !is_occupied(generation)
+            || slot
+                .generation
+                .compare_exchange(
+                    generation,
+                    generation.wrapping_add(1),
+                    Ordering::SeqCst,
+                    Ordering::Relaxed,
+                )
+                .is_err()
+        {
+            return Err(FfiError::EntryNotFound.into());
+        }
+
+        // New readers now fail the generation check, wait for the ones already borrowing it
+        while slot.pins.load(Ordering::SeqCst) != 0 {
+            std::thread::yield_now();
+        }
+
+        let key_id = unsafe { (*slot.key_id.get()).assume_init_read() };
+        self.push_free(index);
+        self.live.fetch_sub(1, Ordering::Relaxed);
+
+        Ok(key_id)
+    }
+
+    /// Number of secrets currently mapped
+    pub(crate) fn live(&self) -> u64 {
+        self.live.load(Ordering::Relaxed) as u64
+    }
+
+    fn slot(&self, index: u32) -> Option<&Slot> {
+        let index = index as usize;
+        let segment = self
+            .segments
+            .get(index / SEGMENT_SIZE)?
+            .load(Ordering::Acquire);
+
+        if segment.is_null() || index >= self.len.load(Ordering::Acquire) as usize {
+            return None;
+        }
+
+        Some(unsafe { &*segment.add(index % SEGMENT_SIZE) })
+    }
+
+    fn grow(&self) -> Result<u32> {
+        let mut index = self.len.load(Ordering::Relaxed);
+        loop {
+            if index as usize >= SEGMENT_SIZE * MAX_SEGMENTS {
+                return Err(FfiError::TooManySecrets.into());
+            }
+
+            self.allocate_segment(index as usize / SEGMENT_SIZE);
+
+            // Another thread may have taken this index meanwhile, then retry with the next one
+            match self.len.compare_exchange_weak(
+                index,
+                index + 1,
+                Ordering::AcqRel,
+                Ordering::Relaxed,
+            ) {
+                Ok(_) => return Ok(index),
+                Err(current) => index = current,
+            }
+        }
+    }
+
+    fn allocate_segment(&self, segment_index: usize) {
+        let segment = &self.segments[segment_index];
+        if !segment.load(Ordering::Acquire).is_null() {
+            return;
+        }
+
+        let slots: Box<[Slot]> = (0..SEGMENT_SIZE)
+            .map(|_| Slot {
+                generation: AtomicU32::new(0),
+                pins: AtomicU32::new(0),
+                next_free: AtomicU32::new(EMPTY),
+                key_id: UnsafeCell::new(MaybeUninit::uninit()),
+            })
+            .collect();
+        let slots = Box::into_raw(slots) as *mut Slot;
+
+        if segment
+            .compare_exchange(ptr::null_mut(), slots, Ordering::AcqRel, Ordering::Acquire)
+            .is_err()
+        {
+            drop(unsafe { Box::from_raw(ptr::slice_from_raw_parts_mut(slots, SEGMENT_SIZE)) });
+        }
+    }
+
+    fn pop_free(&self) -> Option<u32> {
+        let mut head = self.free_head.load(Ordering::Acquire);
+        loop {
+            let (tag, first) = ((head >> 32) as u32, head as u32);
+            if first == EMPTY {
+                return None;
+            }
+
+            let next = self.slot(first - 1)?.next_free.load(Ordering::Relaxed);
+            let new_head = ((tag.wrapping_add(1) as u64) << 32) | next as u64;
+
+            match self.free_head.compare_exchange_weak(
+                head,
+                new_head,
+                Ordering::AcqRel,
+                Ordering::Acquire,
+            ) {
+                Ok(_) => return Some(first - 1),
+                Err(current) => head = current,
+            }
+        }
+    }
+
+    fn push_free(&self, index: u32) {
+        let slot = match self.slot(index) {
+            Some(slot) => slot,
+            None => return,
+        };
+
+        let mut head = self.free_head.load(Ordering::Acquire);
+        loop {
+            let tag = (head >> 32) as u32;
+            slot.next_free.store(head as u32, Ordering::Relaxed);
+            let new_head = ((tag.wrapping_add(1) as u64) << 32) | (index + 1) as u64;
+
+            match self.free_head.compare_exchange_weak(
+                head,
+                new_head,
+                Ordering::AcqRel,
+                Ordering::Acquire,
+            ) {
+                Ok(_) => return,
+                Err(current) => head = current,
+            }
+        }
+    }
+}
+
+impl Drop for SecretsMapping {
+    fn drop(&mut self) {
+        let len = *self.len.get_mut() as usize;
+        for (i, segment) in self.segments.iter_mut().enumerate() {
+            let segment = *segment.get_mut();
+            if segment.is_null() {
+                break;
+            }
+
+            let slots =
+                unsafe { Box::from_raw(ptr::slice_from_raw_parts_mut(segment, SEGMENT_SIZE)) };
+            for (j, slot) in slots.iter().enumerate() {
+                let occupied = is_occupied(slot.generation.load(Ordering::Relaxed));
+                if i * SEGMENT_SIZE + j < len && occupied {
+                    unsafe { (*slot.key_id.get()).assume_init_drop() };
+                }
+            }
+        }
+    }
+}
+
+fn split(handle: u64) -> (u32, u32) {
+    (handle as u32, (handle >> 32) as u32)
+}
+
+fn is_occupied(generation: u32) -> bool {
+    generation % 2 == 1
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use std::sync::atomic::AtomicBool;
+    use std::sync::Arc;
+    use std::thread;
+
+    fn key_id(value: &str) -> KeyId {
+        value.into()
+    }
+
+    #[test]
+    fn stale_handle_is_rejected_after_its_slot_is_reused() {
+        let mapping = SecretsMapping::default();
+
+        let destroyed = mapping.insert(key_id("destroyed")).unwrap();
+        assert_eq!(mapping.take(destroyed).unwrap(), key_id("destroyed"));
+
+        let reused = mapping.insert(key_id("reused")).unwrap();
+        assert_eq!(split(reused).0, split(destroyed).0);
+        assert_ne!(reused, destroyed);
+
+        assert!(mapping.get(destroyed).is_err());
+        assert!(mapping.take(destroyed).is_err());
+        assert_eq!(*mapping.get(reused).unwrap(), key_id("reused"));
+        assert_eq!(mapping.live(), 1);
+    }
+
+    #[test]
+    fn unknown_and_vacant_handles_are_rejected() {
+        let mapping = SecretsMapping::default();
+        assert!(mapping.get(0).is_err());
+        assert!(mapping.take(1 << 32).is_err());
+
+        let handle = mapping.insert(key_id("key")).unwrap();
+        assert!(mapping.get(handle + 1).is_err());
+        assert!(mapping.get(handle + (1 << 32)).is_err());
+
+        assert_eq!(mapping.take(handle).unwrap(), key_id("key"));
+        assert!(mapping.take(handle).is_err());
+        assert_eq!(mapping.live(), 0);
+    }
+
+    #[test]
+    fn concurrent_get_take_and_insert() {
+        const WRITERS: usize = 8;
+        const ROUNDS: usize = 20_000;
+
+        let mapping = Arc::new(SecretsMapping::default());
+        // The handle each writer currently holds, readers check it only ever resolves to
+        // that writer's secrets, even while the slot is destroyed and reused by another writer
+        let published: Arc<Vec<AtomicU64>> =
+            Arc::new((0..WRITERS).map(|_| AtomicU64::new(u64::MAX)).collect());
+        let done = Arc::new(AtomicBool::new(false));
+
+        let readers: Vec<_> = (0..4)
+            .map(|_| {
+                let (mapping, published, done) = (mapping.clone(), published.clone(), done.clone());
+                thread::spawn(move || {
+                    while !done.load(Ordering::Relaxed) {
+                        for (writer, handle) in published.iter().enumerate() {
+                            if let Ok(key_id) = mapping.get(handle.load(Ordering::Acquire)) {
+                                assert!(key_id.starts_with(&format!("{}-", writer)));
+                            }
+                        }
+                    }
+                })
+            })
+            .collect();
+
+        let writers: Vec<_> = (0..WRITERS)
+            .map(|writer| {
+                let (mapping, published) = (mapping.clone(), published.clone());
+                thread::spawn(move || {
+                    for round in 0..ROUNDS {
+                        let expected = key_id(&format!("{}-{}", writer, round));
+                        let handle = mapping.insert(expected.clone()).unwrap();
+                        published[writer].store(handle, Ordering::Release);
+
+                        assert_eq!(*mapping.get(handle).unwrap(), expected);
+                        assert_eq!(mapping.take(handle).unwrap(), expected);
+                        assert!(mapping.get(handle).is_err());
+                    }
+                })
+            })
+            .collect();
+
+        for writer in writers {
+            writer.join().unwrap();
+        }
+        done.store(true, Ordering::Relaxed);
+        for reader in readers {
+            reader.join().unwrap();
+        }
+
+        assert_eq!(mapping.live(), 0);
+        // Destroyed slots are reused, so the slab never grows past one slot per writer
+        assert!(mapping.len.load(Ordering::Relaxed) as usize <= WRITERS);
+    }
+}
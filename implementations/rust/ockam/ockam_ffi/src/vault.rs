@@ -1,77 +1,80 @@
-use crate::vault_types::{FfiSecretAttributes, SecretKeyHandle};
+use crate::aead_stream::AeadStream;
+use crate::aes_cache::AesCache;
+use crate::backend;
+use crate::keypair_pool::KeypairPool;
+use crate::secrets_mapping::{KeyIdGuard, SecretsMapping};
+use crate::vault_registry::VaultRegistry;
+use crate::vault_types::{
+    FfiAeadMessage, FfiBackendInfo, FfiBuffer, FfiEcdhRequest, FfiSecretAttributes, SecretKeyHandle,
+};
+use crate::worker_pool::WorkerPool;
 use crate::{check_buffer, FfiError, FfiOckamError};
 use crate::{FfiVaultFatPointer, FfiVaultType};
+use chacha20poly1305::aead::{AeadInPlace, NewAead};
+use chacha20poly1305::{ChaCha20Poly1305, Key, Nonce, Tag};
+use core::sync::atomic::{AtomicBool, AtomicI32, AtomicU64, Ordering};
 use core::{future::Future, result::Result as StdResult, slice};
-use futures::future::join_all;
 use lazy_static::lazy_static;
-use ockam_core::compat::collections::BTreeMap;
 use ockam_core::compat::sync::Arc;
 use ockam_core::{Error, Result};
-use ockam_vault::{AsymmetricVault, KeyId, PublicKey, Secret, SecretAttributes, SymmetricVault};
-use ockam_vault::{EphemeralSecretsStore, SecretsStoreReader, Vault};
-use tokio::{runtime::Runtime, sync::RwLock, task};
-
-#[derive(Default)]
-struct SecretsMapping {
-    mapping: BTreeMap<u64, KeyId>,
-    last_index: u64,
-}
-
-impl SecretsMapping {
-    fn insert(&mut self, key_id: KeyId) -> u64 {
-        self.last_index += 1;
-
-        self.mapping.insert(self.last_index, key_id);
-
-        self.last_index
-    }
-
-    fn get(&self, index: u64) -> Result<KeyId> {
-        Ok(self
-            .mapping
-            .get(&index)
-            .cloned()
-            .ok_or(FfiError::EntryNotFound)?)
-    }
-
-    fn take(&mut self, index: u64) -> Result<KeyId> {
-        Ok(self.mapping.remove(&index).ok_or(FfiError::EntryNotFound)?)
-    }
-}
+use ockam_vault::constants::AES_GCM_TAG_LENGTH_USIZE;
+use ockam_vault::{AesGen, AsymmetricVault, KeyId, PublicKey, Secret, SecretAttributes};
+use ockam_vault::{EphemeralSecretsStore, SecretsStoreReader, StoredSecret, Vault};
+use sha2::{Digest, Sha256};
+use tokio::{runtime::Runtime, task};
 
 #[derive(Clone, Default)]
 struct VaultEntry {
     vault: Vault,
-    secrets_mapping: Arc<RwLock<SecretsMapping>>,
+    secrets_mapping: Arc<SecretsMapping>,
+    keypair_pool: Arc<KeypairPool>,
+    aes_cache: Arc<AesCache>,
 }
 
 impl VaultEntry {
-    async fn insert(&self, key_id: KeyId) -> u64 {
-        self.secrets_mapping.write().await.insert(key_id)
+    fn insert(&self, key_id: KeyId) -> Result<u64> {
+        self.secrets_mapping.insert(key_id)
     }
 
-    async fn get(&self, index: u64) -> Result<KeyId> {
-        self.secrets_mapping.read().await.get(index)
+    fn get(&self, index: u64) -> Result<KeyIdGuard<'_>> {
+        self.secrets_mapping.get(index)
     }
 
-    async fn take(&self, index: u64) -> Result<KeyId> {
-        self.secrets_mapping.write().await.take(index)
+    fn take(&self, index: u64) -> Result<KeyId> {
+        self.secrets_mapping.take(index)
+    }
+
+    /// Delete a secret taken from the mapping, along with its cached cipher
+    async fn delete(&self, key_id: KeyId) -> Result<bool> {
+        self.aes_cache.remove(&key_id);
+        self.vault.delete_ephemeral_secret(key_id).await
     }
 }
 
 lazy_static! {
-    static ref SOFTWARE_VAULTS: RwLock<Vec<VaultEntry>> = RwLock::new(vec![]);
+    static ref SOFTWARE_VAULTS: VaultRegistry<VaultEntry> = VaultRegistry::new();
     static ref RUNTIME: Arc<Runtime> = Arc::new(Runtime::new().unwrap());
+    /// Runs the batched operations, with the calling thread taking a share of each batch
+    static ref WORKER_POOL: WorkerPool = WorkerPool::new(
+        std::thread::available_parallelism().map_or(1, |threads| threads.get()) - 1
+    );
 }
 
 fn get_runtime() -> Arc<Runtime> {
     RUNTIME.clone()
 }
 
-fn block_future<F>(f: F) -> <F as Future>::Output
+/// When cleared, futures are polled on the calling thread and the runtime is never started
+pub(crate) static ASYNC_RUNTIME_ENABLED: AtomicBool = AtomicBool::new(true);
+
+pub(crate) fn block_future<F>(f: F) -> <F as Future>::Output
 where
     F: Future,
 {
+    if !ASYNC_RUNTIME_ENABLED.load(Ordering::Relaxed) {
+        return block_on_current_thread(f);
+    }
+
     let rt = get_runtime();
     task::block_in_place(move || {
         let local = task::LocalSet::new();
@@ -79,38 +82,83 @@ where
     })
 }
 
+/// Poll a future to completion on the calling thread, without entering the runtime.
+/// Used for CPU-only operations on software vaults, which never wait on I/O, so their
+/// futures only ever park on the vault locks.
+pub(crate) fn block_on_current_thread<F>(f: F) -> <F as Future>::Output
+where
+    F: Future,
+{
+    futures::executor::block_on(f)
+}
+
 async fn get_vault_entry(context: FfiVaultFatPointer) -> Result<VaultEntry> {
     match context.vault_type() {
         FfiVaultType::Software => {
-            let item = SOFTWARE_VAULTS
-                .read()
-                .await
-                .get(context.handle() as usize)
-                .ok_or(FfiError::VaultNotFound)?
-                .clone();
+            let item = SOFTWARE_VAULTS.get(context.handle())?;
 
             Ok(item)
         }
     }
 }
 
+/// Enable or disable the Tokio runtime used to run vault operations.
+/// When disabled, every operation runs on the calling thread and the runtime worker
+/// threads are never started. Call it before any other vault function to avoid
+/// starting the runtime at all.
+#[no_mangle]
+pub extern "C" fn ockam_vault_set_async_runtime(enabled: bool) -> FfiOckamError {
+    ASYNC_RUNTIME_ENABLED.store(enabled, Ordering::Relaxed);
+    FfiOckamError::none()
+}
+
 /// Create and return a default Ockam Vault.
 #[no_mangle]
 pub extern "C" fn ockam_vault_default_init(context: &mut FfiVaultFatPointer) -> FfiOckamError {
     handle_panics(|| {
         // TODO: handle logging
-        let handle = block_future(async move {
-            let mut write_lock = SOFTWARE_VAULTS.write().await;
-            write_lock.push(Default::default());
-            write_lock.len() - 1
-        });
+        let handle = SOFTWARE_VAULTS.insert(Default::default())?;
 
-        *context = FfiVaultFatPointer::new(handle as u64, FfiVaultType::Software);
+        *context = FfiVaultFatPointer::new(handle, FfiVaultType::Software);
 
         Ok(())
     })
 }
 
+/// Create and return a default Ockam Vault registered in the shard picked by `affinity`.
+/// Vaults created with the same affinity, e.g. the id of the calling scheduler thread,
+/// share a registry lock which vaults with other affinities never contend on.
+#[no_mangle]
+pub extern "C" fn ockam_vault_default_init_with_affinity(
+    context: &mut FfiVaultFatPointer,
+    affinity: u32,
+) -> FfiOckamError {
+    handle_panics(|| {
+        let handle = SOFTWARE_VAULTS.insert_with_affinity(Default::default(), affinity as usize)?;
+
+        *context = FfiVaultFatPointer::new(handle, FfiVaultType::Software);
+
+        Ok(())
+    })
+}
+
+/// Keep `watermark` ephemeral X25519 keypairs pre-generated in the vault by a background
+/// thread. `ockam_vault_secret_generate` then hands out a ready keypair, whose public key
+/// is cached, instead of generating one on the calling thread. A `watermark` of 0 stops the
+/// refill and destroys the keypairs still pooled.
+#[no_mangle]
+pub extern "C" fn ockam_vault_set_keypair_pool_watermark(
+    context: FfiVaultFatPointer,
+    watermark: u32,
+) -> FfiOckamError {
+    handle_panics(|| {
+        let entry = block_on_current_thread(get_vault_entry(context))?;
+        entry
+            .keypair_pool
+            .set_watermark(&entry.vault, watermark as usize)
+    })
+}
+
 /// Compute the SHA-256 hash on `input` and put the result in `digest`.
 /// `digest` must be 32 bytes in length.
 #[no_mangle]
@@ -126,7 +174,7 @@ pub extern "C" fn ockam_vault_sha256(
 
         let input = unsafe { core::slice::from_raw_parts(input, input_length as usize) };
 
-        let res = block_future(async move {
+        let res = block_on_current_thread(async move {
             let entry = get_vault_entry(context).await?;
             Ok::<[u8; 32], Error>(entry.vault.compute_sha256(input))
         })?;
@@ -138,6 +186,198 @@ pub extern "C" fn ockam_vault_sha256(
     })
 }
 
+/// Compute the SHA-256 hash of each of `inputs` and put the results one after the other in
+/// `digests`, which must be `32 * inputs_count` bytes in length.
+///
+/// `sha2` has no multi-buffer kernel, each input goes through the SHA-NI / ARMv8 compression
+/// when the CPU has it. Many small inputs are hashed at the cost of a single call.
+#[no_mangle]
+pub extern "C" fn ockam_vault_sha256_many(
+    context: FfiVaultFatPointer,
+    inputs: *const FfiBuffer,
+    inputs_count: u32,
+    digests: *mut u8,
+) -> FfiOckamError {
+    handle_panics(|| {
+        check_buffer!(inputs);
+        check_buffer!(digests);
+
+        let inputs = unsafe { slice::from_raw_parts(inputs, inputs_count as usize) };
+        let digests = unsafe { slice::from_raw_parts_mut(digests, 32 * inputs_count as usize) };
+
+        let entry = block_on_current_thread(get_vault_entry(context))?;
+
+        for (input, digest) in inputs.iter().zip(digests.chunks_exact_mut(32)) {
+            digest.copy_from_slice(&entry.vault.compute_sha256(input.data()?));
+        }
+        Ok(())
+    })
+}
+
+/// Streaming SHA-256 state, opaque to C callers
+pub struct FfiSha256Context(Sha256);
+
+/// Create a streaming SHA-256 context, to be freed with `ockam_vault_sha256_free`.
+#[no_mangle]
+pub extern "C" fn ockam_vault_sha256_init(context: &mut *mut FfiSha256Context) -> FfiOckamError {
+    handle_panics(|| {
+        *context = Box::into_raw(Box::new(FfiSha256Context(Sha256::new())));
+        Ok(())
+    })
+}
+
+/// Absorb `input` into a streaming SHA-256 context.
+#[no_mangle]
+pub extern "C" fn ockam_vault_sha256_update(
+    context: *mut FfiSha256Context,
+    input: *const u8,
+    input_length: u32,
+) -> FfiOckamError {
+    handle_panics(|| {
+        check_buffer!(context);
+        check_buffer!(input);
+
+        let context = unsafe { &mut *context };
+        let input = unsafe { slice::from_raw_parts(input, input_length as usize) };
+        context.0.update(input);
+        Ok(())
+    })
+}
+
+/// Put the SHA-256 of everything absorbed so far in `digest`, which must be 32 bytes in
+/// length. The context is left untouched and can keep absorbing input.
+#[no_mangle]
+pub extern "C" fn ockam_vault_sha256_final(
+    context: *const FfiSha256Context,
+    digest: *mut u8,
+) -> FfiOckamError {
+    handle_panics(|| {
+        check_buffer!(context);
+        check_buffer!(digest);
+
+        let context = unsafe { &*context };
+        let res = context.0.clone().finalize();
+
+        unsafe {
+            std::ptr::copy_nonoverlapping(res.as_ptr(), digest, res.len());
+        }
+        Ok(())
+    })
+}
+
+/// Copy a streaming SHA-256 context, e.g. to hash several continuations of a common prefix.
+#[no_mangle]
+pub extern "C" fn ockam_vault_sha256_clone(
+    context: *const FfiSha256Context,
+    clone: &mut *mut FfiSha256Context,
+) -> FfiOckamError {
+    handle_panics(|| {
+        check_buffer!(context);
+
+        let context = unsafe { &*context };
+        *clone = Box::into_raw(Box::new(FfiSha256Context(context.0.clone())));
+        Ok(())
+    })
+}
+
+/// Free a streaming SHA-256 context.
+#[no_mangle]
+pub extern "C" fn ockam_vault_sha256_free(context: *mut FfiSha256Context) -> FfiOckamError {
+    handle_panics(|| {
+        check_buffer!(context);
+
+        drop(unsafe { Box::from_raw(context) });
+        Ok(())
+    })
+}
+
+/// Chunked AES-GCM stream state, opaque to C callers
+pub struct FfiAeadStream(AeadStream);
+
+/// Start encrypting, or decrypting when `encrypt` is 0, a payload in chunks with a key
+/// derived from the AES key `secret` and the nonce prefix, so the chunks never share a key
+/// and nonce with the per-message AEAD functions. `nonce_prefix` must be 7 bytes and must
+/// never be reused with the same key.
+/// The stream must be freed with `ockam_vault_aead_aes_gcm_stream_free`.
+#[no_mangle]
+pub extern "C" fn ockam_vault_aead_aes_gcm_stream_init(
+    context: FfiVaultFatPointer,
+    secret: SecretKeyHandle,
+    encrypt: u8,
+    nonce_prefix: *const u8,
+    nonce_prefix_length: u32,
+    stream: &mut *mut FfiAeadStream,
+) -> FfiOckamError {
+    handle_panics(|| {
+        check_buffer!(nonce_prefix, nonce_prefix_length);
+
+        let nonce_prefix =
+            unsafe { slice::from_raw_parts(nonce_prefix, nonce_prefix_length as usize) };
+
+        let key = block_on_current_thread(get_aes_key(context, secret))?;
+        let state = AeadStream::new(key.secret().as_ref(), encrypt != 0, nonce_prefix)?;
+
+        *stream = Box::into_raw(Box::new(FfiAeadStream(state)));
+        Ok(())
+    })
+}
+
+/// Encrypt or decrypt the next chunk of a stream. `last` must be non-zero for the last
+/// chunk only, no chunk is accepted after it. A ciphertext chunk is followed by its 16 bytes
+/// tag, `output_size` must be the input length plus 16 when encrypting and minus 16 when
+/// decrypting. A chunk which fails to authenticate ends the stream.
+#[no_mangle]
+pub extern "C" fn ockam_vault_aead_aes_gcm_stream_update(
+    stream: *mut FfiAeadStream,
+    additional_data: *const u8,
+    additional_data_length: u32,
+    input: *const u8,
+    input_length: u32,
+    last: u8,
+    output: *mut u8,
+    output_size: u32,
+    output_length: &mut u32,
+) -> FfiOckamError {
+    *output_length = 0;
+    handle_panics(|| {
+        check_buffer!(stream);
+        check_buffer!(additional_data);
+        check_buffer!(input);
+        check_buffer!(output);
+
+        let stream = unsafe { &mut *stream };
+        let additional_data =
+            unsafe { slice::from_raw_parts(additional_data, additional_data_length as usize) };
+        let input = unsafe { slice::from_raw_parts(input, input_length as usize) };
+
+        let length = stream.0.output_length(input.len())?;
+        if (output_size as usize) < length {
+            return Err(FfiError::BufferTooSmall.into());
+        }
+        let output = unsafe { slice::from_raw_parts_mut(output, length) };
+
+        stream
+            .0
+            .next_chunk(additional_data, input, last != 0, output)?;
+
+        *output_length = length as u32;
+        Ok(())
+    })
+}
+
+/// Free a chunked AES-GCM stream.
+#[no_mangle]
+pub extern "C" fn ockam_vault_aead_aes_gcm_stream_free(
+    stream: *mut FfiAeadStream,
+) -> FfiOckamError {
+    handle_panics(|| {
+        check_buffer!(stream);
+
+        drop(unsafe { Box::from_raw(stream) });
+        Ok(())
+    })
+}
+
 /// Generate a secret key with the specific attributes.
 /// Returns a handle for the secret.
 #[no_mangle]
@@ -150,9 +390,18 @@ pub extern "C" fn ockam_vault_secret_generate(
         *secret = block_future(async move {
             let entry = get_vault_entry(context).await?;
             let atts = attributes.try_into()?;
+
+            if atts == SecretAttributes::X25519 {
+                if let Some((key_id, public_key)) = entry.keypair_pool.pop() {
+                    let index = entry.insert(key_id)?;
+                    entry.keypair_pool.cache_public_key(index, public_key);
+                    return Ok::<u64, Error>(index);
+                }
+            }
+
             let key_id = entry.vault.create_ephemeral_secret(atts).await?;
 
-            let index = entry.insert(key_id).await;
+            let index = entry.insert(key_id)?;
 
             Ok::<u64, Error>(index)
         })?;
@@ -180,7 +429,7 @@ pub extern "C" fn ockam_vault_secret_import(
             let secret = Secret::new(secret_data.to_vec());
             let key_id = entry.vault.import_ephemeral_secret(secret, atts).await?;
 
-            let index = entry.insert(key_id).await;
+            let index = entry.insert(key_id)?;
 
             Ok::<u64, Error>(index)
         })?;
@@ -201,7 +450,7 @@ pub extern "C" fn ockam_vault_secret_export(
     handle_panics(|| {
         block_future(async move {
             let entry = get_vault_entry(context).await?;
-            let key_id = entry.get(secret).await?;
+            let key_id = entry.get(secret)?;
             let key = entry
                 .vault
                 .get_ephemeral_secret(&key_id, "secret from ffi")
@@ -234,8 +483,13 @@ pub extern "C" fn ockam_vault_secret_publickey_get(
     handle_panics(|| {
         block_future(async move {
             let entry = get_vault_entry(context).await?;
-            let key_id = entry.get(secret).await?;
-            let key = entry.vault.get_public_key(&key_id).await?;
+            let key = match entry.keypair_pool.public_key(secret) {
+                Some(key) => key,
+                None => {
+                    let key_id = entry.get(secret)?;
+                    entry.vault.get_public_key(&key_id).await?
+                }
+            };
             if output_buffer_size < key.data().len() as u32 {
                 return Err(FfiError::BufferTooSmall.into());
             }
@@ -260,7 +514,7 @@ pub extern "C" fn ockam_vault_secret_attributes_get(
     handle_panics(|| {
         *attributes = block_future(async move {
             let entry = get_vault_entry(context).await?;
-            let key_id = entry.get(secret).await?;
+            let key_id = entry.get(secret)?;
             let atts = entry.vault.get_secret_attributes(&key_id).await?;
             Ok::<FfiSecretAttributes, Error>(atts.into())
         })?;
@@ -276,8 +530,9 @@ pub extern "C" fn ockam_vault_secret_destroy(
 ) -> FfiOckamError {
     match block_future(async move {
         let entry = get_vault_entry(context).await?;
-        let key_id = entry.take(secret).await?;
-        entry.vault.delete_ephemeral_secret(key_id).await?;
+        let key_id = entry.take(secret)?;
+        entry.keypair_pool.forget_public_key(secret);
+        entry.delete(key_id).await?;
         Ok::<(), Error>(())
     }) {
         Ok(_) => FfiOckamError::none(),
@@ -301,19 +556,107 @@ pub extern "C" fn ockam_vault_ecdh(
         let peer_publickey =
             unsafe { core::slice::from_raw_parts(peer_publickey, peer_publickey_length as usize) };
 
-        *shared_secret = block_future(async move {
+        *shared_secret = block_on_current_thread(async move {
             let entry = get_vault_entry(context).await?;
-            let key_id = entry.get(secret).await?;
-            let atts = entry.vault.get_secret_attributes(&key_id).await?;
-            let pubkey = PublicKey::new(peer_publickey.to_vec(), atts.secret_type());
-            let shared_ctx = entry.vault.ec_diffie_hellman(&key_id, &pubkey).await?;
-            let index = entry.insert(shared_ctx).await;
-            Ok::<u64, Error>(index)
+            ecdh(&entry, secret, peer_publickey).await
         })?;
         Ok(())
     })
 }
 
+/// Minimum number of ECDH computed by a chunk of `ockam_vault_ecdh_batch`, smaller
+/// batches aren't worth handing over to another thread
+const ECDH_BATCH_MIN_PER_CHUNK: usize = 8;
+
+/// Perform the ECDH operations of `requests`, e.g. the handshakes of many peers reconnecting
+/// at once. The vault is looked up once, and the operations are split between the calling
+/// thread and the idle threads of a pool shared by all the batches, which is started once
+/// with a thread per core besides the caller's. `errors[i]` receives the error code of
+/// request `i`, `0` on success, and `shared_secrets[i]` its shared secret.
+#[no_mangle]
+pub extern "C" fn ockam_vault_ecdh_batch(
+    context: FfiVaultFatPointer,
+    requests: *const FfiEcdhRequest,
+    requests_count: u32,
+    shared_secrets: *mut SecretKeyHandle,
+    errors: *mut i32,
+) -> FfiOckamError {
+    handle_panics(|| {
+        check_buffer!(requests, requests_count);
+        check_buffer!(shared_secrets);
+        check_buffer!(errors);
+
+        let count = requests_count as usize;
+        let requests = unsafe { slice::from_raw_parts(requests, count) };
+        let shared_secrets = unsafe { slice::from_raw_parts_mut(shared_secrets, count) };
+        let errors = unsafe { slice::from_raw_parts_mut(errors, count) };
+
+        let requests = requests
+            .iter()
+            .map(|request| Ok((request.secret(), request.peer_publickey()?.to_vec())))
+            .collect::<StdResult<Vec<_>, FfiError>>()?;
+        let entry = block_on_current_thread(get_vault_entry(context))?;
+        let batch = Arc::new(EcdhBatch::new(entry, requests));
+
+        let chunks = WORKER_POOL.chunks(count, ECDH_BATCH_MIN_PER_CHUNK);
+        let chunk_size = (count + chunks - 1) / chunks;
+        let run_batch = batch.clone();
+        WORKER_POOL.run(chunks, move |chunk| {
+            let start = (chunk * chunk_size).min(count);
+            run_batch.run(start..(start + chunk_size).min(count))
+        });
+
+        for (i, (shared_secret, error)) in shared_secrets.iter_mut().zip(errors).enumerate() {
+            *shared_secret = batch.shared_secrets[i].load(Ordering::Relaxed);
+            *error = batch.errors[i].load(Ordering::Relaxed);
+        }
+        Ok(())
+    })
+}
+
+/// The requests of an `ockam_vault_ecdh_batch` call, owned so that pool threads can run them
+struct EcdhBatch {
+    entry: VaultEntry,
+    requests: Vec<(SecretKeyHandle, Vec<u8>)>,
+    shared_secrets: Vec<AtomicU64>,
+    errors: Vec<AtomicI32>,
+}
+
+impl EcdhBatch {
+    fn new(entry: VaultEntry, requests: Vec<(SecretKeyHandle, Vec<u8>)>) -> Self {
+        // Requests of a chunk which panicked keep reporting the panic
+        let panicked = FfiOckamError::from(FfiError::UnexpectedPanic).code();
+        Self {
+            shared_secrets: requests.iter().map(|_| AtomicU64::new(0)).collect(),
+            errors: requests.iter().map(|_| AtomicI32::new(panicked)).collect(),
+            entry,
+            requests,
+        }
+    }
+
+    fn run(&self, range: core::ops::Range<usize>) {
+        for i in range {
+            let (secret, peer_publickey) = &self.requests[i];
+            let (shared_secret, error) =
+                match block_on_current_thread(ecdh(&self.entry, *secret, peer_publickey)) {
+                    Ok(handle) => (handle, 0),
+                    Err(err) => (0, FfiOckamError::from(err).code()),
+                };
+
+            self.shared_secrets[i].store(shared_secret, Ordering::Relaxed);
+            self.errors[i].store(error, Ordering::Relaxed);
+        }
+    }
+}
+
+async fn ecdh(entry: &VaultEntry, secret: SecretKeyHandle, peer_publickey: &[u8]) -> Result<u64> {
+    let key_id = entry.get(secret)?;
+    let atts = entry.vault.get_secret_attributes(&key_id).await?;
+    let pubkey = PublicKey::new(peer_publickey.to_vec(), atts.secret_type());
+    let shared_ctx = entry.vault.ec_diffie_hellman(&key_id, &pubkey).await?;
+    entry.insert(shared_ctx)
+}
+
 /// Perform an HMAC-SHA256 based key derivation function on the supplied salt and input key
 /// material.
 #[no_mangle]
@@ -328,24 +671,19 @@ pub extern "C" fn ockam_vault_hkdf_sha256(
     handle_panics(|| {
         let derived_outputs_count = derived_outputs_count as usize;
 
-        block_future(async move {
+        block_on_current_thread(async move {
             let entry = get_vault_entry(context).await?;
-            let salt_key_id = entry.get(salt).await?;
+            let salt_key_id = entry.get(salt)?;
             let ikm_key_id = if input_key_material.is_null() {
                 None
             } else {
-                let ctx = unsafe { entry.get(*input_key_material).await? };
+                let ctx = unsafe { entry.get(*input_key_material)? };
                 Some(ctx)
             };
-            let ikm_key_id = ikm_key_id.as_ref();
+            let ikm_key_id = ikm_key_id.as_deref();
 
-            let array: &[FfiSecretAttributes] =
-                unsafe { slice::from_raw_parts(derived_outputs_attributes, derived_outputs_count) };
-
-            let mut output_attributes = Vec::<SecretAttributes>::with_capacity(array.len());
-            for x in array.iter() {
-                output_attributes.push(SecretAttributes::try_from(*x)?);
-            }
+            let output_attributes =
+                output_attributes(derived_outputs_attributes, derived_outputs_count)?;
 
             // TODO: Hardcoded to be empty for now because any changes
             // to the C layer requires an API change.
@@ -363,22 +701,86 @@ pub extern "C" fn ockam_vault_hkdf_sha256(
                 .hkdf_sha256(&salt_key_id, b"", ikm_key_id, output_attributes)
                 .await?;
 
-            let hkdf_output: Vec<SecretKeyHandle> =
-                join_all(hkdf_output.into_iter().map(|x| entry.insert(x))).await;
+            insert_outputs(&entry, hkdf_output, derived_outputs)
+        })?;
+        Ok(())
+    })
+}
 
-            unsafe {
-                std::ptr::copy_nonoverlapping(
-                    hkdf_output.as_ptr(),
-                    derived_outputs,
-                    derived_outputs_count,
-                )
-            };
-            Ok::<(), Error>(())
+/// Perform an ECDH operation between `secret` and `peer_publickey`, then an HMAC-SHA256 based
+/// key derivation with `salt` and the shared secret as input key material. The shared secret is
+/// discarded inside the vault, only the handles of the derived outputs are returned.
+#[no_mangle]
+pub extern "C" fn ockam_vault_ecdh_hkdf_sha256(
+    context: FfiVaultFatPointer,
+    secret: SecretKeyHandle,
+    peer_publickey: *const u8,
+    peer_publickey_length: u32,
+    salt: SecretKeyHandle,
+    derived_outputs_attributes: *const FfiSecretAttributes,
+    derived_outputs_count: u8,
+    derived_outputs: *mut SecretKeyHandle,
+) -> FfiOckamError {
+    handle_panics(|| {
+        check_buffer!(peer_publickey, peer_publickey_length);
+        check_buffer!(derived_outputs_attributes);
+        check_buffer!(derived_outputs);
+
+        let peer_publickey =
+            unsafe { slice::from_raw_parts(peer_publickey, peer_publickey_length as usize) };
+        let derived_outputs_count = derived_outputs_count as usize;
+
+        block_on_current_thread(async move {
+            let entry = get_vault_entry(context).await?;
+            let output_attributes =
+                output_attributes(derived_outputs_attributes, derived_outputs_count)?;
+
+            let key_id = entry.get(secret)?;
+            let atts = entry.vault.get_secret_attributes(&key_id).await?;
+            let pubkey = PublicKey::new(peer_publickey.to_vec(), atts.secret_type());
+            let shared_secret = entry.vault.ec_diffie_hellman(&key_id, &pubkey).await?;
+
+            let salt_key_id = entry.get(salt)?;
+            let hkdf_output = entry
+                .vault
+                .hkdf_sha256(&salt_key_id, b"", Some(&shared_secret), output_attributes)
+                .await;
+            entry.vault.delete_ephemeral_secret(shared_secret).await?;
+
+            insert_outputs(&entry, hkdf_output?, derived_outputs)
         })?;
         Ok(())
     })
 }
 
+fn output_attributes(
+    attributes: *const FfiSecretAttributes,
+    count: usize,
+) -> Result<Vec<SecretAttributes>> {
+    let array: &[FfiSecretAttributes] = unsafe { slice::from_raw_parts(attributes, count) };
+
+    let mut output_attributes = Vec::<SecretAttributes>::with_capacity(array.len());
+    for x in array.iter() {
+        output_attributes.push(SecretAttributes::try_from(*x)?);
+    }
+
+    Ok(output_attributes)
+}
+
+fn insert_outputs(
+    entry: &VaultEntry,
+    outputs: Vec<KeyId>,
+    derived_outputs: *mut SecretKeyHandle,
+) -> Result<()> {
+    let outputs = outputs
+        .into_iter()
+        .map(|x| entry.insert(x))
+        .collect::<Result<Vec<SecretKeyHandle>>>()?;
+
+    unsafe { std::ptr::copy_nonoverlapping(outputs.as_ptr(), derived_outputs, outputs.len()) };
+    Ok(())
+}
+
 ///   Encrypt a payload using AES-GCM.
 #[no_mangle]
 pub extern "C" fn ockam_vault_aead_aes_gcm_encrypt(
@@ -405,29 +807,263 @@ pub extern "C" fn ockam_vault_aead_aes_gcm_encrypt(
         let plaintext =
             unsafe { core::slice::from_raw_parts(plaintext, plaintext_length as usize) };
 
-        block_future(async move {
+        let ciphertext_and_tag_len = plaintext.len() + AES_GCM_TAG_LENGTH_USIZE;
+        if (ciphertext_and_tag_size as usize) < ciphertext_and_tag_len {
+            return Err(FfiError::BufferTooSmall.into());
+        }
+        let ciphertext_and_tag =
+            unsafe { slice::from_raw_parts_mut(ciphertext_and_tag, ciphertext_and_tag_len) };
+
+        block_on_current_thread(async move {
+            let aes = get_aes(context, secret).await?;
+            aes.encrypt_message_into(
+                plaintext,
+                &aes_gcm_nonce(nonce),
+                additional_data,
+                ciphertext_and_tag,
+            )?;
+            *ciphertext_and_tag_length = ciphertext_and_tag_len as u32;
+            Ok::<(), Error>(())
+        })?;
+        Ok(())
+    })
+}
+
+/// Encrypt in place the first `plaintext_length` bytes of `buffer` using AES-GCM, the tag is
+/// written right after the ciphertext. This lets callers assemble the plaintext directly in
+/// the output buffer, e.g. after a nonce header, without an intermediate copy.
+#[no_mangle]
+pub extern "C" fn ockam_vault_aead_aes_gcm_encrypt_in_place(
+    context: FfiVaultFatPointer,
+    secret: SecretKeyHandle,
+    nonce: u64,
+    additional_data: *const u8,
+    additional_data_length: u32,
+    buffer: *mut u8,
+    plaintext_length: u32,
+    buffer_size: u32,
+    ciphertext_and_tag_length: &mut u32,
+) -> FfiOckamError {
+    *ciphertext_and_tag_length = 0;
+    handle_panics(|| {
+        check_buffer!(additional_data);
+        check_buffer!(buffer);
+
+        let additional_data =
+            unsafe { slice::from_raw_parts(additional_data, additional_data_length as usize) };
+
+        let ciphertext_and_tag_len = plaintext_length as usize + AES_GCM_TAG_LENGTH_USIZE;
+        if (buffer_size as usize) < ciphertext_and_tag_len {
+            return Err(FfiError::BufferTooSmall.into());
+        }
+        let buffer = unsafe { slice::from_raw_parts_mut(buffer, ciphertext_and_tag_len) };
+
+        block_on_current_thread(async move {
+            let aes = get_aes(context, secret).await?;
+            aes.encrypt_message_in_place(buffer, &aes_gcm_nonce(nonce), additional_data)?;
+            *ciphertext_and_tag_length = ciphertext_and_tag_len as u32;
+            Ok::<(), Error>(())
+        })?;
+        Ok(())
+    })
+}
+
+/// Encrypt a batch of payloads using AES-GCM with consecutive nonces starting at `start_nonce`.
+/// The key is resolved once for the whole batch. Each message is written to `output` as its
+/// 8 bytes big-endian nonce followed by the ciphertext and tag.
+#[no_mangle]
+pub extern "C" fn ockam_vault_aead_aes_gcm_encrypt_batch(
+    context: FfiVaultFatPointer,
+    secret: SecretKeyHandle,
+    start_nonce: u64,
+    messages: *const FfiAeadMessage,
+    messages_count: u32,
+    output: *mut u8,
+    output_size: u32,
+    output_length: &mut u32,
+) -> FfiOckamError {
+    *output_length = 0;
+    handle_panics(|| {
+        check_buffer!(messages, messages_count);
+        check_buffer!(output);
+
+        let messages = unsafe { slice::from_raw_parts(messages, messages_count as usize) };
+        let output = unsafe { slice::from_raw_parts_mut(output, output_size as usize) };
+
+        block_on_current_thread(async move {
+            let aes = get_aes(context, secret).await?;
+
+            let mut offset = 0;
+            for (index, message) in messages.iter().enumerate() {
+                let nonce = start_nonce
+                    .checked_add(index as u64)
+                    .ok_or(FfiError::InvalidParam)?;
+                let additional_data = message.additional_data()?;
+                let plaintext = message.plaintext()?;
+
+                let frame_length = NONCE_FRAME_LENGTH + plaintext.len() + AES_GCM_TAG_LENGTH_USIZE;
+                if output.len() < offset + frame_length {
+                    return Err(FfiError::BufferTooSmall.into());
+                }
+
+                let frame = &mut output[offset..offset + frame_length];
+                frame[..NONCE_FRAME_LENGTH].copy_from_slice(&nonce.to_be_bytes());
+                aes.encrypt_message_into(
+                    plaintext,
+                    &aes_gcm_nonce(nonce),
+                    additional_data,
+                    &mut frame[NONCE_FRAME_LENGTH..],
+                )?;
+
+                offset += frame_length;
+            }
+
+            *output_length = offset as u32;
+            Ok::<(), Error>(())
+        })?;
+        Ok(())
+    })
+}
+
+/// Noise `EncryptAndHash`: encrypt a payload using AES-GCM with `secret` as the key and
+/// `h` as the additional data, then write `SHA256(h || ciphertext_and_tag)` to `new_h`.
+/// `secret` can be of any type holding 16 or 32 bytes, its bytes never leave the vault.
+#[no_mangle]
+pub extern "C" fn ockam_vault_aead_aes_gcm_encrypt_and_hash(
+    context: FfiVaultFatPointer,
+    secret: SecretKeyHandle,
+    nonce: u64,
+    h: *const u8,
+    plaintext: *const u8,
+    plaintext_length: u32,
+    ciphertext_and_tag: *mut u8,
+    ciphertext_and_tag_size: u32,
+    ciphertext_and_tag_length: &mut u32,
+    new_h: *mut u8,
+) -> FfiOckamError {
+    *ciphertext_and_tag_length = 0;
+    handle_panics(|| {
+        check_buffer!(h);
+        check_buffer!(plaintext);
+        check_buffer!(ciphertext_and_tag);
+        check_buffer!(new_h);
+
+        let h = unsafe { slice::from_raw_parts(h, SHA256_LENGTH) };
+        let plaintext = unsafe { slice::from_raw_parts(plaintext, plaintext_length as usize) };
+        let new_h = unsafe { slice::from_raw_parts_mut(new_h, SHA256_LENGTH) };
+
+        let ciphertext_and_tag_len = plaintext.len() + AES_GCM_TAG_LENGTH_USIZE;
+        if (ciphertext_and_tag_size as usize) < ciphertext_and_tag_len {
+            return Err(FfiError::BufferTooSmall.into());
+        }
+        let ciphertext_and_tag =
+            unsafe { slice::from_raw_parts_mut(ciphertext_and_tag, ciphertext_and_tag_len) };
+
+        block_on_current_thread(async move {
+            let entry = get_vault_entry(context).await?;
+            let aes = make_aes_from_any(&entry, secret).await?;
+            aes.encrypt_message_into(plaintext, &aes_gcm_nonce(nonce), h, ciphertext_and_tag)?;
+            new_h.copy_from_slice(
+                &Sha256::new()
+                    .chain_update(h)
+                    .chain_update(&*ciphertext_and_tag)
+                    .finalize(),
+            );
+            *ciphertext_and_tag_length = ciphertext_and_tag_len as u32;
+            Ok::<(), Error>(())
+        })?;
+        Ok(())
+    })
+}
+
+/// Noise `DecryptAndHash`: decrypt a payload using AES-GCM with `secret` as the key and
+/// `h` as the additional data, then write `SHA256(h || ciphertext_and_tag)` to `new_h`.
+/// `new_h` is only written when the payload is authentic.
+#[no_mangle]
+pub extern "C" fn ockam_vault_aead_aes_gcm_decrypt_and_hash(
+    context: FfiVaultFatPointer,
+    secret: SecretKeyHandle,
+    nonce: u64,
+    h: *const u8,
+    ciphertext_and_tag: *const u8,
+    ciphertext_and_tag_length: u32,
+    plaintext: *mut u8,
+    plaintext_size: u32,
+    plaintext_length: &mut u32,
+    new_h: *mut u8,
+) -> FfiOckamError {
+    *plaintext_length = 0;
+    handle_panics(|| {
+        check_buffer!(h);
+        check_buffer!(ciphertext_and_tag, ciphertext_and_tag_length);
+        check_buffer!(plaintext);
+        check_buffer!(new_h);
+
+        let h = unsafe { slice::from_raw_parts(h, SHA256_LENGTH) };
+        let ciphertext_and_tag = unsafe {
+            slice::from_raw_parts(ciphertext_and_tag, ciphertext_and_tag_length as usize)
+        };
+        let new_h = unsafe { slice::from_raw_parts_mut(new_h, SHA256_LENGTH) };
+
+        if ciphertext_and_tag.len() < AES_GCM_TAG_LENGTH_USIZE {
+            return Err(FfiError::InvalidParam.into());
+        }
+        let plaintext_len = ciphertext_and_tag.len() - AES_GCM_TAG_LENGTH_USIZE;
+        if (plaintext_size as usize) < plaintext_len {
+            return Err(FfiError::BufferTooSmall.into());
+        }
+        let plaintext = unsafe { slice::from_raw_parts_mut(plaintext, plaintext_len) };
+
+        let aes = block_on_current_thread(async move {
             let entry = get_vault_entry(context).await?;
-            let key_id = entry.get(secret).await?;
-            let mut nonce_vec = vec![0; 12 - 8];
-            nonce_vec.extend_from_slice(&nonce.to_be_bytes());
-            let ciphertext = entry
+            make_aes_from_any(&entry, secret).await
+        })?;
+        aes.try_decrypt_message_into(ciphertext_and_tag, &aes_gcm_nonce(nonce), h, plaintext)
+            .map_err(|_| FfiError::AeadAuthFailed)?;
+        new_h.copy_from_slice(
+            &Sha256::new()
+                .chain_update(h)
+                .chain_update(ciphertext_and_tag)
+                .finalize(),
+        );
+        *plaintext_length = plaintext_len as u32;
+        Ok(())
+    })
+}
+
+/// Derive the next AES-GCM key of a secure channel from `secret` and store it in the vault.
+/// The new key is the first 32 bytes of the encryption of 32 zero bytes with the max nonce,
+/// its bytes never leave the vault. When `destroy_old` is set, `secret` is destroyed once the
+/// new key is stored.
+#[no_mangle]
+pub extern "C" fn ockam_vault_aead_aes_gcm_rekey(
+    context: FfiVaultFatPointer,
+    secret: SecretKeyHandle,
+    destroy_old: bool,
+    new_secret: &mut SecretKeyHandle,
+) -> FfiOckamError {
+    handle_panics(|| {
+        *new_secret = block_on_current_thread(async move {
+            let entry = get_vault_entry(context).await?;
+            let aes = make_aes(&entry, secret).await?;
+
+            // Zeroized with the secret, spare capacity included
+            let mut key = vec![0u8; REKEY_LENGTH + AES_GCM_TAG_LENGTH_USIZE];
+            aes.encrypt_message_in_place(&mut key, &aes_gcm_nonce(u64::MAX), &[])?;
+            key.truncate(REKEY_LENGTH);
+
+            let key_id = entry
                 .vault
-                .aead_aes_gcm_encrypt(&key_id, plaintext, &nonce_vec, additional_data)
+                .import_ephemeral_secret(Secret::new(key), SecretAttributes::Aes256)
                 .await?;
+            let new_secret = entry.insert(key_id)?;
 
-            if ciphertext_and_tag_size < ciphertext.len() as u32 {
-                return Err(FfiError::BufferTooSmall.into());
+            if destroy_old {
+                let key_id = entry.take(secret)?;
+                entry.delete(key_id).await?;
             }
-            *ciphertext_and_tag_length = ciphertext.len() as u32;
 
-            unsafe {
-                std::ptr::copy_nonoverlapping(
-                    ciphertext.as_ptr(),
-                    ciphertext_and_tag,
-                    ciphertext.len(),
-                )
-            };
-            Ok::<(), Error>(())
+            Ok::<u64, Error>(new_secret)
         })?;
         Ok(())
     })
@@ -460,49 +1096,350 @@ pub extern "C" fn ockam_vault_aead_aes_gcm_decrypt(
             core::slice::from_raw_parts(ciphertext_and_tag, ciphertext_and_tag_length as usize)
         };
 
-        block_future(async move {
+        if ciphertext_and_tag.len() < AES_GCM_TAG_LENGTH_USIZE {
+            return Err(FfiError::InvalidParam.into());
+        }
+        let plaintext_len = ciphertext_and_tag.len() - AES_GCM_TAG_LENGTH_USIZE;
+        if (plaintext_size as usize) < plaintext_len {
+            return Err(FfiError::BufferTooSmall.into());
+        }
+        let plaintext = unsafe { slice::from_raw_parts_mut(plaintext, plaintext_len) };
+
+        let aes = block_on_current_thread(get_aes(context, secret))?;
+        aes.try_decrypt_message_into(
+            ciphertext_and_tag,
+            &aes_gcm_nonce(nonce),
+            additional_data,
+            plaintext,
+        )
+        .map_err(|_| FfiError::AeadAuthFailed)?;
+        *plaintext_length = plaintext_len as u32;
+        Ok(())
+    })
+}
+
+///   Encrypt a payload using ChaCha20-Poly1305, for CPUs without AES acceleration. The key
+///   is the 32 bytes of `secret`, whatever its type.
+#[no_mangle]
+pub extern "C" fn ockam_vault_aead_chacha20_poly1305_encrypt(
+    context: FfiVaultFatPointer,
+    secret: SecretKeyHandle,
+    nonce: u64,
+    additional_data: *const u8,
+    additional_data_length: u32,
+    plaintext: *const u8,
+    plaintext_length: u32,
+    ciphertext_and_tag: &mut u8,
+    ciphertext_and_tag_size: u32,
+    ciphertext_and_tag_length: &mut u32,
+) -> FfiOckamError {
+    *ciphertext_and_tag_length = 0;
+    handle_panics(|| {
+        check_buffer!(additional_data);
+        check_buffer!(plaintext);
+
+        let additional_data =
+            unsafe { slice::from_raw_parts(additional_data, additional_data_length as usize) };
+
+        let plaintext = unsafe { slice::from_raw_parts(plaintext, plaintext_length as usize) };
+
+        let ciphertext_and_tag_len = plaintext.len() + CHACHA20_POLY1305_TAG_LENGTH;
+        if (ciphertext_and_tag_size as usize) < ciphertext_and_tag_len {
+            return Err(FfiError::BufferTooSmall.into());
+        }
+        let ciphertext_and_tag =
+            unsafe { slice::from_raw_parts_mut(ciphertext_and_tag, ciphertext_and_tag_len) };
+
+        let cipher = block_on_current_thread(get_chacha20_poly1305(context, secret))?;
+        ciphertext_and_tag[..plaintext.len()].copy_from_slice(plaintext);
+        chacha20_poly1305_encrypt_in_place(&cipher, nonce, additional_data, ciphertext_and_tag)?;
+        *ciphertext_and_tag_length = ciphertext_and_tag_len as u32;
+        Ok(())
+    })
+}
+
+/// Encrypt in place the first `plaintext_length` bytes of `buffer` using ChaCha20-Poly1305,
+/// the tag is written right after the ciphertext, as `ockam_vault_aead_aes_gcm_encrypt_in_place`.
+#[no_mangle]
+pub extern "C" fn ockam_vault_aead_chacha20_poly1305_encrypt_in_place(
+    context: FfiVaultFatPointer,
+    secret: SecretKeyHandle,
+    nonce: u64,
+    additional_data: *const u8,
+    additional_data_length: u32,
+    buffer: *mut u8,
+    plaintext_length: u32,
+    buffer_size: u32,
+    ciphertext_and_tag_length: &mut u32,
+) -> FfiOckamError {
+    *ciphertext_and_tag_length = 0;
+    handle_panics(|| {
+        check_buffer!(additional_data);
+        check_buffer!(buffer);
+
+        let additional_data =
+            unsafe { slice::from_raw_parts(additional_data, additional_data_length as usize) };
+
+        let ciphertext_and_tag_len = plaintext_length as usize + CHACHA20_POLY1305_TAG_LENGTH;
+        if (buffer_size as usize) < ciphertext_and_tag_len {
+            return Err(FfiError::BufferTooSmall.into());
+        }
+        let buffer = unsafe { slice::from_raw_parts_mut(buffer, ciphertext_and_tag_len) };
+
+        let cipher = block_on_current_thread(get_chacha20_poly1305(context, secret))?;
+        chacha20_poly1305_encrypt_in_place(&cipher, nonce, additional_data, buffer)?;
+        *ciphertext_and_tag_length = ciphertext_and_tag_len as u32;
+        Ok(())
+    })
+}
+
+/// Decrypt a payload using ChaCha20-Poly1305.
+#[no_mangle]
+pub extern "C" fn ockam_vault_aead_chacha20_poly1305_decrypt(
+    context: FfiVaultFatPointer,
+    secret: SecretKeyHandle,
+    nonce: u64,
+    additional_data: *const u8,
+    additional_data_length: u32,
+    ciphertext_and_tag: *const u8,
+    ciphertext_and_tag_length: u32,
+    plaintext: &mut u8,
+    plaintext_size: u32,
+    plaintext_length: &mut u32,
+) -> FfiOckamError {
+    *plaintext_length = 0;
+    handle_panics(|| {
+        check_buffer!(ciphertext_and_tag, ciphertext_and_tag_length);
+        check_buffer!(additional_data);
+
+        let additional_data =
+            unsafe { slice::from_raw_parts(additional_data, additional_data_length as usize) };
+
+        let ciphertext_and_tag = unsafe {
+            slice::from_raw_parts(ciphertext_and_tag, ciphertext_and_tag_length as usize)
+        };
+
+        if ciphertext_and_tag.len() < CHACHA20_POLY1305_TAG_LENGTH {
+            return Err(FfiError::InvalidParam.into());
+        }
+        let plaintext_len = ciphertext_and_tag.len() - CHACHA20_POLY1305_TAG_LENGTH;
+        if (plaintext_size as usize) < plaintext_len {
+            return Err(FfiError::BufferTooSmall.into());
+        }
+        let plaintext = unsafe { slice::from_raw_parts_mut(plaintext, plaintext_len) };
+        let (ciphertext, tag) = ciphertext_and_tag.split_at(plaintext_len);
+
+        let cipher = block_on_current_thread(get_chacha20_poly1305(context, secret))?;
+        plaintext.copy_from_slice(ciphertext);
+        if cipher
+            .decrypt_in_place_detached(
+                &chacha20_poly1305_nonce(nonce),
+                additional_data,
+                plaintext,
+                Tag::from_slice(tag),
+            )
+            .is_err()
+        {
+            // Don't leave the unauthenticated keystream output behind
+            plaintext.fill(0);
+            return Err(FfiError::AeadAuthFailed.into());
+        }
+        *plaintext_length = plaintext_len as u32;
+        Ok(())
+    })
+}
+
+/// Derive the next ChaCha20-Poly1305 key of a secure channel from `secret`, with the same
+/// construction as `ockam_vault_aead_aes_gcm_rekey`: the first 32 bytes of the encryption of
+/// 32 zero bytes with the max nonce.
+#[no_mangle]
+pub extern "C" fn ockam_vault_aead_chacha20_poly1305_rekey(
+    context: FfiVaultFatPointer,
+    secret: SecretKeyHandle,
+    destroy_old: bool,
+    new_secret: &mut SecretKeyHandle,
+) -> FfiOckamError {
+    handle_panics(|| {
+        *new_secret = block_on_current_thread(async move {
             let entry = get_vault_entry(context).await?;
-            let key_id = entry.get(secret).await?;
-            let mut nonce_vec = vec![0; 12 - 8];
-            nonce_vec.extend_from_slice(&nonce.to_be_bytes());
-            let plain = entry
+            let cipher = make_chacha20_poly1305(&entry, secret).await?;
+
+            // Zeroized with the secret, spare capacity included
+            let mut key = vec![0u8; REKEY_LENGTH + CHACHA20_POLY1305_TAG_LENGTH];
+            chacha20_poly1305_encrypt_in_place(&cipher, u64::MAX, &[], &mut key)?;
+            key.truncate(REKEY_LENGTH);
+
+            // Not an AES key, the ChaCha20-Poly1305 functions take the bytes of any secret
+            let attributes = SecretAttributes::Buffer(REKEY_LENGTH as u32);
+            let key_id = entry
                 .vault
-                .aead_aes_gcm_decrypt(&key_id, ciphertext_and_tag, &nonce_vec, additional_data)
+                .import_ephemeral_secret(Secret::new(key), attributes)
                 .await?;
-            if plaintext_size < plain.len() as u32 {
-                return Err(FfiError::BufferTooSmall.into());
+            let new_secret = entry.insert(key_id)?;
+
+            if destroy_old {
+                let key_id = entry.take(secret)?;
+                entry.delete(key_id).await?;
             }
-            *plaintext_length = plain.len() as u32;
 
-            unsafe { std::ptr::copy_nonoverlapping(plain.as_ptr(), plaintext, plain.len()) };
-            Ok::<(), Error>(())
+            Ok::<u64, Error>(new_secret)
         })?;
         Ok(())
     })
 }
 
+/// Count the live vaults, and the live secrets summed over all of them.
+#[no_mangle]
+pub extern "C" fn ockam_vault_live_handles(vaults: &mut u64, secrets: &mut u64) -> FfiOckamError {
+    handle_panics(|| {
+        let (mut vault_count, mut secret_count) = (0, 0);
+        SOFTWARE_VAULTS.for_each(|entry| {
+            vault_count += 1;
+            secret_count += entry.secrets_mapping.live();
+        });
+
+        *vaults = vault_count;
+        *secrets = secret_count;
+        Ok(())
+    })
+}
+
+/// Report the AES, GHASH and SHA-256 implementations selected on this CPU.
+#[no_mangle]
+pub extern "C" fn ockam_vault_backend_info(info: &mut FfiBackendInfo) -> FfiOckamError {
+    handle_panics(|| {
+        *info = FfiBackendInfo::new(backend::aes(), backend::ghash(), backend::sha256());
+        Ok(())
+    })
+}
+
 /// De-initialize an Ockam Vault.
 #[no_mangle]
 pub extern "C" fn ockam_vault_deinit(context: FfiVaultFatPointer) -> FfiOckamError {
     handle_panics(|| {
-        block_future(async move {
-            match context.vault_type() {
-                FfiVaultType::Software => {
-                    let handle = context.handle() as usize;
-                    let mut v = SOFTWARE_VAULTS.write().await;
-                    if handle < v.len() {
-                        v.remove(handle);
-                        Ok(())
-                    } else {
-                        Err(FfiError::VaultNotFound)
-                    }
-                }
+        match context.vault_type() {
+            FfiVaultType::Software => {
+                let entry = SOFTWARE_VAULTS.remove(context.handle())?;
+                entry.keypair_pool.stop(&entry.vault);
             }
-        })?;
+        }
         Ok(())
     })
 }
 
+/// Get the AES-GCM cipher of a secret, so that callers can encrypt or decrypt in place
+async fn get_aes(context: FfiVaultFatPointer, secret: SecretKeyHandle) -> Result<Arc<AesGen>> {
+    let entry = get_vault_entry(context).await?;
+    make_aes(&entry, secret).await
+}
+
+/// The cipher is built on the first use of the key, then reused from the vault's cache.
+/// The key stays borrowed until it's cached, so a concurrent destroy can't remove it from
+/// the cache before it's inserted.
+async fn make_aes(entry: &VaultEntry, secret: SecretKeyHandle) -> Result<Arc<AesGen>> {
+    let key_id = entry.get(secret)?;
+    if let Some(aes) = entry.aes_cache.get(&key_id) {
+        return Ok(aes);
+    }
+
+    let stored_secret = entry.vault.get_ephemeral_secret(&key_id, "aes key").await?;
+    let aes = Arc::new(Vault::make_aes(&stored_secret)?);
+    entry.aes_cache.insert(key_id.clone(), aes.clone());
+    Ok(aes)
+}
+
+/// Get the bytes of an AES secret, e.g. to derive the key of a stream
+async fn get_aes_key(context: FfiVaultFatPointer, secret: SecretKeyHandle) -> Result<StoredSecret> {
+    let entry = get_vault_entry(context).await?;
+    let key_id = entry.get(secret)?;
+    let stored_secret = entry.vault.get_ephemeral_secret(&key_id, "aes key").await?;
+    match stored_secret.attributes() {
+        SecretAttributes::Aes256 | SecretAttributes::Aes128 => Ok(stored_secret),
+        _ => Err(FfiError::InvalidParam.into()),
+    }
+}
+
+/// Build an AES-GCM cipher from the bytes of a secret of any type, e.g. the buffer secrets
+/// output by HKDF during a Noise handshake
+async fn make_aes_from_any(entry: &VaultEntry, secret: SecretKeyHandle) -> Result<AesGen> {
+    let key_id = entry.get(secret)?;
+    let stored_secret = entry.vault.get_ephemeral_secret(&key_id, "aes key").await?;
+    AesGen::from_key(stored_secret.secret().as_ref())
+}
+
+/// Build a ChaCha20-Poly1305 cipher from the bytes of a secret of any type. Unlike AES-GCM
+/// the key schedule is a plain copy, so there's nothing worth caching.
+async fn get_chacha20_poly1305(
+    context: FfiVaultFatPointer,
+    secret: SecretKeyHandle,
+) -> Result<ChaCha20Poly1305> {
+    let entry = get_vault_entry(context).await?;
+    make_chacha20_poly1305(&entry, secret).await
+}
+
+async fn make_chacha20_poly1305(
+    entry: &VaultEntry,
+    secret: SecretKeyHandle,
+) -> Result<ChaCha20Poly1305> {
+    let key_id = entry.get(secret)?;
+    let stored_secret = entry
+        .vault
+        .get_ephemeral_secret(&key_id, "chacha20-poly1305 key")
+        .await?;
+    let key = stored_secret.secret().as_ref();
+    if key.len() != CHACHA20_POLY1305_KEY_LENGTH {
+        return Err(FfiError::InvalidParam.into());
+    }
+    Ok(ChaCha20Poly1305::new(Key::from_slice(key)))
+}
+
+/// Encrypt the start of `buffer` in place, its last `CHACHA20_POLY1305_TAG_LENGTH` bytes
+/// receive the tag
+fn chacha20_poly1305_encrypt_in_place(
+    cipher: &ChaCha20Poly1305,
+    nonce: u64,
+    additional_data: &[u8],
+    buffer: &mut [u8],
+) -> StdResult<(), FfiError> {
+    let (plaintext, tag) = buffer.split_at_mut(buffer.len() - CHACHA20_POLY1305_TAG_LENGTH);
+    let computed_tag = cipher
+        .encrypt_in_place_detached(&chacha20_poly1305_nonce(nonce), additional_data, plaintext)
+        .map_err(|_| FfiError::InvalidParam)?;
+    tag.copy_from_slice(&computed_tag);
+    Ok(())
+}
+
+/// Length of the big-endian nonce prepended to each framed ciphertext
+const NONCE_FRAME_LENGTH: usize = 8;
+
+/// Length of the Noise handshake hash `h`
+const SHA256_LENGTH: usize = 32;
+
+/// Length of the keys derived when rekeying a secure channel
+const REKEY_LENGTH: usize = 32;
+
+/// Length of a ChaCha20-Poly1305 key
+const CHACHA20_POLY1305_KEY_LENGTH: usize = 32;
+
+/// Length of a Poly1305 tag
+const CHACHA20_POLY1305_TAG_LENGTH: usize = 16;
+
+/// Expand a message counter to the 12 bytes AES-GCM nonce: 4 zero bytes followed by the
+/// big-endian counter
+fn aes_gcm_nonce(nonce: u64) -> [u8; 12] {
+    let mut nonce_bytes = [0u8; 12];
+    nonce_bytes[4..].copy_from_slice(&nonce.to_be_bytes());
+    nonce_bytes
+}
+
+/// Expand a message counter to the 12 bytes ChaCha20-Poly1305 nonce as Noise does: 4 zero
+/// bytes followed by the little-endian counter
+fn chacha20_poly1305_nonce(nonce: u64) -> Nonce {
+    let mut nonce_bytes = [0u8; 12];
+    nonce_bytes[4..].copy_from_slice(&nonce.to_le_bytes());
+    Nonce::clone_from_slice(&nonce_bytes)
+}
+
 fn handle_panics<F>(f: F) -> FfiOckamError
 where
     F: FnOnce() -> StdResult<(), FfiOckamError>,
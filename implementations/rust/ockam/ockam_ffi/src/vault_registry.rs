@@ -0,0 +1,137 @@
+use crate::FfiError;
+use core::sync::atomic::{AtomicUsize, Ordering};
+use ockam_core::Result;
+use std::sync::{PoisonError, RwLock};
+
+/// Number of independently locked shards, must fit in `SHARD_BITS`
+const SHARDS: usize = 16;
+const SHARD_BITS: u32 = 8;
+const INDEX_BITS: u32 = 24;
+
+/// Registry of the vaults created through the FFI.
+///
+/// Vaults are spread over several shards, each behind its own lock, so calls on vaults
+/// living in different shards never contend. A handle is
+/// `generation << 32 | index << 8 | shard`: slots freed by `remove` are reused by later
+/// insertions and their generation is bumped, so a stale handle can't reach the new vault.
+pub(crate) struct VaultRegistry<T> {
+    shards: Vec<RwLock<Shard<T>>>,
+    next_shard: AtomicUsize,
+}
+
+struct Shard<T> {
+    slots: Vec<Slot<T>>,
+    free: Vec<u32>,
+}
+
+struct Slot<T> {
+    generation: u32,
+    entry: Option<T>,
+}
+
+impl<T: Clone> VaultRegistry<T> {
+    pub(crate) fn new() -> Self {
+        Self {
+            shards: (0..SHARDS)
+                .map(|_| {
+                    RwLock::new(Shard {
+                        slots: vec![],
+                        free: vec![],
+                    })
+                })
+                .collect(),
+            next_shard: AtomicUsize::new(0),
+        }
+    }
+
+    /// Insert an entry in the next shard, round-robin
+    pub(crate) fn insert(&self, entry: T) -> Result<u64> {
+        let shard = self.next_shard.fetch_add(1, Ordering::Relaxed);
+        self.insert_with_affinity(entry, shard)
+    }
+
+    /// Insert an entry in the shard picked by `affinity`, callers passing the same
+    /// affinity (e.g. a scheduler id) share a shard and never contend with other ones
+    pub(crate) fn insert_with_affinity(&self, entry: T, affinity: usize) -> Result<u64> {
+        let shard_index = affinity % SHARDS;
+        let mut shard = self.shards[shard_index]
+            .write()
+            .map_err(|_| FfiError::OwnershipError)?;
+
+        let index = match shard.free.pop() {
+            Some(index) => index,
+            None => {
+                if shard.slots.len() >= 1 << INDEX_BITS {
+                    return Err(FfiError::TooManyVaults.into());
+                }
+                shard.slots.push(Slot {
+                    generation: 0,
+                    entry: None,
+                });
+                (shard.slots.len() - 1) as u32
+            }
+        };
+
+        let slot = &mut shard.slots[index as usize];
+        slot.entry = Some(entry);
+
+        Ok(((slot.generation as u64) << 32) | ((index as u64) << SHARD_BITS) | shard_index as u64)
+    }
+
+    pub(crate) fn get(&self, handle: u64) -> Result<T> {
+        let (shard_index, index, generation) = split(handle);
+        let shard = self
+            .shards
+            .get(shard_index)
+            .ok_or(FfiError::VaultNotFound)?
+            .read()
+            .map_err(|_| FfiError::OwnershipError)?;
+
+        match shard.slots.get(index) {
+            Some(Slot {
+                generation: g,
+                entry: Some(entry),
+            }) if *g == generation => Ok(entry.clone()),
+            _ => Err(FfiError::VaultNotFound.into()),
+        }
+    }
+
+    pub(crate) fn remove(&self, handle: u64) -> Result<T> {
+        let (shard_index, index, generation) = split(handle);
+        let mut shard = self
+            .shards
+            .get(shard_index)
+            .ok_or(FfiError::VaultNotFound)?
+            .write()
+            .map_err(|_| FfiError::OwnershipError)?;
+
+        let slot = match shard.slots.get_mut(index) {
+            Some(slot) if slot.generation == generation && slot.entry.is_some() => slot,
+            _ => return Err(FfiError::VaultNotFound.into()),
+        };
+
+        let entry = slot.entry.take().ok_or(FfiError::VaultNotFound)?;
+        slot.generation = slot.generation.wrapping_add(1);
+        shard.free.push(index as u32);
+
+        Ok(entry)
+    }
+
+    /// Call `f` on every live entry, locking one shard at a time
+    pub(crate) fn for_each(&self, mut f: impl FnMut(&T)) {
+        for shard in &self.shards {
+            let shard = shard.read().unwrap_or_else(PoisonError::into_inner);
+            shard
+                .slots
+                .iter()
+                .filter_map(|slot| slot.entry.as_ref())
+                .for_each(&mut f);
+        }
+    }
+}
+
+fn split(handle: u64) -> (usize, usize, u32) {
+    let shard = (handle & ((1 << SHARD_BITS) - 1)) as usize;
+    let index = ((handle >> SHARD_BITS) & ((1 << INDEX_BITS) - 1)) as usize;
+    (shard, index, (handle >> 32) as u32)
+}
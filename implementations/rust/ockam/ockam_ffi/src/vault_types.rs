@@ -3,6 +3,7 @@
 use crate::FfiError;
 use ockam_vault::constants::AES256_SECRET_LENGTH_U32;
 use ockam_vault::{SecretAttributes, SecretType};
+use std::os::raw::c_char;
 
 /// Represents a handle id for the secret key
 pub type SecretKeyHandle = u64;
@@ -35,6 +36,70 @@ impl FfiVaultFatPointer {
     }
 }
 
+#[derive(Clone, Copy, Debug)]
+#[repr(C)]
+pub struct FfiBuffer {
+    data: *const u8,
+    length: u32,
+}
+
+impl FfiBuffer {
+    pub fn data(&self) -> Result<&[u8], FfiError> {
+        if self.data.is_null() {
+            return Err(FfiError::InvalidParam);
+        }
+        Ok(unsafe { core::slice::from_raw_parts(self.data, self.length as usize) })
+    }
+}
+
+#[derive(Clone, Copy, Debug)]
+#[repr(C)]
+pub struct FfiAeadMessage {
+    additional_data: *const u8,
+    additional_data_length: u32,
+    plaintext: *const u8,
+    plaintext_length: u32,
+}
+
+impl FfiAeadMessage {
+    pub fn additional_data(&self) -> Result<&[u8], FfiError> {
+        if self.additional_data.is_null() {
+            return Err(FfiError::InvalidParam);
+        }
+        Ok(unsafe {
+            core::slice::from_raw_parts(self.additional_data, self.additional_data_length as usize)
+        })
+    }
+    pub fn plaintext(&self) -> Result<&[u8], FfiError> {
+        if self.plaintext.is_null() {
+            return Err(FfiError::InvalidParam);
+        }
+        Ok(unsafe { core::slice::from_raw_parts(self.plaintext, self.plaintext_length as usize) })
+    }
+}
+
+#[derive(Clone, Copy, Debug)]
+#[repr(C)]
+pub struct FfiEcdhRequest {
+    secret: SecretKeyHandle,
+    peer_publickey: *const u8,
+    peer_publickey_length: u32,
+}
+
+impl FfiEcdhRequest {
+    pub fn secret(&self) -> SecretKeyHandle {
+        self.secret
+    }
+    pub fn peer_publickey(&self) -> Result<&[u8], FfiError> {
+        if self.peer_publickey.is_null() || self.peer_publickey_length == 0 {
+            return Err(FfiError::InvalidParam);
+        }
+        Ok(unsafe {
+            core::slice::from_raw_parts(self.peer_publickey, self.peer_publickey_length as usize)
+        })
+    }
+}
+
 #[derive(Clone, Copy, Debug)]
 #[repr(C)]
 pub struct FfiSecretAttributes {
@@ -96,3 +161,23 @@ impl TryFrom<FfiSecretAttributes> for SecretAttributes {
         }
     }
 }
+
+/// Names of the AES-GCM and SHA-256 implementations selected at runtime, as static
+/// nul-terminated strings
+#[repr(C)]
+#[derive(Clone, Copy, Debug)]
+pub struct FfiBackendInfo {
+    aes: *const c_char,
+    ghash: *const c_char,
+    sha256: *const c_char,
+}
+
+impl FfiBackendInfo {
+    pub fn new(aes: &'static [u8], ghash: &'static [u8], sha256: &'static [u8]) -> Self {
+        Self {
+            aes: aes.as_ptr() as *const c_char,
+            ghash: ghash.as_ptr() as *const c_char,
+            sha256: sha256.as_ptr() as *const c_char,
+        }
+    }
+}
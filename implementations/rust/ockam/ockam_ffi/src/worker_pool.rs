@@ -0,0 +1,205 @@
+use std::collections::VecDeque;
+use std::panic::{self, AssertUnwindSafe};
+use std::sync::atomic::{AtomicUsize, Ordering};
+use std::sync::{Arc, Condvar, Mutex, MutexGuard, PoisonError};
+use std::thread;
+
+/// Threads shared by the batched vault operations, e.g. `ockam_vault_ecdh_batch`.
+///
+/// The workers are started once, so concurrent batches share them instead of each spawning
+/// its own threads. A batch is split in chunks which the calling thread and the idle workers
+/// claim one at a time, the caller keeps making progress even when every worker is busy with
+/// other batches.
+pub(crate) struct WorkerPool {
+    shared: Arc<Shared>,
+    workers: usize,
+}
+
+#[derive(Default)]
+struct Shared {
+    jobs: Mutex<VecDeque<Arc<dyn Job>>>,
+    available: Condvar,
+}
+
+trait Job: Send + Sync {
+    /// Run chunks until none is left to claim
+    fn run(&self);
+}
+
+struct Chunks<F> {
+    run_chunk: F,
+    count: usize,
+    next: AtomicUsize,
+    done: Mutex<usize>,
+    finished: Condvar,
+}
+
+impl<F> Job for Chunks<F>
+where
+    F: Fn(usize) + Send + Sync,
+{
+    fn run(&self) {
+        loop {
+            let chunk = self.next.fetch_add(1, Ordering::Relaxed);
+            if chunk >= self.count {
+                return;
+            }
+
+            // A panicking chunk must neither kill its worker nor leave the caller waiting for it
+            let _ = panic::catch_unwind(AssertUnwindSafe(|| (self.run_chunk)(chunk)));
+
+            let mut done = lock(&self.done);
+            *done += 1;
+            if *done == self.count {
+                self.finished.notify_all();
+            }
+        }
+    }
+}
+
+impl WorkerPool {
+    /// Start up to `threads` workers. Batches still run, on their calling thread only, when
+    /// no worker could be spawned.
+    pub(crate) fn new(threads: usize) -> Self {
+        let shared = Arc::new(Shared::default());
+        let workers = (0..threads)
+            .take_while(|_| {
+                let shared = shared.clone();
+                thread::Builder::new()
+                    .name("ockam-vault-worker".into())
+                    .spawn(move || shared.work())
+                    .is_ok()
+            })
+            .count();
+
+        Self { shared, workers }
+    }
+
+    /// Number of chunks to split `count` items in, with at least `min_per_chunk` items each
+    pub(crate) fn chunks(&self, count: usize, min_per_chunk: usize) -> usize {
+        (count / min_per_chunk).min(self.workers + 1).max(1)
+    }
+
+    /// Run `run_chunk` on every chunk index in `0..count`, on the calling thread and the idle
+    /// workers, and return once all of them ran
+    pub(crate) fn run<F>(&self, count: usize, run_chunk: F)
+    where
+        F: Fn(usize) + Send + Sync + 'static,
+    {
+        let chunks = Arc::new(Chunks {
+            run_chunk,
+            count,
+            next: AtomicUsize::new(0),
+            done: Mutex::new(0),
+            finished: Condvar::new(),
+        });
+
+        let helpers = self.workers.min(count.saturating_sub(1));
+        if helpers > 0 {
+            let mut jobs = lock(&self.shared.jobs);
+            for _ in 0..helpers {
+                jobs.push_back(chunks.clone());
+                self.shared.available.notify_one();
+            }
+        }
+
+        chunks.run();
+
+        let mut done = lock(&chunks.done);
+        while *done < count {
+            done = chunks
+                .finished
+                .wait(done)
+                .unwrap_or_else(PoisonError::into_inner);
+        }
+    }
+}
+
+impl Shared {
+    fn work(&self) {
+        loop {
+            let job = {
+                let mut jobs = lock(&self.jobs);
+                loop {
+                    match jobs.pop_front() {
+                        Some(job) => break job,
+                        None => {
+                            jobs = self
+                                .available
+                                .wait(jobs)
+                                .unwrap_or_else(PoisonError::into_inner)
+                        }
+                    }
+                }
+            };
+
+            // Jobs whose chunks were all claimed by other threads return right away
+            job.run();
+        }
+    }
+}
+
+fn lock<T>(mutex: &Mutex<T>) -> MutexGuard<'_, T> {
+    mutex.lock().unwrap_or_else(PoisonError::into_inner)
+}
+
+#[cfg(test)]
+mod tests {
+    use super::*;
+    use std::sync::atomic::AtomicU32;
+
+    #[test]
+    fn runs_every_chunk_once_across_concurrent_batches() {
+        let pool = Arc::new(WorkerPool::new(3));
+
+        let callers: Vec<_> = (0..8)
+            .map(|_| {
+                let pool = pool.clone();
+                thread::spawn(move || {
+                    let runs: Arc<Vec<AtomicU32>> =
+                        Arc::new((0..64).map(|_| AtomicU32::new(0)).collect());
+                    let counted = runs.clone();
+                    pool.run(runs.len(), move |chunk| {
+                        counted[chunk].fetch_add(1, Ordering::Relaxed);
+                    });
+                    assert!(runs.iter().all(|run| run.load(Ordering::Relaxed) == 1));
+                })
+            })
+            .collect();
+
+        for caller in callers {
+            caller.join().unwrap();
+        }
+    }
+
+    #[test]
+    fn a_panicking_chunk_does_not_stop_the_batch() {
+        let pool = WorkerPool::new(2);
+        let runs = Arc::new(AtomicU32::new(0));
+        let counted = runs.clone();
+
+        pool.run(16, move |chunk| {
+            counted.fetch_add(1, Ordering::Relaxed);
+            if chunk % 4 == 0 {
+                panic!("chunk {}", chunk);
+            }
+        });
+        assert_eq!(runs.load(Ordering::Relaxed), 16);
+
+        // The workers survived the panics
+        let runs = Arc::new(AtomicU32::new(0));
+        let counted = runs.clone();
+        pool.run(16, move |_| {
+            counted.fetch_add(1, Ordering::Relaxed);
+        });
+        assert_eq!(runs.load(Ordering::Relaxed), 16);
+    }
+
+    #[test]
+    fn chunks_are_bounded_by_the_workers() {
+        let pool = WorkerPool::new(3);
+        assert_eq!(pool.chunks(0, 8), 1);
+        assert_eq!(pool.chunks(20, 8), 2);
+        assert_eq!(pool.chunks(1000, 8), 4);
+    }
+}
@@ -14,5 +14,8 @@ pub const AES128_SECRET_LENGTH_U32: u32 = 16;
 /// AES128 private key length.
 pub const AES128_SECRET_LENGTH_USIZE: usize = 16;
 
+/// AES-GCM authentication tag length.
+pub const AES_GCM_TAG_LENGTH_USIZE: usize = 16;
+
 /// NISTP256 private key length.
 pub const NISTP256_SECRET_LENGTH_U32: u32 = 32;
@@ -20,6 +20,7 @@ mod vault_builder;
 mod vault_error;
 mod vault_kms;
 
+pub use symmetric_impl::*;
 pub use vault::*;
 pub use vault_builder::*;
 pub use vault_error::*;
@@ -1,3 +1,6 @@
+use crate::constants::{
+    AES128_SECRET_LENGTH_USIZE, AES256_SECRET_LENGTH_USIZE, AES_GCM_TAG_LENGTH_USIZE,
+};
 use crate::traits::SymmetricVault;
 use crate::{
     Buffer, EphemeralSecretsStore, Implementation, KeyId, SecretAttributes, StoredSecret, Vault,
@@ -19,7 +22,7 @@ impl<T: EphemeralSecretsStore + Implementation> SymmetricVault for T {
         aad: &[u8],
     ) -> Result<Buffer<u8>> {
         let stored_secret = self.get_ephemeral_secret(key_id, "aes key").await?;
-        let aes = Vault::make_aes(&stored_secret).await?;
+        let aes = Vault::make_aes(&stored_secret)?;
         aes.encrypt_message(msg, nonce, aad)
     }
 
@@ -31,14 +34,15 @@ impl<T: EphemeralSecretsStore + Implementation> SymmetricVault for T {
         aad: &[u8],
     ) -> Result<Buffer<u8>> {
         let stored_secret = self.get_ephemeral_secret(key_id, "aes key").await?;
-        let aes = Vault::make_aes(&stored_secret).await?;
+        let aes = Vault::make_aes(&stored_secret)?;
         aes.decrypt_message(msg, nonce, aad)
     }
 }
 
 impl Vault {
-    /// Depending on the secret type make the right type of encrypting / decrypting algorithm
-    async fn make_aes(stored_secret: &StoredSecret) -> Result<AesGen> {
+    /// Depending on the secret type make the right type of encrypting / decrypting algorithm.
+    /// The result can be reused to encrypt or decrypt several messages with the same key
+    pub fn make_aes(stored_secret: &StoredSecret) -> Result<AesGen> {
         let secret_ref = stored_secret.secret().as_ref();
 
         match stored_secret.attributes() {
@@ -56,20 +60,103 @@ impl Vault {
 /// This enum is necessary to be able to dispatch the encrypt or decrypt functions
 /// based of the algorithm type. It would be avoided if `make_aes` could return existential types
 /// but those types are not allowed in return values in Rust
-enum AesGen {
+pub enum AesGen {
+    /// AES-GCM with a 128 bits key
     Aes128(Box<AesGcm<Aes128, U12>>),
+    /// AES-GCM with a 256 bits key
     Aes256(Box<AesGcm<Aes256, U12>>),
 }
 
 impl AesGen {
-    fn encrypt_message(&self, msg: &[u8], nonce: &[u8], aad: &[u8]) -> Result<Buffer<u8>> {
+    /// Make the AES-GCM algorithm matching the length of raw key bytes, whatever the type of
+    /// the secret holding them
+    pub fn from_key(key: &[u8]) -> Result<AesGen> {
+        match key.len() {
+            AES256_SECRET_LENGTH_USIZE => Ok(AesGen::Aes256(Box::new(Aes256Gcm::new(key.into())))),
+            AES128_SECRET_LENGTH_USIZE => Ok(AesGen::Aes128(Box::new(Aes128Gcm::new(key.into())))),
+            _ => Err(VaultError::AeadAesGcmEncrypt.into()),
+        }
+    }
+
+    /// Encrypt a message and return the ciphertext followed by the tag
+    pub fn encrypt_message(&self, msg: &[u8], nonce: &[u8], aad: &[u8]) -> Result<Buffer<u8>> {
         self.encrypt(nonce.into(), Payload { aad, msg })
             .map_err(|_| VaultError::AeadAesGcmEncrypt.into())
     }
-    fn decrypt_message(&self, msg: &[u8], nonce: &[u8], aad: &[u8]) -> Result<Buffer<u8>> {
+
+    /// Encrypt a message into `output`, which must be exactly `msg.len() + 16` bytes long.
+    /// The ciphertext is followed by the tag and no intermediate buffer is allocated
+    pub fn encrypt_message_into(
+        &self,
+        msg: &[u8],
+        nonce: &[u8],
+        aad: &[u8],
+        output: &mut [u8],
+    ) -> Result<()> {
+        if output.len() != msg.len() + AES_GCM_TAG_LENGTH_USIZE {
+            return Err(VaultError::AeadAesGcmEncrypt.into());
+        }
+        output[..msg.len()].copy_from_slice(msg);
+        self.encrypt_message_in_place(output, nonce, aad)
+    }
+
+    /// Encrypt the message held by the start of `buffer` in place, the last 16 bytes of
+    /// `buffer` receive the tag
+    pub fn encrypt_message_in_place(
+        &self,
+        buffer: &mut [u8],
+        nonce: &[u8],
+        aad: &[u8],
+    ) -> Result<()> {
+        if buffer.len() < AES_GCM_TAG_LENGTH_USIZE {
+            return Err(VaultError::AeadAesGcmEncrypt.into());
+        }
+        let (buffer, tag) = buffer.split_at_mut(buffer.len() - AES_GCM_TAG_LENGTH_USIZE);
+        let computed_tag = self
+            .encrypt_in_place_detached(nonce.into(), aad, buffer)
+            .map_err(|_| VaultError::AeadAesGcmEncrypt)?;
+        tag.copy_from_slice(&computed_tag);
+        Ok(())
+    }
+
+    /// Decrypt a ciphertext followed by its tag and return the plaintext
+    pub fn decrypt_message(&self, msg: &[u8], nonce: &[u8], aad: &[u8]) -> Result<Buffer<u8>> {
         self.decrypt(nonce.into(), Payload { aad, msg })
             .map_err(|_| VaultError::AeadAesGcmDecrypt.into())
     }
+
+    /// Decrypt a ciphertext followed by its tag into `output`, which must be exactly
+    /// `msg.len() - 16` bytes long
+    pub fn decrypt_message_into(
+        &self,
+        msg: &[u8],
+        nonce: &[u8],
+        aad: &[u8],
+        output: &mut [u8],
+    ) -> Result<()> {
+        self.try_decrypt_message_into(msg, nonce, aad, output)
+            .map_err(|_| VaultError::AeadAesGcmDecrypt.into())
+    }
+
+    /// Same as `decrypt_message_into`, but a failure is reported as a bare `aead::Error`:
+    /// peers can make authentication fail on every message, so rejecting it must stay as
+    /// cheap as accepting it
+    pub fn try_decrypt_message_into(
+        &self,
+        msg: &[u8],
+        nonce: &[u8],
+        aad: &[u8],
+        output: &mut [u8],
+    ) -> aes_gcm::aead::Result<()> {
+        if msg.len() < AES_GCM_TAG_LENGTH_USIZE
+            || output.len() != msg.len() - AES_GCM_TAG_LENGTH_USIZE
+        {
+            return Err(aes_gcm::aead::Error);
+        }
+        let (cipher_text, tag) = msg.split_at(output.len());
+        output.copy_from_slice(cipher_text);
+        self.decrypt_in_place_detached(nonce.into(), aad, output, tag.into())
+    }
 }
 
 impl AeadInPlace for AesGen {